@@ -0,0 +1,188 @@
+/**
+ * @file    AsyncRangeFinder.cpp
+ * @brief   mbed Endpoint interrupt driven ultrasonic range finder
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Class
+#include "AsyncRangeFinder.h"
+
+// Default constructor
+AsyncRangeFinder::AsyncRangeFinder(PinName pin,int pulse_us,float scale,int timeout_us) : m_pin(pin), m_echo(pin) {
+    this->m_pulse_us = pulse_us;
+    this->m_scale = scale;
+    this->m_timeout_us = timeout_us;
+    this->m_period_ms = 0;
+    this->m_state = ECHO_IDLE;
+    this->m_rise_us = 0;
+    this->m_trigger_us = 0;
+    this->m_stats_us = 0;
+    this->m_active_us = 0;
+    this->m_triggers = 0;
+    this->m_overruns = 0;
+    this->m_wake_failed = false;
+    this->m_queue = NULL;
+    this->m_on_sample = NULL;
+
+    // echo edges are only of interest after a trigger pulse
+    this->m_echo.disable_irq();
+    this->m_echo.rise(callback(this,&AsyncRangeFinder::echo_rise));
+    this->m_echo.fall(callback(this,&AsyncRangeFinder::echo_fall));
+    this->m_clock.start();
+}
+
+// Destructor
+AsyncRangeFinder::~AsyncRangeFinder() {
+    this->stop();
+}
+
+// start ranging every "period_ms"
+void AsyncRangeFinder::start(int period_ms,EventQueue *queue,void (*on_sample)(void)) {
+    this->m_queue = queue;
+    this->m_on_sample = on_sample;
+    this->set_period(period_ms);
+}
+
+// change the ranging period
+void AsyncRangeFinder::set_period(int period_ms) {
+    if (period_ms != this->m_period_ms) {
+        // the period must cover the echo timeout... a trigger never lands on an echo in progress
+        this->m_period_ms = period_ms;
+        if (period_ms > 0) {
+            this->m_ticker.attach_us(callback(this,&AsyncRangeFinder::trigger),period_ms * 1000);
+        }
+        else {
+            this->m_ticker.detach();
+        }
+    }
+}
+
+// range once now
+bool AsyncRangeFinder::fire() {
+    core_util_critical_section_enter();
+    bool idle = (this->m_state == ECHO_IDLE);
+    if (idle) {
+        this->trigger();
+    }
+    core_util_critical_section_exit();
+    return idle;
+}
+
+// stop ranging
+void AsyncRangeFinder::stop() {
+    this->m_ticker.detach();
+    this->m_timeout.detach();
+    this->m_echo.disable_irq();
+    this->m_state = ECHO_IDLE;
+    this->m_period_ms = 0;
+}
+
+// CONSUMER: take the oldest sample
+bool AsyncRangeFinder::read(range_sample_t &sample) {
+    return this->m_samples.pop(sample);
+}
+
+// stats: samples dropped because the consumer fell behind
+int AsyncRangeFinder::overruns() {
+    return this->m_overruns;
+}
+
+// stats: time since the last call, time spent ranging and triggers fired in it
+void AsyncRangeFinder::take_stats(uint32_t &elapsed_us,uint32_t &active_us,int &triggers) {
+    core_util_critical_section_enter();
+    uint32_t now_us = (uint32_t)this->m_clock.read_us();
+    elapsed_us = now_us - this->m_stats_us;
+    active_us = this->m_active_us;
+    triggers = this->m_triggers;
+    this->m_stats_us = now_us;
+    this->m_active_us = 0;
+    this->m_triggers = 0;
+    core_util_critical_section_exit();
+}
+
+// ISR (Ticker): send the trigger pulse and listen for the echo
+void AsyncRangeFinder::trigger() {
+    if (this->m_state != ECHO_IDLE) {
+        // previous echo still outstanding... skip this period
+        return;
+    }
+
+    // our own pulse must not look like an echo
+    this->m_trigger_us = (uint32_t)this->m_clock.read_us();
+    ++this->m_triggers;
+    this->m_echo.disable_irq();
+    this->m_pin.output();
+    this->m_pin.write(1);
+    wait_us(this->m_pulse_us);
+    this->m_pin.write(0);
+    this->m_pin.input();
+
+    // listen
+    this->m_state = ECHO_WAIT_RISE;
+    this->m_timeout.attach_us(callback(this,&AsyncRangeFinder::echo_timeout),this->m_timeout_us);
+    this->m_echo.enable_irq();
+}
+
+// ISR (InterruptIn): echo started
+void AsyncRangeFinder::echo_rise() {
+    if (this->m_state == ECHO_WAIT_RISE) {
+        this->m_rise_us = (uint32_t)this->m_clock.read_us();
+        this->m_state = ECHO_WAIT_FALL;
+    }
+}
+
+// ISR (InterruptIn): echo ended... its width is the round trip time
+void AsyncRangeFinder::echo_fall() {
+    if (this->m_state == ECHO_WAIT_FALL) {
+        uint32_t fall_us = (uint32_t)this->m_clock.read_us();
+        this->m_timeout.detach();
+        this->m_echo.disable_irq();
+        this->m_state = ECHO_IDLE;
+        this->m_active_us += fall_us - this->m_trigger_us;
+        this->publish((float)(fall_us - this->m_rise_us) / this->m_scale,fall_us);
+    }
+}
+
+// ISR (Timeout): no echo (or no end of echo) in time
+void AsyncRangeFinder::echo_timeout() {
+    if (this->m_state != ECHO_IDLE) {
+        uint32_t now_us = (uint32_t)this->m_clock.read_us();
+        this->m_echo.disable_irq();
+        this->m_state = ECHO_IDLE;
+        this->m_active_us += now_us - this->m_trigger_us;
+        this->publish(-1.0,now_us);
+    }
+}
+
+// ISR: queue a sample and wake the consumer
+void AsyncRangeFinder::publish(float range_m,uint32_t timestamp_us) {
+    range_sample_t sample;
+    sample.range_m = range_m;
+    sample.timestamp_us = timestamp_us;
+
+    // the consumer drains the ring until empty... so it only needs waking when the ring was empty (or the last wake was lost)
+    bool was_empty = this->m_samples.empty();
+    if (this->m_samples.push(sample) == false) {
+        ++this->m_overruns;
+        return;
+    }
+    if ((was_empty || this->m_wake_failed) && this->m_queue != NULL && this->m_on_sample != NULL) {
+        this->m_wake_failed = (this->m_queue->call(this->m_on_sample) == 0);
+    }
+}
@@ -0,0 +1,116 @@
+/**
+ * @file    AsyncRangeFinder.h
+ * @brief   mbed Endpoint interrupt driven ultrasonic range finder (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ASYNC_RANGE_FINDER_H__
+#define __ASYNC_RANGE_FINDER_H__
+
+// mbed API
+#include "mbed.h"
+#include "mbed_events.h"
+
+// lock-free sample ring
+#include "LockFreeRing.h"
+
+// TUNE: samples buffered between the ISRs and the consumer (power of two)
+#define RANGE_SAMPLE_RING_DEPTH			8
+
+// a range sample
+typedef struct {
+    float       range_m;            // range (m)... < 0: no echo before the timeout
+    uint32_t    timestamp_us;       // echo time (wraps... use differences only)
+} range_sample_t;
+
+/**
+ * Single pin (Seeed style) ultrasonic ranger driven entirely from interrupts: a Ticker fires the trigger pulse,
+ * InterruptIn edges timestamp the echo and a Timeout ends a missing echo. Each sample is pushed into a lock-free
+ * ring and the consumer callback is posted to an EventQueue... nothing ever blocks on the echo.
+ * With a period of 0 the Ticker is off and fire() triggers each sample (several sensors sharing the air: RangeMultiplexer).
+ */
+class AsyncRangeFinder {
+    public:
+        // Default constructor (same parameters as RangeFinder: pin, trigger pulse (us), us per meter, echo timeout (us))
+        AsyncRangeFinder(PinName pin,int pulse_us,float scale,int timeout_us);
+
+        // Destructor
+        virtual ~AsyncRangeFinder();
+
+        // start ranging every "period_ms" (0: only on fire())... "on_sample" is posted to "queue" when samples are waiting
+        void start(int period_ms,EventQueue *queue,void (*on_sample)(void));
+
+        // change the ranging period (0: only on fire())
+        void set_period(int period_ms);
+
+        // ISR or thread: range once now (false if an echo is still outstanding)
+        bool fire();
+
+        // stop ranging
+        void stop();
+
+        // CONSUMER: take the oldest sample (false if none are waiting)
+        bool read(range_sample_t &sample);
+
+        // stats: samples dropped because the consumer fell behind
+        int overruns();
+
+        // stats: time (us) since the last call, time spent ranging (trigger to echo end) and triggers fired in it
+        void take_stats(uint32_t &elapsed_us,uint32_t &active_us,int &triggers);
+
+    private:
+        // ISRs
+        void trigger();
+        void echo_rise();
+        void echo_fall();
+        void echo_timeout();
+
+        // ISR: queue a sample and wake the consumer
+        void publish(float range_m,uint32_t timestamp_us);
+
+        // echo states
+        enum EchoStates {
+            ECHO_IDLE=0,
+            ECHO_WAIT_RISE=1,
+            ECHO_WAIT_FALL=2
+        };
+
+        DigitalInOut        m_pin;
+        InterruptIn         m_echo;
+        Ticker              m_ticker;
+        Timeout             m_timeout;
+        Timer               m_clock;
+        int                 m_pulse_us;
+        float               m_scale;
+        int                 m_timeout_us;
+        int                 m_period_ms;
+        volatile int        m_state;
+        uint32_t            m_rise_us;
+        uint32_t            m_trigger_us;
+        uint32_t            m_stats_us;
+        volatile uint32_t   m_active_us;
+        volatile int        m_triggers;
+        volatile int        m_overruns;
+        bool                m_wake_failed;
+        EventQueue         *m_queue;
+        void              (*m_on_sample)(void);
+        LockFreeRing<range_sample_t,RANGE_SAMPLE_RING_DEPTH> m_samples;
+};
+
+#endif // __ASYNC_RANGE_FINDER_H__
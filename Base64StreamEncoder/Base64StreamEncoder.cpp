@@ -0,0 +1,139 @@
+/**
+ * @file    Base64StreamEncoder.cpp
+ * @brief   mbed Endpoint incremental Base64 encoder
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Class
+#include "Base64StreamEncoder.h"
+
+// Base64 alphabet
+static const char __base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Default constructor
+Base64StreamEncoder::Base64StreamEncoder() {
+    this->reset();
+}
+
+// Destructor
+Base64StreamEncoder::~Base64StreamEncoder() {
+}
+
+// reset the carry state
+void Base64StreamEncoder::reset() {
+    memset(this->m_carry,0,sizeof(this->m_carry));
+    this->m_carry_length = 0;
+}
+
+// encode 1..3 bytes into 4 characters
+void Base64StreamEncoder::encode_group(const uint8_t *in,int length,char *out) {
+    uint32_t bits = ((uint32_t)in[0]) << 16;
+    if (length > 1) bits |= ((uint32_t)in[1]) << 8;
+    if (length > 2) bits |= (uint32_t)in[2];
+    out[0] = __base64_alphabet[(bits >> 18) & 0x3F];
+    out[1] = __base64_alphabet[(bits >> 12) & 0x3F];
+    out[2] = (length > 1) ? __base64_alphabet[(bits >> 6) & 0x3F] : '=';
+    out[3] = (length > 2) ? __base64_alphabet[bits & 0x3F] : '=';
+}
+
+// encode a slice
+int Base64StreamEncoder::encode(const uint8_t *in,int in_length,char *out,int out_length,int *consumed) {
+    int written = 0;
+    int used = 0;
+
+    // complete any carried group first
+    while (this->m_carry_length > 0 && this->m_carry_length < 3 && used < in_length) {
+        this->m_carry[this->m_carry_length++] = in[used++];
+    }
+    if (this->m_carry_length == 3) {
+        if (out_length - written < 4) {
+            // no room... give back what we took so the caller can retry
+            this->m_carry_length -= used;
+            if (consumed != NULL) *consumed = 0;
+            return 0;
+        }
+        encode_group(this->m_carry,3,out + written);
+        written += 4;
+        this->m_carry_length = 0;
+    }
+
+    // whole groups straight from the input
+    while (in_length - used >= 3 && out_length - written >= 4) {
+        encode_group(in + used,3,out + written);
+        used += 3;
+        written += 4;
+    }
+
+    // carry the tail (only once all whole groups have been written)
+    if (in_length - used < 3) {
+        while (used < in_length) {
+            this->m_carry[this->m_carry_length++] = in[used++];
+        }
+    }
+
+    if (consumed != NULL) *consumed = used;
+    return written;
+}
+
+// flush any carried bytes
+int Base64StreamEncoder::finish(char *out,int out_length) {
+    int written = 0;
+    if (this->m_carry_length > 0 && out_length >= 4) {
+        encode_group(this->m_carry,this->m_carry_length,out);
+        written = 4;
+        this->m_carry_length = 0;
+    }
+    return written;
+}
+
+// encode the characters [begin,end) of the encoding of in[0..in_length)
+int Base64StreamEncoder::encode_range(const uint8_t *in,int in_length,int begin,int end,char *out) {
+    char quad[4];
+    int written = 0;
+
+    // start at the group holding "begin"
+    int pos = (begin / 4) * 4;
+    int offset = (begin / 4) * 3;
+    int skip = begin - pos;
+    while (pos < end && offset < in_length) {
+        int length = in_length - offset;
+        if (length > 3) length = 3;
+
+        // encode whole groups in place... partial leading/trailing groups go through "quad"
+        if (skip == 0 && pos + 4 <= end) {
+            encode_group(in + offset,length,out + written);
+            written += 4;
+        }
+        else {
+            encode_group(in + offset,length,quad);
+            for (int i=skip;i<4 && pos + i < end;++i) {
+                out[written++] = quad[i];
+            }
+        }
+        skip = 0;
+        pos += 4;
+        offset += length;
+    }
+    return written;
+}
+
+// encoded length of "length" raw bytes
+int Base64StreamEncoder::encoded_length(int length) {
+    return ((length + 2) / 3) * 4;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file    Base64StreamEncoder.h
+ * @brief   mbed Endpoint incremental Base64 encoder (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BASE64_STREAM_ENCODER_H__
+#define __BASE64_STREAM_ENCODER_H__
+
+// mbed API
+#include "mbed.h"
+
+/**
+ * Incremental Base64 encoder. Never allocates: the caller supplies the output buffer.
+ * encode() may be fed arbitrary slices... up to 2 trailing bytes are carried into the next call.
+ * finish() flushes the carry (with "=" padding). encode_range() encodes any [begin,end) character
+ * range of the encoding of a complete buffer on demand.
+ */
+class Base64StreamEncoder {
+    public:
+        // Default constructor
+        Base64StreamEncoder();
+
+        // Destructor
+        virtual ~Base64StreamEncoder();
+
+        // reset the carry state
+        void reset();
+
+        // encode a slice... returns the number of characters written. Stops early (without consuming) if "out" is full.
+        int encode(const uint8_t *in,int in_length,char *out,int out_length,int *consumed = NULL);
+
+        // flush any carried bytes (with padding)... returns the number of characters written (0 or 4)
+        int finish(char *out,int out_length);
+
+        // encode the characters [begin,end) of the encoding of in[0..in_length)... returns the number of characters written
+        int encode_range(const uint8_t *in,int in_length,int begin,int end,char *out);
+
+        // encoded length of "length" raw bytes
+        static int encoded_length(int length);
+
+    private:
+        // encode 1..3 bytes into 4 characters (padding if fewer than 3)
+        static void encode_group(const uint8_t *in,int length,char *out);
+
+        uint8_t m_carry[3];
+        int     m_carry_length;
+};
+
+#endif // __BASE64_STREAM_ENCODER_H__
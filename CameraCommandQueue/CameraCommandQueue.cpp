@@ -0,0 +1,66 @@
+/**
+ * @file    CameraCommandQueue.cpp
+ * @brief   mbed Endpoint camera command queue
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Class
+#include "CameraCommandQueue.h"
+
+// Default constructor
+CameraCommandQueue::CameraCommandQueue() {
+}
+
+// Destructor
+CameraCommandQueue::~CameraCommandQueue() {
+}
+
+// queue a command
+bool CameraCommandQueue::put(CameraCommands cmd,int arg,int img,const uint16_t *chunks,int num_chunks) {
+    camera_command_t *command = this->m_commands.alloc();
+    if (command == NULL) {
+        return false;
+    }
+    command->cmd = cmd;
+    command->arg = arg;
+    command->img = img;
+    command->num_chunks = 0;
+    if (chunks != NULL && num_chunks > 0) {
+        command->num_chunks = (num_chunks > MAX_RESEND_CHUNKS) ? MAX_RESEND_CHUNKS : num_chunks;
+        memcpy(command->chunks,chunks,command->num_chunks * sizeof(uint16_t));
+    }
+    this->m_commands.put(command);
+    return true;
+}
+
+// wait for the next command... copied out so its entry is free again before it runs
+bool CameraCommandQueue::get(camera_command_t *command,uint32_t millisec) {
+    osEvent evt = this->m_commands.get(millisec);
+    if (evt.status != osEventMail) {
+        return false;
+    }
+    camera_command_t *queued = (camera_command_t *)evt.value.p;
+    command->cmd = queued->cmd;
+    command->arg = queued->arg;
+    command->img = queued->img;
+    command->num_chunks = queued->num_chunks;
+    memcpy(command->chunks,queued->chunks,queued->num_chunks * sizeof(uint16_t));
+    this->m_commands.free(queued);
+    return true;
+}
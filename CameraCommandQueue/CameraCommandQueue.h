@@ -0,0 +1,78 @@
+/**
+ * @file    CameraCommandQueue.h
+ * @brief   mbed Endpoint camera command queue (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CAMERA_COMMAND_QUEUE_H__
+#define __CAMERA_COMMAND_QUEUE_H__
+
+// mbed API
+#include "mbed.h"
+
+// TUNE: bounded command queue depth (each queued command carries its own resend chunk list: ~76 bytes per entry)
+#define CAMERA_COMMAND_QUEUE_DEPTH			4
+
+// TUNE: maximum number of chunk indexes a single resend request may ask for
+#define MAX_RESEND_CHUNKS					32
+
+// camera commands (CAPTURE and POWER_* go to the camera worker, the rest to the streamer)
+enum CameraCommands {
+	CAMERA_CMD_CAPTURE=0,			// take a picture into a free slot then hand it to the streamer
+	CAMERA_CMD_STREAM=1,			// stream captured picture "img" as observations (then END)
+	CAMERA_CMD_RESEND=2,			// re-observe the requested chunks of retained picture "img" (then END)
+	CAMERA_CMD_SELECT=3,			// make chunk "arg" of retained picture "img" the GET value
+	CAMERA_CMD_HISTORY=4,			// make the list of retained pictures the GET value
+	CAMERA_CMD_POWER_UP=5,			// power up (warm up) the camera
+	CAMERA_CMD_POWER_DOWN=6			// power down the camera
+};
+
+// camera command
+typedef struct {
+	CameraCommands cmd;
+	int            arg;
+	int            img;
+	int            num_chunks;						// RESEND: the requested chunk indexes of "img"
+	uint16_t       chunks[MAX_RESEND_CHUNKS];
+} camera_command_t;
+
+/**
+ * Bounded queue of camera commands (a Mail pool... no heap). Everything a command needs travels in it: two resend
+ * requests queued back to back each keep their own image id and chunk list. get() copies the command out and frees
+ * its entry before it is dispatched (a long stream does not hold a queue entry).
+ */
+class CameraCommandQueue {
+    public:
+        // Default constructor
+        CameraCommandQueue();
+
+        // Destructor
+        virtual ~CameraCommandQueue();
+
+        // queue a command (false: the queue is full)... RESEND carries up to MAX_RESEND_CHUNKS chunk indexes
+        bool put(CameraCommands cmd,int arg = 0,int img = 0,const uint16_t *chunks = NULL,int num_chunks = 0);
+
+        // wait for the next command (false: timed out)
+        bool get(camera_command_t *command,uint32_t millisec = osWaitForever);
+
+    private:
+        Mail<camera_command_t,CAMERA_COMMAND_QUEUE_DEPTH> m_commands;
+};
+
+#endif // __CAMERA_COMMAND_QUEUE_H__
@@ -0,0 +1,83 @@
+/**
+ * @file    CaptureBudget.cpp
+ * @brief   mbed Endpoint camera capture budget from the smoothed image throughput
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Class
+#include "CaptureBudget.h"
+
+// Default constructor
+CaptureBudget::CaptureBudget(uint32_t buffer_size,int transfer_budget_ms,bool base64) {
+    this->m_buffer_size = buffer_size;
+    this->m_transfer_budget_ms = transfer_budget_ms;
+    this->m_base64 = base64;
+    this->m_bytes_per_sec = 0;
+}
+
+// Destructor
+CaptureBudget::~CaptureBudget() {
+}
+
+// a paced transfer has ended... only full images sample the link
+void CaptureBudget::transfer(CaptureTransferKind kind,int bytes_per_sec) {
+    if (kind != CAPTURE_TRANSFER_IMAGE || bytes_per_sec <= 0) {
+        return;
+    }
+    if (this->m_bytes_per_sec == 0) {
+        // first sample
+        this->m_bytes_per_sec = bytes_per_sec;
+    }
+    else {
+        this->m_bytes_per_sec = (int)((((int64_t)this->m_bytes_per_sec * (CAPTURE_BUDGET_SMOOTHING - 1)) + bytes_per_sec) / CAPTURE_BUDGET_SMOOTHING);
+        if (this->m_bytes_per_sec <= 0) {
+            this->m_bytes_per_sec = 1;
+        }
+    }
+}
+
+// smoothed image throughput (bytes/sec)
+int CaptureBudget::bytes_per_sec() {
+    return this->m_bytes_per_sec;
+}
+
+// largest picture the link budget allows
+uint32_t CaptureBudget::budget() {
+    uint32_t budget = this->m_buffer_size;
+    int bytes_per_sec = this->m_bytes_per_sec;
+    if (this->m_transfer_budget_ms > 0 && bytes_per_sec > 0) {
+        uint32_t link_budget = (uint32_t)(((int64_t)bytes_per_sec * this->m_transfer_budget_ms) / 1000);
+        if (this->m_base64) {
+            // the link carries 4 characters for every 3 bytes
+            link_budget = (link_budget / 4) * 3;
+        }
+        if (link_budget < budget) {
+            budget = link_budget;
+        }
+    }
+    return budget;
+}
+
+// does a picture fit the slot and the link budget?
+bool CaptureBudget::fits(uint32_t picture_length,uint32_t stored_length,bool smallest) {
+    if (stored_length > this->m_buffer_size) {
+        return false;
+    }
+    return (smallest || picture_length <= this->budget());
+}
@@ -0,0 +1,74 @@
+/**
+ * @file    CaptureBudget.h
+ * @brief   mbed Endpoint camera capture budget from the smoothed image throughput (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CAPTURE_BUDGET_H__
+#define __CAPTURE_BUDGET_H__
+
+// mbed API
+#include "mbed.h"
+
+// TUNE: smoothing of the image throughput (each full image transfer moves the average 1/CAPTURE_BUDGET_SMOOTHING of the way)
+#define CAPTURE_BUDGET_SMOOTHING			8
+
+// kinds of paced transfers
+typedef enum {
+    CAPTURE_TRANSFER_IMAGE = 0,             // a full image (chunks + END)... the only kind that measures the link
+    CAPTURE_TRANSFER_PREVIEW = 1,           // a progressive preview (a few chunks... acknowledgement latency dominates)
+    CAPTURE_TRANSFER_RESEND = 2,            // requested chunks of a retained image
+    CAPTURE_TRANSFER_UNCHANGED = 3,         // a single "unchanged" observation (duplicate suppression)
+    CAPTURE_TRANSFER_END = 4                // END only (an empty or failed image)
+} CaptureTransferKind;
+
+/**
+ * Largest picture worth capturing: the slot size, or less if the smoothed image throughput cannot send it within the
+ * transfer budget. Short transfers (END only, "unchanged", resends, previews) are dominated by acknowledgement latency,
+ * not the link rate, so they never move the average... until a full image has been sent there is no budget at all
+ * (the configured resolution is kept).
+ */
+class CaptureBudget {
+    public:
+        // Default constructor: slot size (bytes), transfer budget (ms... 0: none) and base64 encoding on the link
+        CaptureBudget(uint32_t buffer_size,int transfer_budget_ms,bool base64);
+
+        // Destructor
+        virtual ~CaptureBudget();
+
+        // a paced transfer of "kind" has ended at "bytes_per_sec" (ObservationPacer::bytes_per_sec())
+        void transfer(CaptureTransferKind kind,int bytes_per_sec);
+
+        // smoothed image throughput (bytes/sec... 0: no image transfer yet)
+        int bytes_per_sec();
+
+        // largest picture (bytes) the link budget allows (the slot size until there is a sample)
+        uint32_t budget();
+
+        // does a picture of "picture_length" (needing "stored_length" of the slot) fit? the smallest resolution only has to fit the slot
+        bool fits(uint32_t picture_length,uint32_t stored_length,bool smallest);
+
+    private:
+        uint32_t    m_buffer_size;
+        int         m_transfer_budget_ms;
+        bool        m_base64;
+        int         m_bytes_per_sec;
+};
+
+#endif // __CAPTURE_BUDGET_H__
@@ -0,0 +1,148 @@
+/**
+ * @file    GzipStreamCompressor.cpp
+ * @brief   mbed Endpoint streaming gzip compressor with a fixed zlib workspace
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Class
+#include "GzipStreamCompressor.h"
+
+// gzip wrapper is selected by adding 16 to the window bits
+#define GZIP_WRAPPER_BITS       16
+
+// zlib allocator: carve from the workspace (everything is released at once when the stream ends)
+static voidpf _gzip_workspace_alloc(voidpf opaque,uInt items,uInt size) {
+    return (voidpf)((GzipStreamCompressor *)opaque)->alloc((uint32_t)(items * size));
+}
+
+// zlib free: no-op (workspace is reset per stream)
+static void _gzip_workspace_free(voidpf opaque,voidpf address) {
+}
+
+// Default constructor
+GzipStreamCompressor::GzipStreamCompressor(uint8_t *workspace,uint32_t workspace_length,int window_bits,int mem_level) {
+    memset(&this->m_stream,0,sizeof(this->m_stream));
+    this->m_workspace = workspace;
+    this->m_workspace_length = workspace_length;
+    this->m_workspace_used = 0;
+    this->m_peak = 0;
+    this->m_window_bits = window_bits;
+    this->m_mem_level = mem_level;
+    this->m_level = GZIP_DEFAULT_LEVEL;
+    this->m_active = false;
+}
+
+// Destructor
+GzipStreamCompressor::~GzipStreamCompressor() {
+    this->end();
+}
+
+// set the compression level
+void GzipStreamCompressor::set_level(int level) {
+    if (level < Z_NO_COMPRESSION) level = Z_NO_COMPRESSION;
+    if (level > Z_BEST_COMPRESSION) level = Z_BEST_COMPRESSION;
+    this->m_level = level;
+}
+
+// current compression level
+int GzipStreamCompressor::level() {
+    return this->m_level;
+}
+
+// begin a gzip stream
+bool GzipStreamCompressor::begin(uint8_t *out,uint32_t out_length) {
+    this->end();
+
+    // fresh workspace
+    this->m_workspace_used = 0;
+    memset(&this->m_stream,0,sizeof(this->m_stream));
+    this->m_stream.zalloc = _gzip_workspace_alloc;
+    this->m_stream.zfree = _gzip_workspace_free;
+    this->m_stream.opaque = (voidpf)this;
+    this->m_stream.next_out = (Bytef *)out;
+    this->m_stream.avail_out = (uInt)out_length;
+
+    // reduced window and hash memory keep zlib inside the fixed workspace
+    int status = deflateInit2(&this->m_stream,this->m_level,Z_DEFLATED,this->m_window_bits + GZIP_WRAPPER_BITS,this->m_mem_level,Z_DEFAULT_STRATEGY);
+    this->m_active = (status == Z_OK);
+    return this->m_active;
+}
+
+// compress the next input block
+bool GzipStreamCompressor::compress(const uint8_t *in,uint32_t in_length) {
+    if (this->m_active == false) {
+        return false;
+    }
+    this->m_stream.next_in = (Bytef *)in;
+    this->m_stream.avail_in = (uInt)in_length;
+    int status = deflate(&this->m_stream,Z_NO_FLUSH);
+
+    // out of output space shows up as input left over
+    return (status == Z_OK && this->m_stream.avail_in == 0);
+}
+
+// finish the gzip stream
+bool GzipStreamCompressor::finish() {
+    if (this->m_active == false) {
+        return false;
+    }
+    this->m_stream.next_in = NULL;
+    this->m_stream.avail_in = 0;
+    int status = deflate(&this->m_stream,Z_FINISH);
+    this->end();
+    return (status == Z_STREAM_END);
+}
+
+// compressed length so far
+uint32_t GzipStreamCompressor::length() {
+    return (uint32_t)this->m_stream.total_out;
+}
+
+// peak workspace used
+uint32_t GzipStreamCompressor::peak_memory() {
+    return this->m_peak;
+}
+
+// worst case stream length (zlib's conservative deflateBound() for a reduced window/memLevel plus the gzip wrapper)
+uint32_t GzipStreamCompressor::bound(uint32_t in_length) {
+    return GZIP_BOUND(in_length);
+}
+
+// allocate from the workspace
+void *GzipStreamCompressor::alloc(uint32_t length) {
+    // keep allocations word aligned
+    length = (length + 7) & ~((uint32_t)7);
+    if (this->m_workspace == NULL || this->m_workspace_used + length > this->m_workspace_length) {
+        return NULL;
+    }
+    void *ptr = (void *)(this->m_workspace + this->m_workspace_used);
+    this->m_workspace_used += length;
+    if (this->m_workspace_used > this->m_peak) {
+        this->m_peak = this->m_workspace_used;
+    }
+    return ptr;
+}
+
+// release the zlib stream
+void GzipStreamCompressor::end() {
+    if (this->m_active) {
+        deflateEnd(&this->m_stream);
+        this->m_active = false;
+    }
+}
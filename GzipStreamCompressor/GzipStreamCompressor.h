@@ -0,0 +1,103 @@
+/**
+ * @file    GzipStreamCompressor.h
+ * @brief   mbed Endpoint streaming gzip compressor with a fixed zlib workspace (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __GZIP_STREAM_COMPRESSOR_H__
+#define __GZIP_STREAM_COMPRESSOR_H__
+
+// mbed API
+#include "mbed.h"
+
+// zlib
+#include "zlib.h"
+
+// TUNE: deflate window (2^bits bytes... 9 is the zlib minimum) and hash memory level (1..9)
+#define GZIP_WINDOW_BITS				9
+#define GZIP_MEM_LEVEL					1
+
+// TUNE: default compression level (0..9)
+#define GZIP_DEFAULT_LEVEL				6
+
+// gzip header (10) and trailer (8)
+#define GZIP_WRAPPER_LENGTH				18
+
+// worst case gzip stream length for "in" input bytes (compile time... for sizing output buffers): incompressible input
+// falls back to stored or fixed code blocks (small windows and memory levels flush a block every few hundred bytes)
+#define GZIP_BOUND(in)					((in) + (((in) + 7) >> 3) + (((in) + 63) >> 6) + 5 + GZIP_WRAPPER_LENGTH)
+
+// workspace needed for a given window/memory level (deflate_state + window + prev + head + pending... plus slack)
+#define GZIP_WORKSPACE_SIZE(wbits,mlevel)	(6144 + (1 << ((wbits)+2)) + (1 << ((mlevel)+9)) + 512)
+
+/**
+ * Streaming gzip compressor. zlib allocates from a caller supplied fixed workspace (no heap).
+ * begin() a stream into an output buffer, compress() input blocks as they arrive, then finish().
+ */
+class GzipStreamCompressor {
+    public:
+        // Default constructor
+        GzipStreamCompressor(uint8_t *workspace,uint32_t workspace_length,int window_bits = GZIP_WINDOW_BITS,int mem_level = GZIP_MEM_LEVEL);
+
+        // Destructor
+        virtual ~GzipStreamCompressor();
+
+        // set the compression level used by the next begin() (0..9)
+        void set_level(int level);
+
+        // current compression level
+        int level();
+
+        // begin a gzip stream into "out"
+        bool begin(uint8_t *out,uint32_t out_length);
+
+        // compress the next input block
+        bool compress(const uint8_t *in,uint32_t in_length);
+
+        // finish the gzip stream
+        bool finish();
+
+        // compressed length so far
+        uint32_t length();
+
+        // peak workspace used (bytes)
+        uint32_t peak_memory();
+
+        // worst case gzip stream length for "in_length" input bytes (incompressible input... deflate framing plus the gzip wrapper)
+        static uint32_t bound(uint32_t in_length);
+
+        // zlib allocator hooks (workspace)
+        void *alloc(uint32_t length);
+
+    private:
+        // release the zlib stream
+        void end();
+
+        z_stream    m_stream;
+        uint8_t    *m_workspace;
+        uint32_t    m_workspace_length;
+        uint32_t    m_workspace_used;
+        uint32_t    m_peak;
+        int         m_window_bits;
+        int         m_mem_level;
+        int         m_level;
+        bool        m_active;
+};
+
+#endif // __GZIP_STREAM_COMPRESSOR_H__
@@ -0,0 +1,634 @@
+/**
+ * @file    ImageFingerprint.cpp
+ * @brief   mbed Endpoint JPEG luma grid fingerprint
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Class
+#include "ImageFingerprint.h"
+
+// JPEG markers
+#define JPEG_MARKER_PREFIX				0xFF
+#define JPEG_MARKER_SOF0				0xC0		// baseline
+#define JPEG_MARKER_SOF1				0xC1		// extended sequential (Huffman)
+#define JPEG_MARKER_DHT					0xC4
+#define JPEG_MARKER_DAC					0xCC
+#define JPEG_MARKER_SOF15				0xCF
+#define JPEG_MARKER_RST0				0xD0
+#define JPEG_MARKER_RST7				0xD7
+#define JPEG_MARKER_SOI					0xD8
+#define JPEG_MARKER_EOI					0xD9
+#define JPEG_MARKER_SOS					0xDA
+#define JPEG_MARKER_DQT					0xDB
+#define JPEG_MARKER_TEM					0x01
+
+// luma of a dequantized DC coefficient (the block mean is DC/8... level shifted by 128)
+#define DC_TO_LUMA(dc)					(((dc) / 8) + 128)
+
+// Default constructor
+ImageFingerprint::ImageFingerprint() {
+    this->begin();
+}
+
+// Destructor
+ImageFingerprint::~ImageFingerprint() {
+}
+
+// clear the fingerprint
+void ImageFingerprint::begin() {
+    memset(this->m_luma,0,sizeof(this->m_luma));
+    this->m_valid = false;
+}
+
+// true once a whole picture has been decoded into it
+bool ImageFingerprint::valid() const {
+    return this->m_valid;
+}
+
+// mean luma of a cell
+int ImageFingerprint::luma(int index) const {
+    return (index >= 0 && index < FINGERPRINT_CELLS) ? (int)this->m_luma[index] : 0;
+}
+
+// difference from another fingerprint: share of the cells (per mille) that changed beyond the shift of the whole picture
+int ImageFingerprint::difference(const ImageFingerprint &other) const {
+    if (this->valid() == false || other.valid() == false) {
+        return FINGERPRINT_MAX_DIFFERENCE;
+    }
+
+    // exposure: the mean shift of the whole picture
+    int shift = 0;
+    for(int i=0;i<FINGERPRINT_CELLS;++i) {
+        shift += (int)this->m_luma[i] - (int)other.m_luma[i];
+    }
+    shift /= FINGERPRINT_CELLS;
+
+    // cells that moved beyond it
+    int changed = 0;
+    for(int i=0;i<FINGERPRINT_CELLS;++i) {
+        int delta = (int)this->m_luma[i] - (int)other.m_luma[i] - shift;
+        if (delta > FINGERPRINT_CELL_THRESHOLD || delta < -FINGERPRINT_CELL_THRESHOLD) {
+            ++changed;
+        }
+    }
+    return (changed * FINGERPRINT_MAX_DIFFERENCE) / FINGERPRINT_CELLS;
+}
+
+// Default constructor
+ImageFingerprintDecoder::ImageFingerprintDecoder() {
+    for(int i=0;i<2;++i) {
+        this->m_dc[i].values = this->m_dc_values[i];
+        this->m_dc[i].max_values = FINGERPRINT_MAX_DC_SYMBOLS;
+        this->m_ac[i].values = this->m_ac_values[i];
+        this->m_ac[i].max_values = FINGERPRINT_MAX_AC_SYMBOLS;
+    }
+    this->begin(NULL);
+}
+
+// Destructor
+ImageFingerprintDecoder::~ImageFingerprintDecoder() {
+}
+
+// begin decoding a picture into "fingerprint"
+void ImageFingerprintDecoder::begin(ImageFingerprint *fingerprint) {
+    this->m_fingerprint = fingerprint;
+    if (fingerprint != NULL) {
+        fingerprint->begin();
+    }
+    this->m_state = PARSE_SEARCH;
+    this->m_marker = 0;
+    this->m_length = 0;
+    this->m_pos = 0;
+    this->m_table_pos = 0;
+    this->m_table_length = 0;
+    this->m_table_precision = 0;
+    this->m_table_class = 0;
+    this->m_table_id = 0;
+    this->m_scan_ff = false;
+    for(int i=0;i<4;++i) {
+        this->m_quant[i] = 0;
+    }
+    for(int i=0;i<2;++i) {
+        this->m_dc[i].defined = false;
+        this->m_dc[i].num_values = 0;
+        this->m_ac[i].defined = false;
+        this->m_ac[i].num_values = 0;
+    }
+    this->m_num_components = 0;
+    this->m_width = 0;
+    this->m_height = 0;
+    this->m_hmax = 1;
+    this->m_vmax = 1;
+    this->m_frame = false;
+    this->m_scan_components = 0;
+    this->m_mcu_blocks = 0;
+    this->m_mcus_per_line = 0;
+    this->m_luma_blocks_wide = 0;
+    this->m_luma_blocks_high = 0;
+    this->m_scan_state = SCAN_DC_CODE;
+    this->m_code = 0;
+    this->m_code_length = 0;
+    this->m_need = 0;
+    this->m_value = 0;
+    this->m_size = 0;
+    this->m_k = 0;
+    this->m_block = 0;
+    this->m_mcu = 0;
+    this->m_failed = (fingerprint == NULL);
+    memset(this->m_predictor,0,sizeof(this->m_predictor));
+    memset(this->m_sums,0,sizeof(this->m_sums));
+    memset(this->m_counts,0,sizeof(this->m_counts));
+}
+
+// add the next block of JPEG data
+void ImageFingerprintDecoder::update(const uint8_t *data,uint32_t length) {
+    for(uint32_t i=0;i<length && this->m_failed == false;++i) {
+        uint8_t b = data[i];
+        switch (this->m_state) {
+            case PARSE_SEARCH:
+                if (b == JPEG_MARKER_PREFIX) {
+                    this->m_state = PARSE_MARKER;
+                }
+                break;
+            case PARSE_MARKER:
+                if (b != JPEG_MARKER_PREFIX) {
+                    // (0xFF is a fill byte... still a marker)
+                    this->marker(b);
+                }
+                break;
+            case PARSE_LENGTH_HI:
+                this->m_length = ((uint32_t)b) << 8;
+                this->m_state = PARSE_LENGTH_LO;
+                break;
+            case PARSE_LENGTH_LO:
+                this->m_length |= b;
+                this->m_length = (this->m_length > 2) ? this->m_length - 2 : 0;
+                this->m_pos = 0;
+                this->m_table_pos = 0;
+                this->m_state = PARSE_SEGMENT;
+                if (this->m_length == 0) {
+                    this->end_segment();
+                }
+                break;
+            case PARSE_SEGMENT:
+                this->segment_byte(b);
+                ++this->m_pos;
+                if (this->m_pos == this->m_length) {
+                    this->end_segment();
+                }
+                break;
+            case PARSE_SCAN:
+                // entropy coded data: 0xFF00 is a stuffed 0xFF, RSTn resets, any other marker ends the scan
+                if (this->m_scan_ff) {
+                    if (b == 0x00) {
+                        this->m_scan_ff = false;
+                        this->scan_byte(JPEG_MARKER_PREFIX);
+                    }
+                    else if (b != JPEG_MARKER_PREFIX) {
+                        this->m_scan_ff = false;
+                        if (b >= JPEG_MARKER_RST0 && b <= JPEG_MARKER_RST7) {
+                            this->restart();
+                        }
+                        else {
+                            this->marker(b);
+                        }
+                    }
+                }
+                else if (b == JPEG_MARKER_PREFIX) {
+                    this->m_scan_ff = true;
+                }
+                else {
+                    this->scan_byte(b);
+                }
+                break;
+            case PARSE_DONE:
+            default:
+                return;
+        }
+    }
+}
+
+// a marker (after 0xFF)
+void ImageFingerprintDecoder::marker(uint8_t b) {
+    this->m_state = PARSE_SEARCH;
+    if (b == JPEG_MARKER_EOI) {
+        this->finish();
+        return;
+    }
+    if (b == JPEG_MARKER_SOI || b == JPEG_MARKER_TEM || (b >= JPEG_MARKER_RST0 && b <= JPEG_MARKER_RST7)) {
+        // standalone marker (no length)
+        return;
+    }
+    if (b >= JPEG_MARKER_SOF0 && b <= JPEG_MARKER_SOF15 && b != JPEG_MARKER_SOF0 && b != JPEG_MARKER_SOF1 && b != JPEG_MARKER_DHT && b != JPEG_MARKER_DAC) {
+        // progressive, lossless, hierarchical or arithmetic coded
+        this->fail();
+        return;
+    }
+    this->m_marker = b;
+    this->m_state = PARSE_LENGTH_HI;
+}
+
+// the next byte of a marker segment
+void ImageFingerprintDecoder::segment_byte(uint8_t b) {
+    switch (this->m_marker) {
+        case JPEG_MARKER_DQT:
+            // tables: Pq/Tq then 64 entries (8 or 16 bit)... we only need entry 0 (DC)
+            if (this->m_table_pos == 0) {
+                this->m_table_precision = (b >> 4);
+                this->m_table_id = (b & 0x03);
+                this->m_table_length = 1 + 64 * (this->m_table_precision ? 2 : 1);
+                this->m_quant[this->m_table_id] = 0;
+            }
+            else if (this->m_table_pos == 1) {
+                this->m_quant[this->m_table_id] = this->m_table_precision ? (uint16_t)(b << 8) : b;
+            }
+            else if (this->m_table_pos == 2 && this->m_table_precision) {
+                this->m_quant[this->m_table_id] |= b;
+            }
+            if (++this->m_table_pos == this->m_table_length) {
+                this->m_table_pos = 0;
+            }
+            break;
+        case JPEG_MARKER_DHT: {
+            // tables: Tc/Th, 16 code counts, then the symbols
+            if (this->m_table_pos == 0) {
+                int table_class = (b >> 4);
+                this->m_table_id = (b & 0x0F);
+                if (table_class > 1 || this->m_table_id > 1) {
+                    this->fail();
+                    return;
+                }
+                this->m_table_class = table_class;
+                huffman_table_t *table = table_class ? &this->m_ac[this->m_table_id] : &this->m_dc[this->m_table_id];
+                table->defined = false;
+                table->num_values = 0;
+                this->m_table_length = 0;
+                ++this->m_table_pos;
+                break;
+            }
+            huffman_table_t *table = this->m_table_class ? &this->m_ac[this->m_table_id] : &this->m_dc[this->m_table_id];
+            if (this->m_table_pos <= 16) {
+                table->counts[this->m_table_pos - 1] = b;
+                this->m_table_length += b;
+                if (this->m_table_pos == 16) {
+                    if (this->m_table_length > table->max_values || this->build_table(table) == false) {
+                        this->fail();
+                        return;
+                    }
+                    if (this->m_table_length == 0) {
+                        this->m_table_pos = 0;
+                        break;
+                    }
+                }
+                ++this->m_table_pos;
+                break;
+            }
+            table->values[table->num_values++] = b;
+            if (table->num_values == this->m_table_length) {
+                table->defined = true;
+                this->m_table_pos = 0;
+            }
+            break;
+        }
+        case JPEG_MARKER_SOF0:
+        case JPEG_MARKER_SOF1:
+        case JPEG_MARKER_SOS:
+            // small headers: parsed when complete
+            if (this->m_pos >= FINGERPRINT_SEGMENT_LEN) {
+                this->fail();
+                return;
+            }
+            this->m_segment[this->m_pos] = b;
+            break;
+        default:
+            // skipped (APPn, COM, DRI... restart markers are seen in the scan)
+            break;
+    }
+}
+
+// a marker segment is complete
+void ImageFingerprintDecoder::end_segment() {
+    this->m_state = PARSE_SEARCH;
+    if (this->m_marker == JPEG_MARKER_SOF0 || this->m_marker == JPEG_MARKER_SOF1) {
+        this->start_frame();
+    }
+    else if (this->m_marker == JPEG_MARKER_SOS) {
+        this->start_scan();
+    }
+    else if (this->m_marker == JPEG_MARKER_DHT && this->m_table_pos != 0) {
+        // truncated table
+        this->fail();
+    }
+}
+
+// parse the frame header: P, Y, X, Nf then (id, HV, Tq) per component
+void ImageFingerprintDecoder::start_frame() {
+    const uint8_t *s = this->m_segment;
+    if (this->m_length < 6 || s[0] != 8 || s[5] < 1 || s[5] > FINGERPRINT_MAX_COMPONENTS || this->m_length < (uint32_t)(6 + 3 * s[5])) {
+        this->fail();
+        return;
+    }
+    this->m_height = (s[1] << 8) | s[2];
+    this->m_width = (s[3] << 8) | s[4];
+    this->m_num_components = s[5];
+    this->m_hmax = 1;
+    this->m_vmax = 1;
+    for(int i=0;i<this->m_num_components;++i) {
+        component_t *c = &this->m_components[i];
+        c->id = s[6 + 3 * i];
+        c->h = (s[7 + 3 * i] >> 4);
+        c->v = (s[7 + 3 * i] & 0x0F);
+        c->tq = (s[8 + 3 * i] & 0x03);
+        if (c->h < 1 || c->h > 4 || c->v < 1 || c->v > 4) {
+            this->fail();
+            return;
+        }
+        if (c->h > this->m_hmax) this->m_hmax = c->h;
+        if (c->v > this->m_vmax) this->m_vmax = c->v;
+    }
+    if (this->m_width == 0 || this->m_height == 0) {
+        // (DNL: height defined after the scan... not from these cameras)
+        this->fail();
+        return;
+    }
+
+    // luma (the first component) in blocks
+    const component_t *luma = &this->m_components[0];
+    int luma_width = (this->m_width * luma->h + this->m_hmax - 1) / this->m_hmax;
+    int luma_height = (this->m_height * luma->v + this->m_vmax - 1) / this->m_vmax;
+    this->m_luma_blocks_wide = (luma_width + 7) / 8;
+    this->m_luma_blocks_high = (luma_height + 7) / 8;
+    this->m_frame = true;
+}
+
+// parse the scan header: Ns, (Cs, Td/Ta) per component, Ss, Se, Ah/Al... then lay out the MCU
+void ImageFingerprintDecoder::start_scan() {
+    const uint8_t *s = this->m_segment;
+    if (this->m_frame == false || this->m_length < 1 || s[0] < 1 || s[0] > this->m_num_components || this->m_length < (uint32_t)(4 + 2 * s[0])) {
+        this->fail();
+        return;
+    }
+    int ns = s[0];
+    const uint8_t *spectral = s + 1 + 2 * ns;
+    if (spectral[0] != 0 || spectral[1] != 63 || spectral[2] != 0) {
+        // not a sequential scan
+        this->fail();
+        return;
+    }
+    this->m_scan_components = ns;
+    this->m_mcu_blocks = 0;
+    for(int i=0;i<ns;++i) {
+        int frame_component = -1;
+        for(int j=0;j<this->m_num_components;++j) {
+            if (this->m_components[j].id == s[1 + 2 * i]) {
+                frame_component = j;
+            }
+        }
+        int td = (s[2 + 2 * i] >> 4);
+        int ta = (s[2 + 2 * i] & 0x0F);
+        if (frame_component < 0 || td > 1 || ta > 1 || this->m_dc[td].defined == false || this->m_ac[ta].defined == false) {
+            this->fail();
+            return;
+        }
+        this->m_scan_frame_component[i] = (uint8_t)frame_component;
+        this->m_scan_dc[i] = (uint8_t)td;
+        this->m_scan_ac[i] = (uint8_t)ta;
+
+        // blocks of this component in the MCU (a single component scan has one block per MCU)
+        const component_t *c = &this->m_components[frame_component];
+        int h = (ns == 1) ? 1 : c->h;
+        int v = (ns == 1) ? 1 : c->v;
+        for(int y=0;y<v;++y) {
+            for(int x=0;x<h;++x) {
+                if (this->m_mcu_blocks >= FINGERPRINT_MAX_MCU_BLOCKS) {
+                    this->fail();
+                    return;
+                }
+                this->m_mcu_component[this->m_mcu_blocks] = (uint8_t)i;
+                this->m_mcu_h[this->m_mcu_blocks] = (uint8_t)x;
+                this->m_mcu_v[this->m_mcu_blocks] = (uint8_t)y;
+                ++this->m_mcu_blocks;
+            }
+        }
+    }
+    if (ns == 1) {
+        // non interleaved: the component's own blocks in raster order
+        const component_t *c = &this->m_components[this->m_scan_frame_component[0]];
+        int width = (this->m_width * c->h + this->m_hmax - 1) / this->m_hmax;
+        this->m_mcus_per_line = (width + 7) / 8;
+    }
+    else {
+        this->m_mcus_per_line = (this->m_width + 8 * this->m_hmax - 1) / (8 * this->m_hmax);
+    }
+    this->m_mcu = 0;
+    this->m_block = 0;
+    this->m_scan_state = SCAN_DC_CODE;
+    this->m_scan_ff = false;
+    this->restart();
+    this->m_state = PARSE_SCAN;
+}
+
+// build the canonical codes of a Huffman table from its counts
+bool ImageFingerprintDecoder::build_table(huffman_table_t *table) {
+    uint32_t code = 0;
+    int k = 0;
+    for(int length=1;length<=16;++length) {
+        table->mincode[length - 1] = (uint16_t)code;
+        table->valptr[length - 1] = (uint8_t)k;
+        code += table->counts[length - 1];
+        k += table->counts[length - 1];
+        if (code > (1UL << length)) {
+            // over subscribed
+            return false;
+        }
+        code <<= 1;
+    }
+    return true;
+}
+
+// the next (unstuffed) byte of entropy coded data
+void ImageFingerprintDecoder::scan_byte(uint8_t b) {
+    for(int bit=7;bit>=0 && this->m_state == PARSE_SCAN;--bit) {
+        this->scan_bit((b >> bit) & 1);
+    }
+}
+
+// the next bit of entropy coded data
+void ImageFingerprintDecoder::scan_bit(int bit) {
+    int c = this->m_mcu_component[this->m_block];
+    switch (this->m_scan_state) {
+        case SCAN_DC_CODE:
+        case SCAN_AC_CODE: {
+            // extend the code until a symbol of that length matches
+            const huffman_table_t *table = (this->m_scan_state == SCAN_DC_CODE) ? &this->m_dc[this->m_scan_dc[c]] : &this->m_ac[this->m_scan_ac[c]];
+            this->m_code = (this->m_code << 1) | (uint32_t)bit;
+            int length = ++this->m_code_length;
+            if (length > 16) {
+                this->fail();
+                return;
+            }
+            uint32_t offset = this->m_code - table->mincode[length - 1];
+            if (this->m_code < table->mincode[length - 1] || offset >= table->counts[length - 1]) {
+                return;
+            }
+            int symbol = table->values[table->valptr[length - 1] + offset];
+            this->m_code = 0;
+            this->m_code_length = 0;
+            if (this->m_scan_state == SCAN_DC_CODE) {
+                // DC: the size of the difference
+                this->m_size = symbol;
+                this->m_need = symbol;
+                this->m_value = 0;
+                if (symbol > 11) {
+                    this->fail();
+                    return;
+                }
+                if (symbol == 0) {
+                    this->m_scan_state = SCAN_AC_CODE;
+                    this->m_k = 1;
+                }
+                else {
+                    this->m_scan_state = SCAN_DC_BITS;
+                }
+                return;
+            }
+
+            // AC: run/size... EOB and ZRL have no bits
+            int run = (symbol >> 4);
+            int size = (symbol & 0x0F);
+            if (size == 0) {
+                if (run == 15) {
+                    this->m_k += 16;
+                    if (this->m_k > 63) {
+                        this->end_block();
+                    }
+                }
+                else {
+                    this->end_block();
+                }
+                return;
+            }
+            this->m_k += run;
+            this->m_need = size;
+            this->m_scan_state = SCAN_AC_BITS;
+            return;
+        }
+        case SCAN_DC_BITS: {
+            this->m_value = (this->m_value << 1) | bit;
+            if (--this->m_need > 0) {
+                return;
+            }
+
+            // sign extend the difference and predict
+            int diff = this->m_value;
+            if (diff < (1 << (this->m_size - 1))) {
+                diff -= (1 << this->m_size) - 1;
+            }
+            this->m_predictor[c] += diff;
+            this->m_scan_state = SCAN_AC_CODE;
+            this->m_k = 1;
+            return;
+        }
+        case SCAN_AC_BITS:
+        default:
+            // AC coefficient bits are dropped
+            if (--this->m_need > 0) {
+                return;
+            }
+            ++this->m_k;
+            if (this->m_k > 63) {
+                this->end_block();
+            }
+            else {
+                this->m_scan_state = SCAN_AC_CODE;
+            }
+            return;
+    }
+}
+
+// a block has been decoded: a luma block adds its DC to its cell
+void ImageFingerprintDecoder::end_block() {
+    int c = this->m_mcu_component[this->m_block];
+    int frame_component = this->m_scan_frame_component[c];
+    if (frame_component == 0) {
+        int bx = 0;
+        int by = 0;
+        if (this->m_scan_components == 1) {
+            bx = (int)(this->m_mcu % this->m_mcus_per_line);
+            by = (int)(this->m_mcu / this->m_mcus_per_line);
+        }
+        else {
+            const component_t *luma = &this->m_components[0];
+            bx = (int)(this->m_mcu % this->m_mcus_per_line) * luma->h + this->m_mcu_h[this->m_block];
+            by = (int)(this->m_mcu / this->m_mcus_per_line) * luma->v + this->m_mcu_v[this->m_block];
+        }
+
+        // (interleaved MCUs pad past the edge of the picture)
+        if (bx < this->m_luma_blocks_wide && by < this->m_luma_blocks_high) {
+            int cell = ((by * FINGERPRINT_GRID_HEIGHT) / this->m_luma_blocks_high) * FINGERPRINT_GRID_WIDTH + (bx * FINGERPRINT_GRID_WIDTH) / this->m_luma_blocks_wide;
+            this->m_sums[cell] += this->m_predictor[c] * (int32_t)this->m_quant[this->m_components[0].tq];
+            ++this->m_counts[cell];
+        }
+    }
+
+    // next block
+    this->m_scan_state = SCAN_DC_CODE;
+    this->m_code = 0;
+    this->m_code_length = 0;
+    if (++this->m_block == this->m_mcu_blocks) {
+        this->m_block = 0;
+        ++this->m_mcu;
+    }
+}
+
+// restart marker: predictors and bit alignment reset (the MCU count goes on... the padding bits never form a code)
+void ImageFingerprintDecoder::restart() {
+    if (this->m_block != 0 || this->m_scan_state != SCAN_DC_CODE) {
+        // the interval ended inside an MCU
+        this->fail();
+        return;
+    }
+    memset(this->m_predictor,0,sizeof(this->m_predictor));
+    this->m_code = 0;
+    this->m_code_length = 0;
+}
+
+// EOI: the mean luma of each cell
+void ImageFingerprintDecoder::finish() {
+    this->m_state = PARSE_DONE;
+    if (this->m_failed || this->m_fingerprint == NULL) {
+        return;
+    }
+    int filled = 0;
+    for(int i=0;i<FINGERPRINT_CELLS;++i) {
+        int luma = 128;
+        if (this->m_counts[i] > 0) {
+            luma = DC_TO_LUMA(this->m_sums[i] / this->m_counts[i]);
+            ++filled;
+        }
+        this->m_fingerprint->m_luma[i] = (uint8_t)((luma < 0) ? 0 : ((luma > 255) ? 255 : luma));
+    }
+    this->m_fingerprint->m_valid = (filled > 0);
+}
+
+// the picture cannot be fingerprinted
+void ImageFingerprintDecoder::fail() {
+    this->m_failed = true;
+    this->m_state = PARSE_DONE;
+}
@@ -0,0 +1,238 @@
+/**
+ * @file    ImageFingerprint.h
+ * @brief   mbed Endpoint JPEG luma grid fingerprint (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __IMAGE_FINGERPRINT_H__
+#define __IMAGE_FINGERPRINT_H__
+
+// mbed API
+#include "mbed.h"
+
+// difference scale (difference() returns 0..FINGERPRINT_MAX_DIFFERENCE)
+#define FINGERPRINT_MAX_DIFFERENCE		1000
+
+// TUNE: luma grid (cells across and down... 4:3 like the camera)
+#define FINGERPRINT_GRID_WIDTH			8
+#define FINGERPRINT_GRID_HEIGHT			6
+#define FINGERPRINT_CELLS				(FINGERPRINT_GRID_WIDTH * FINGERPRINT_GRID_HEIGHT)
+
+// TUNE: a cell has changed when its mean luma moves more than this (0..255) beyond the shift of the whole picture
+#define FINGERPRINT_CELL_THRESHOLD		16
+
+// decoder limits: baseline JPEG (8 bit samples, Huffman tables 0..1, up to 4 components of up to 2x2 sampling)
+#define FINGERPRINT_MAX_COMPONENTS		4
+#define FINGERPRINT_MAX_MCU_BLOCKS		10
+#define FINGERPRINT_MAX_DC_SYMBOLS		12
+#define FINGERPRINT_MAX_AC_SYMBOLS		162
+#define FINGERPRINT_SEGMENT_LEN			(6 + 3 * FINGERPRINT_MAX_COMPONENTS)
+
+/**
+ * Perceptual fingerprint of a JPEG: the mean luma of a coarse grid of cells, taken from the DC coefficients of the
+ * luma blocks (the average of each 8x8 block... no IDCT). Sensor noise and recompression change the entropy coded
+ * bytes of every capture, but hardly move the cell means: difference() is the share of cells (per mille) whose
+ * luma changed beyond FINGERPRINT_CELL_THRESHOLD once the shift of the whole picture (exposure) is taken out.
+ * Built by an ImageFingerprintDecoder as the camera blocks arrive... invalid (never a duplicate) unless the whole
+ * picture decoded.
+ */
+class ImageFingerprint {
+    public:
+        // Default constructor
+        ImageFingerprint();
+
+        // Destructor
+        virtual ~ImageFingerprint();
+
+        // clear the fingerprint (invalid)
+        void begin();
+
+        // true once a whole picture has been decoded into it
+        bool valid() const;
+
+        // mean luma of cell "index" (0..255... row major)
+        int luma(int index) const;
+
+        // difference from another fingerprint (0: same scene... FINGERPRINT_MAX_DIFFERENCE: every cell changed, or either is invalid)
+        int difference(const ImageFingerprint &other) const;
+
+    private:
+        friend class ImageFingerprintDecoder;
+
+        uint8_t     m_luma[FINGERPRINT_CELLS];
+        bool        m_valid;
+};
+
+/**
+ * Streaming baseline JPEG decoder that only keeps the luma DC coefficients: the markers are parsed byte by byte
+ * (DQT, SOF0/1, DHT, SOS... anything else is skipped), the scan is Huffman decoded bit by bit (DC differences summed
+ * into their grid cell, AC coefficients decoded and dropped) so nothing is buffered. One decoder serves every capture
+ * (its tables are ~1 KB): begin() a fingerprint, update() each block, the fingerprint becomes valid at EOI.
+ * Progressive, arithmetic coded, 12 bit or corrupt pictures leave it invalid.
+ */
+class ImageFingerprintDecoder {
+    public:
+        // Default constructor
+        ImageFingerprintDecoder();
+
+        // Destructor
+        virtual ~ImageFingerprintDecoder();
+
+        // begin decoding a picture into "fingerprint"
+        void begin(ImageFingerprint *fingerprint);
+
+        // add the next block of JPEG data
+        void update(const uint8_t *data,uint32_t length);
+
+    private:
+        // JPEG marker parse states
+        enum ParseStates {
+            PARSE_SEARCH=0,
+            PARSE_MARKER=1,
+            PARSE_LENGTH_HI=2,
+            PARSE_LENGTH_LO=3,
+            PARSE_SEGMENT=4,
+            PARSE_SCAN=5,
+            PARSE_DONE=6
+        };
+
+        // scan (bit level) decode states
+        enum ScanStates {
+            SCAN_DC_CODE=0,
+            SCAN_DC_BITS=1,
+            SCAN_AC_CODE=2,
+            SCAN_AC_BITS=3
+        };
+
+        // canonical Huffman table (codes by length)
+        typedef struct {
+            uint8_t     counts[16];
+            uint16_t    mincode[16];
+            uint8_t     valptr[16];
+            uint8_t    *values;
+            int         max_values;
+            int         num_values;
+            bool        defined;
+        } huffman_table_t;
+
+        // frame component
+        typedef struct {
+            uint8_t     id;
+            uint8_t     h;
+            uint8_t     v;
+            uint8_t     tq;
+        } component_t;
+
+        // a marker (after 0xFF)
+        void marker(uint8_t b);
+
+        // the next byte of a marker segment
+        void segment_byte(uint8_t b);
+
+        // a marker segment is complete
+        void end_segment();
+
+        // parse the frame header (SOF0/SOF1)
+        void start_frame();
+
+        // parse the scan header (SOS) and lay out the MCU
+        void start_scan();
+
+        // build the codes of a Huffman table
+        bool build_table(huffman_table_t *table);
+
+        // the next (unstuffed) byte of entropy coded data
+        void scan_byte(uint8_t b);
+
+        // the next bit of entropy coded data
+        void scan_bit(int bit);
+
+        // a block has been decoded
+        void end_block();
+
+        // restart marker: predictors and bit alignment reset
+        void restart();
+
+        // EOI: finish the fingerprint
+        void finish();
+
+        // the picture cannot be fingerprinted
+        void fail();
+
+        ImageFingerprint   *m_fingerprint;
+        ParseStates         m_state;
+        uint8_t             m_marker;
+        uint32_t            m_length;
+        uint32_t            m_pos;
+        uint8_t             m_segment[FINGERPRINT_SEGMENT_LEN];
+        int                 m_table_pos;
+        int                 m_table_length;
+        int                 m_table_precision;
+        int                 m_table_class;
+        int                 m_table_id;
+        bool                m_scan_ff;
+
+        // tables
+        uint16_t            m_quant[4];
+        huffman_table_t     m_dc[2];
+        huffman_table_t     m_ac[2];
+        uint8_t             m_dc_values[2][FINGERPRINT_MAX_DC_SYMBOLS];
+        uint8_t             m_ac_values[2][FINGERPRINT_MAX_AC_SYMBOLS];
+
+        // frame
+        component_t         m_components[FINGERPRINT_MAX_COMPONENTS];
+        int                 m_num_components;
+        int                 m_width;
+        int                 m_height;
+        int                 m_hmax;
+        int                 m_vmax;
+        bool                m_frame;
+
+        // scan layout
+        uint8_t             m_mcu_component[FINGERPRINT_MAX_MCU_BLOCKS];    // scan component of each block of the MCU
+        uint8_t             m_mcu_h[FINGERPRINT_MAX_MCU_BLOCKS];
+        uint8_t             m_mcu_v[FINGERPRINT_MAX_MCU_BLOCKS];
+        uint8_t             m_scan_frame_component[FINGERPRINT_MAX_COMPONENTS];
+        uint8_t             m_scan_dc[FINGERPRINT_MAX_COMPONENTS];
+        uint8_t             m_scan_ac[FINGERPRINT_MAX_COMPONENTS];
+        int                 m_scan_components;
+        int                 m_mcu_blocks;
+        int                 m_mcus_per_line;
+        int                 m_luma_blocks_wide;
+        int                 m_luma_blocks_high;
+
+        // scan decode
+        ScanStates          m_scan_state;
+        uint32_t            m_code;
+        int                 m_code_length;
+        int                 m_need;
+        int                 m_value;
+        int                 m_size;
+        int                 m_k;
+        int                 m_block;
+        uint32_t            m_mcu;
+        int                 m_predictor[FINGERPRINT_MAX_COMPONENTS];
+        bool                m_failed;
+
+        // luma grid
+        int32_t             m_sums[FINGERPRINT_CELLS];
+        uint16_t            m_counts[FINGERPRINT_CELLS];
+};
+
+#endif // __IMAGE_FINGERPRINT_H__
@@ -0,0 +1,91 @@
+/**
+ * @file    LockFreeRing.h
+ * @brief   mbed Endpoint lock-free single producer/single consumer ring (header only)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LOCK_FREE_RING_H__
+#define __LOCK_FREE_RING_H__
+
+// mbed API
+#include "mbed.h"
+
+/**
+ * Fixed size ring for exactly one producer and one consumer (e.g. an ISR and a thread) with no locks.
+ * The producer only writes m_head and the consumer only writes m_tail... each is published after its
+ * element access with a memory barrier. N must be a power of two (one slot is never used: full is head+1 == tail).
+ */
+template <typename T, uint32_t N>
+class LockFreeRing {
+    public:
+        // Default constructor
+        LockFreeRing() : m_head(0), m_tail(0) {
+        }
+
+        // PRODUCER: add an element (false if the ring is full... the element is dropped)
+        bool push(const T &element) {
+            uint32_t head = this->m_head;
+            uint32_t next = (head + 1) & (N - 1);
+            if (next == this->m_tail) {
+                return false;
+            }
+            this->m_elements[head] = element;
+            __DMB();
+            this->m_head = next;
+            return true;
+        }
+
+        // CONSUMER: remove the oldest element (false if the ring is empty)
+        bool pop(T &element) {
+            uint32_t tail = this->m_tail;
+            if (tail == this->m_head) {
+                return false;
+            }
+            __DMB();
+            element = this->m_elements[tail];
+            __DMB();
+            this->m_tail = (tail + 1) & (N - 1);
+            return true;
+        }
+
+        // either side: true if nothing is queued (a snapshot... may change immediately)
+        bool empty() const {
+            return (this->m_head == this->m_tail);
+        }
+
+        // either side: number of queued elements (a snapshot)
+        uint32_t count() const {
+            return (this->m_head - this->m_tail) & (N - 1);
+        }
+
+        // usable capacity
+        uint32_t capacity() const {
+            return N - 1;
+        }
+
+    private:
+        // N must be a power of two
+        typedef char power_of_two_check[((N & (N - 1)) == 0 && N >= 2) ? 1 : -1];
+
+        T                   m_elements[N];
+        volatile uint32_t   m_head;
+        volatile uint32_t   m_tail;
+};
+
+#endif // __LOCK_FREE_RING_H__
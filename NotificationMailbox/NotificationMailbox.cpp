@@ -0,0 +1,254 @@
+/**
+ * @file    NotificationMailbox.cpp
+ * @brief   mbed Endpoint latest-value-wins notification mailbox
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Class
+#include "NotificationMailbox.h"
+
+// shared event queue
+#include "SharedEventQueue.h"
+
+// Default constructor
+NotificationMailbox::NotificationMailbox(MailboxSendResults (*send)(void),void (*done)(void)) {
+    this->m_send = send;
+    this->m_done = done;
+    this->m_pmin_ms = 0;
+    this->m_pmax_ms = 0;
+    this->m_step = 0.0;
+    this->m_held_level = 0.0;
+    this->m_has_held = false;
+    this->m_force = false;
+    this->m_last_level = 0.0;
+    this->m_has_last = false;
+    this->m_last_sent_ms = 0;
+    this->m_in_flight = false;
+    this->m_flush_scheduled = false;
+    this->m_timeout_id = 0;
+    this->m_pmax_id = 0;
+    this->m_sent = 0;
+    this->m_coalesced = 0;
+    this->m_clock.start();
+}
+
+// Destructor
+NotificationMailbox::~NotificationMailbox() {
+}
+
+// configure coalescing
+void NotificationMailbox::configure(int pmin_ms,int pmax_ms,float step) {
+    this->m_mutex.lock();
+    this->m_pmin_ms = (pmin_ms > 0) ? pmin_ms : 0;
+    this->m_pmax_ms = (pmax_ms > 0) ? pmax_ms : 0;
+    this->m_step = (step > 0.0) ? step : 0.0;
+    this->m_mutex.unlock();
+}
+
+// the newest value
+void NotificationMailbox::post(const string &value,float level,bool force) {
+    this->m_mutex.lock();
+    if (this->m_has_held) {
+        // the held value was never sent... newest wins
+        ++this->m_coalesced;
+    }
+    this->m_held = value;
+    this->m_held_level = level;
+    this->m_has_held = true;
+    this->m_force = this->m_force || force;    // a newer value keeps the urgency of the one it replaces
+    if (this->m_flush_scheduled == false) {
+        this->schedule_flush(0);
+    }
+    this->m_mutex.unlock();
+}
+
+// the last notification was acknowledged
+void NotificationMailbox::delivered() {
+    this->m_mutex.lock();
+    if (this->m_timeout_id != 0) {
+        shared_event_queue()->cancel(this->m_timeout_id);
+        this->m_timeout_id = 0;
+    }
+    bool was_in_flight = this->m_in_flight;
+    this->m_in_flight = false;
+    if (this->m_has_held && this->m_flush_scheduled == false) {
+        this->schedule_flush(0);
+    }
+    this->m_mutex.unlock();
+
+    // a late acknowledgement (after the timeout) is not reported twice
+    if (was_in_flight && this->m_done != NULL) {
+        (*this->m_done)();
+    }
+}
+
+// the value being sent
+string NotificationMailbox::value() {
+    this->m_mutex.lock();
+    string value = this->m_value;
+    this->m_mutex.unlock();
+    return value;
+}
+
+// configuration
+int NotificationMailbox::pmin_ms() {
+    return this->m_pmin_ms;
+}
+int NotificationMailbox::pmax_ms() {
+    return this->m_pmax_ms;
+}
+float NotificationMailbox::step() {
+    return this->m_step;
+}
+
+// stats: notifications sent
+int NotificationMailbox::sent() {
+    return this->m_sent;
+}
+
+// stats: values coalesced away
+int NotificationMailbox::coalesced() {
+    return this->m_coalesced;
+}
+
+// EVENT QUEUE: send the held value if we may
+void NotificationMailbox::flush() {
+    this->m_mutex.lock();
+    this->m_flush_scheduled = false;
+    if (this->m_has_held == false || this->m_in_flight == true) {
+        // nothing to send... or delivered()/ack_timeout() will come back for it
+        this->m_mutex.unlock();
+        return;
+    }
+
+    // pmin: hold (newer values still replace it)
+    int since_ms = this->m_clock.read_ms() - this->m_last_sent_ms;
+    if (this->m_has_last && this->m_force == false && since_ms < this->m_pmin_ms) {
+        this->schedule_flush(this->m_pmin_ms - since_ms);
+        this->m_mutex.unlock();
+        return;
+    }
+
+    // step: not enough change to notify (pmax re-notifies eventually)
+    if (this->m_has_last && this->m_force == false && this->m_step > 0.0 && fabs(this->m_held_level - this->m_last_level) < this->m_step) {
+        ++this->m_coalesced;
+        this->m_has_held = false;
+        this->m_mutex.unlock();
+        return;
+    }
+
+    // send it (remember what we replace... a busy send puts it back)
+    float last_level = this->m_last_level;
+    bool has_last = this->m_has_last;
+    int last_sent_ms = this->m_last_sent_ms;
+    bool force = this->m_force;
+    this->m_value = this->m_held;
+    this->m_last_level = this->m_held_level;
+    this->m_has_last = true;
+    this->m_has_held = false;
+    this->m_force = false;
+    this->m_in_flight = true;
+    this->m_last_sent_ms = this->m_clock.read_ms();
+    ++this->m_sent;
+    if (this->m_pmax_id != 0) {
+        shared_event_queue()->cancel(this->m_pmax_id);
+        this->m_pmax_id = 0;
+    }
+    this->m_mutex.unlock();
+
+    MailboxSendResults result = (*this->m_send)();
+
+    // wait for the acknowledgement... and re-notify after pmax
+    this->m_mutex.lock();
+    if (result != MAILBOX_SENT) {
+        // nothing went out... nothing to acknowledge or re-notify
+        this->m_in_flight = false;
+        --this->m_sent;
+        if (result == MAILBOX_BUSY) {
+            // hold it again (a newer value wins) and retry
+            if (this->m_has_held == false) {
+                this->m_held = this->m_value;
+                this->m_held_level = this->m_last_level;
+                this->m_has_held = true;
+            }
+            this->m_force = this->m_force || force;
+            this->m_last_level = last_level;
+            this->m_has_last = has_last;
+            this->m_last_sent_ms = last_sent_ms;
+            if (this->m_flush_scheduled == false) {
+                this->schedule_flush(MAILBOX_RETRY_MS);
+            }
+        }
+        this->m_mutex.unlock();
+        return;
+    }
+    bool gave_up = false;
+    if (this->m_in_flight) {
+        this->m_timeout_id = shared_event_queue()->call_in(MAILBOX_ACK_TIMEOUT_MS,this,&NotificationMailbox::ack_timeout);
+        if (this->m_timeout_id == 0) {
+            // no timeout to wait with (event queue full)... do not wait for the acknowledgement
+            this->m_in_flight = false;
+            gave_up = true;
+        }
+    }
+    if (this->m_pmax_ms > 0) {
+        this->m_pmax_id = shared_event_queue()->call_in(this->m_pmax_ms,this,&NotificationMailbox::pmax_expired);
+    }
+    this->m_mutex.unlock();
+    if (gave_up && this->m_done != NULL) {
+        (*this->m_done)();
+    }
+}
+
+// EVENT QUEUE: no acknowledgement in time... move on
+void NotificationMailbox::ack_timeout() {
+    this->m_mutex.lock();
+    this->m_timeout_id = 0;
+    bool was_in_flight = this->m_in_flight;
+    this->m_in_flight = false;
+    if (this->m_has_held && this->m_flush_scheduled == false) {
+        this->schedule_flush(0);
+    }
+    this->m_mutex.unlock();
+    if (was_in_flight && this->m_done != NULL) {
+        (*this->m_done)();
+    }
+}
+
+// EVENT QUEUE: pmax passed without a notification... re-notify the last value
+void NotificationMailbox::pmax_expired() {
+    this->m_mutex.lock();
+    this->m_pmax_id = 0;
+    if (this->m_has_held == false && this->m_has_last) {
+        this->m_held = this->m_value;
+        this->m_held_level = this->m_last_level;
+        this->m_has_held = true;
+        this->m_force = true;
+        if (this->m_flush_scheduled == false) {
+            this->schedule_flush(0);
+        }
+    }
+    this->m_mutex.unlock();
+}
+
+// schedule flush() (mutex held)
+void NotificationMailbox::schedule_flush(int delay_ms) {
+    int id = (delay_ms > 0) ? shared_event_queue()->call_in(delay_ms,this,&NotificationMailbox::flush) : shared_event_queue()->call(this,&NotificationMailbox::flush);
+    this->m_flush_scheduled = (id != 0);
+}
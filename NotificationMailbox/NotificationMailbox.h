@@ -0,0 +1,123 @@
+/**
+ * @file    NotificationMailbox.h
+ * @brief   mbed Endpoint latest-value-wins notification mailbox (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NOTIFICATION_MAILBOX_H__
+#define __NOTIFICATION_MAILBOX_H__
+
+// mbed API
+#include "mbed.h"
+#include "mbed_events.h"
+
+// TUNE: the next notification goes out if the previous one is not acknowledged in time (ms)
+#define MAILBOX_ACK_TIMEOUT_MS			2000
+
+// TUNE: how soon a send that found the notification gate busy is retried (ms)
+#define MAILBOX_RETRY_MS				10
+
+// send() results
+enum MailboxSendResults {
+    MAILBOX_SENT=0,                     // observed... waiting for the acknowledgement
+    MAILBOX_IDLE=1,                     // nothing to send (the resource went idle since)
+    MAILBOX_BUSY=2                      // could not send without blocking... the value is held and retried
+};
+
+/**
+ * One pending notification per resource... the newest value wins. A value is held (and replaced by any newer one) while:
+ *   - the previous notification is still unacknowledged (a stalled link never queues stale values in mbed-client)
+ *   - less than pmin has passed since the last notification
+ * A value whose level moved less than step from the last notified level is dropped... pmax re-notifies the last value
+ * anyway. A value posted with "force" skips pmin and step (urgent: still one in flight at a time)... so does a newer
+ * value replacing it before it went out.
+ * Held values replaced or dropped are counted as coalesced.
+ * pmin/pmax/step 0: off (as LwM2M pmin/pmax/st).
+ * send() is called on the shared event queue... it reads value() and observe()s. It must not block: MAILBOX_BUSY holds
+ * the value again (unless a newer one arrived) and retries it. MAILBOX_IDLE: it had nothing to send... no notification
+ * is then in flight and nothing is counted.
+ * done() (optional) is called once per MAILBOX_SENT notification when it is acknowledged or its acknowledgement times
+ * out (from the delivering thread or the event queue)... a sender keeps the notification gate until then.
+ */
+class NotificationMailbox {
+    public:
+        // Default constructor
+        NotificationMailbox(MailboxSendResults (*send)(void),void (*done)(void) = NULL);
+
+        // Destructor
+        virtual ~NotificationMailbox();
+
+        // configure coalescing
+        void configure(int pmin_ms,int pmax_ms,float step);
+
+        // any thread: the newest value (and its numeric level for the step check... "force": notify it now whatever pmin and step say)
+        void post(const string &value,float level,bool force = false);
+
+        // any thread: the last notification was acknowledged (notification delivery callback)
+        void delivered();
+
+        // the value being sent (from send())
+        string value();
+
+        // configuration
+        int pmin_ms();
+        int pmax_ms();
+        float step();
+
+        // stats: notifications sent and values coalesced away
+        int sent();
+        int coalesced();
+
+    private:
+        // EVENT QUEUE: send the held value if we may
+        void flush();
+
+        // EVENT QUEUE: no acknowledgement in time
+        void ack_timeout();
+
+        // EVENT QUEUE: pmax passed without a notification
+        void pmax_expired();
+
+        // schedule flush() (mutex held)
+        void schedule_flush(int delay_ms);
+
+        MailboxSendResults (*m_send)(void);
+        void      (*m_done)(void);
+        Mutex       m_mutex;
+        Timer       m_clock;
+        int         m_pmin_ms;
+        int         m_pmax_ms;
+        float       m_step;
+        string      m_held;
+        float       m_held_level;
+        bool        m_has_held;
+        bool        m_force;
+        string      m_value;
+        float       m_last_level;
+        bool        m_has_last;
+        int         m_last_sent_ms;
+        bool        m_in_flight;
+        bool        m_flush_scheduled;
+        int         m_timeout_id;
+        int         m_pmax_id;
+        int         m_sent;
+        int         m_coalesced;
+};
+
+#endif // __NOTIFICATION_MAILBOX_H__
@@ -0,0 +1,189 @@
+/**
+ * @file    NotificationScheduler.cpp
+ * @brief   mbed Endpoint priority notification scheduler
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Class
+#include "NotificationScheduler.h"
+
+// the notification scheduler shared by all resources
+static NotificationScheduler __notification_scheduler;
+NotificationScheduler *notification_scheduler() {
+    return &__notification_scheduler;
+}
+
+// Default constructor
+NotificationScheduler::NotificationScheduler() {
+    for(int i=0;i<NOTIFY_NUM_CLASSES;++i) {
+        this->m_waiting[i] = 0;
+        this->m_deferred[i] = 0;
+        this->m_count[i] = 0;
+        this->m_total_wait_ms[i] = 0;
+        this->m_max_wait_ms[i] = 0;
+        this->m_done[i] = 0;
+        this->m_total_latency_ms[i] = 0;
+        this->m_max_latency_ms[i] = 0;
+    }
+    this->m_holder_start_ms = 0;
+    this->m_busy = false;
+    this->m_clock.start();
+}
+
+// Destructor
+NotificationScheduler::~NotificationScheduler() {
+}
+
+// wait for our turn to observe()
+void NotificationScheduler::begin(NotificationClasses cls) {
+    int start_ms = this->m_clock.read_ms();
+    this->m_mutex.lock();
+    bool ahead = false;
+    for(int i=0;i<=(int)cls && ahead == false;++i) {
+        ahead = (this->m_waiting[i] > 0 || this->m_deferred[i] > 0);
+    }
+    if (this->m_busy == false && ahead == false) {
+        // gate is free
+        this->m_busy = true;
+        this->m_mutex.unlock();
+    }
+    else {
+        // queue up... end() hands us the gate
+        ++this->m_waiting[cls];
+        this->m_mutex.unlock();
+        this->m_turn[cls].wait();
+    }
+
+    // stats
+    this->m_mutex.lock();
+    this->record_wait(cls,start_ms);
+    this->m_mutex.unlock();
+}
+
+// non-blocking begin()... a failed attempt leaves a deferred claim that keeps the lower classes waiting
+bool NotificationScheduler::try_begin(NotificationClasses cls,notification_claim_t &claim) {
+    this->m_mutex.lock();
+    bool ahead = false;
+    for(int i=0;i<(int)cls && ahead == false;++i) {
+        // a deferred claim goes ahead of the blocking senders of its own class (hand_over() left the gate free for it)
+        ahead = (this->m_waiting[i] > 0 || this->m_deferred[i] > 0);
+    }
+    if (this->m_busy == true || ahead == true) {
+        if (claim.deferred == false) {
+            claim.deferred = true;
+            claim.start_ms = this->m_clock.read_ms();
+            ++this->m_deferred[cls];
+        }
+        this->m_mutex.unlock();
+        return false;
+    }
+
+    // gate is free
+    this->m_busy = true;
+    int start_ms = this->m_clock.read_ms();
+    if (claim.deferred == true) {
+        claim.deferred = false;
+        --this->m_deferred[cls];
+        start_ms = claim.start_ms;
+    }
+    this->record_wait(cls,start_ms);
+    this->m_mutex.unlock();
+    return true;
+}
+
+// give up a deferred claim
+void NotificationScheduler::cancel(NotificationClasses cls,notification_claim_t &claim) {
+    this->m_mutex.lock();
+    if (claim.deferred == true) {
+        claim.deferred = false;
+        --this->m_deferred[cls];
+        if (this->m_busy == false) {
+            // the gate may have been left free for us... pass it on
+            this->hand_over();
+        }
+    }
+    this->m_mutex.unlock();
+}
+
+// our notification is done
+void NotificationScheduler::end(NotificationClasses cls) {
+    this->m_mutex.lock();
+
+    // stats: delivery latency
+    int latency_ms = this->m_clock.read_ms() - this->m_holder_start_ms;
+    ++this->m_done[cls];
+    this->m_total_latency_ms[cls] += latency_ms;
+    if (latency_ms > this->m_max_latency_ms[cls]) {
+        this->m_max_latency_ms[cls] = latency_ms;
+    }
+    this->hand_over();
+    this->m_mutex.unlock();
+}
+
+// hand the gate to the highest class waiting (a deferred claim ahead of them takes it on its retry... the gate stays free for it)
+void NotificationScheduler::hand_over() {
+    for(int i=0;i<NOTIFY_NUM_CLASSES;++i) {
+        if (this->m_deferred[i] > 0) {
+            break;
+        }
+        if (this->m_waiting[i] > 0) {
+            --this->m_waiting[i];
+            this->m_busy = true;
+            this->m_turn[i].release();
+            return;
+        }
+    }
+    this->m_busy = false;
+}
+
+// stats: a class got the gate after waiting (mutex held)
+void NotificationScheduler::record_wait(NotificationClasses cls,int start_ms) {
+    int wait_ms = this->m_clock.read_ms() - start_ms;
+    this->m_holder_start_ms = start_ms;
+    ++this->m_count[cls];
+    this->m_total_wait_ms[cls] += wait_ms;
+    if (wait_ms > this->m_max_wait_ms[cls]) {
+        this->m_max_wait_ms[cls] = wait_ms;
+    }
+}
+
+// stats: notifications sent in a class
+int NotificationScheduler::count(NotificationClasses cls) {
+    return this->m_count[cls];
+}
+
+// stats: average time a class waited for the gate
+int NotificationScheduler::average_wait_ms(NotificationClasses cls) {
+    return (this->m_count[cls] > 0) ? this->m_total_wait_ms[cls] / this->m_count[cls] : 0;
+}
+
+// stats: longest time a class waited for the gate
+int NotificationScheduler::max_wait_ms(NotificationClasses cls) {
+    return this->m_max_wait_ms[cls];
+}
+
+// stats: average time from begin() to end() in a class
+int NotificationScheduler::average_latency_ms(NotificationClasses cls) {
+    return (this->m_done[cls] > 0) ? this->m_total_latency_ms[cls] / this->m_done[cls] : 0;
+}
+
+// stats: longest time from begin() to end() in a class
+int NotificationScheduler::max_latency_ms(NotificationClasses cls) {
+    return this->m_max_latency_ms[cls];
+}
@@ -0,0 +1,112 @@
+/**
+ * @file    NotificationScheduler.h
+ * @brief   mbed Endpoint priority notification scheduler (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NOTIFICATION_SCHEDULER_H__
+#define __NOTIFICATION_SCHEDULER_H__
+
+// mbed API
+#include "mbed.h"
+
+// notification priority classes (highest first)
+enum NotificationClasses {
+    NOTIFY_STATE=0,             // stall state changes
+    NOTIFY_EXPIRY=1,            // parking expired
+    NOTIFY_BULK=2,              // image chunks (and the other camera observations)
+    NOTIFY_NUM_CLASSES=3        // number of classes
+};
+
+// TUNE: how soon a sender on the shared event queue retries a busy gate (ms)
+#define NOTIFY_RETRY_MS             10
+
+// a non-blocking claim on the gate (shared event queue senders: try_begin() until it succeeds, or cancel() it)
+typedef struct {
+    bool    deferred;               // queued behind the gate holder... counts as waiting for the classes below
+    int     start_ms;               // first attempt (queueing latency)
+} notification_claim_t;
+
+/**
+ * One gate every observe() goes through: begin() waits until no higher (or earlier same) class notification is
+ * waiting or being sent, end() hands the gate to the highest class waiting. Image streams take the gate once per
+ * chunk... so a state change waits for at most the chunk being observed, never for the rest of the image.
+ * Senders with a delivery callback keep the gate until it fires (or their acknowledgement timeout does), not just
+ * across the observe() that queues the notification in mbed-client.
+ * Per class queueing latency (begin() to gate) and delivery latency (begin() to end()) are kept to show it.
+ * The shared event queue must not block: its senders try_begin() instead and retry (NOTIFY_RETRY_MS) while the gate
+ * is busy... their deferred claim still keeps lower classes out, so a state change does not lose its place to a chunk.
+ */
+class NotificationScheduler {
+    public:
+        // Default constructor
+        NotificationScheduler();
+
+        // Destructor
+        virtual ~NotificationScheduler();
+
+        // wait for our turn to observe()
+        void begin(NotificationClasses cls);
+
+        // non-blocking begin(): true if we hold the gate... false: retry later with the same claim (or cancel() it)
+        bool try_begin(NotificationClasses cls,notification_claim_t &claim);
+
+        // give up a deferred claim
+        void cancel(NotificationClasses cls,notification_claim_t &claim);
+
+        // our notification is done (delivered, given up on... or queued, for senders without a delivery callback)
+        void end(NotificationClasses cls);
+
+        // stats: notifications sent in a class
+        int count(NotificationClasses cls);
+
+        // stats: average and longest time (ms) a class waited for the gate
+        int average_wait_ms(NotificationClasses cls);
+        int max_wait_ms(NotificationClasses cls);
+
+        // stats: average and longest time (ms) from begin() to end() in a class (queueing plus delivery)
+        int average_latency_ms(NotificationClasses cls);
+        int max_latency_ms(NotificationClasses cls);
+
+    private:
+        // hand the gate to the highest class waiting... or leave it free (mutex held)
+        void hand_over();
+
+        // stats: a class got the gate after waiting since "start_ms" (mutex held)
+        void record_wait(NotificationClasses cls,int start_ms);
+
+        Mutex       m_mutex;
+        Semaphore   m_turn[NOTIFY_NUM_CLASSES];
+        int         m_waiting[NOTIFY_NUM_CLASSES];
+        int         m_deferred[NOTIFY_NUM_CLASSES];
+        bool        m_busy;
+        Timer       m_clock;
+        int         m_count[NOTIFY_NUM_CLASSES];
+        int         m_total_wait_ms[NOTIFY_NUM_CLASSES];
+        int         m_max_wait_ms[NOTIFY_NUM_CLASSES];
+        int         m_holder_start_ms;
+        int         m_done[NOTIFY_NUM_CLASSES];
+        int         m_total_latency_ms[NOTIFY_NUM_CLASSES];
+        int         m_max_latency_ms[NOTIFY_NUM_CLASSES];
+};
+
+// the notification scheduler shared by all resources
+NotificationScheduler *notification_scheduler();
+
+#endif // __NOTIFICATION_SCHEDULER_H__
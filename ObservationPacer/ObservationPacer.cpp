@@ -0,0 +1,199 @@
+/**
+ * @file    ObservationPacer.cpp
+ * @brief   mbed Endpoint credit based observation pacer
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Class
+#include "ObservationPacer.h"
+
+// Default constructor
+ObservationPacer::ObservationPacer(int window) : m_credits(window) {
+    this->m_window = window;
+    this->m_outstanding = 0;
+    this->m_srtt_ms = 0;
+    this->m_rto_ms = PACER_INITIAL_RTO_MS;
+    this->m_backoff_ms = 0;
+    this->m_retransmissions = 0;
+    this->m_num_sent = 0;
+    this->m_bytes_sent = 0;
+    this->m_elapsed_ms = 0;
+    this->m_acks_seen = false;
+}
+
+// Destructor
+ObservationPacer::~ObservationPacer() {
+}
+
+// begin a transfer
+void ObservationPacer::begin() {
+    this->m_mutex.lock();
+    this->m_retransmissions = 0;
+    this->m_num_sent = 0;
+    this->m_bytes_sent = 0;
+    this->m_elapsed_ms = 0;
+    this->m_mutex.unlock();
+    this->m_transfer_timer.reset();
+    this->m_transfer_timer.start();
+}
+
+// wait for a credit to send the next observation
+bool ObservationPacer::acquire() {
+    bool acked = true;
+    bool suspected = false;
+    int waited_ms = 0;
+
+    // wait for an acknowledgement to hand us a credit
+    while (this->m_credits.wait(this->m_rto_ms) <= 0) {
+        waited_ms += this->m_rto_ms;
+        this->m_mutex.lock();
+        if (this->m_acks_seen == false || this->m_outstanding == 0 || waited_ms >= PACER_GIVE_UP_MS) {
+            // no delivery callbacks to go by (the RTO paces us)... or CoAP has given up on it by now
+            if (this->m_outstanding > 0) {
+                // the oldest observation is now considered lost... a late delivery will not add a credit
+                --this->m_outstanding;
+            }
+            this->m_mutex.unlock();
+            acked = false;
+            break;
+        }
+
+        // we know delivery callbacks work... so a timeout means CoAP is retransmitting it. it keeps its credit
+        // (sending more would overflow the mbed-client resend queue)... back off.
+        if (suspected == false) {
+            ++this->m_retransmissions;
+            this->m_backoff_ms += PACER_BACKOFF_STEP_MS;
+            suspected = true;
+        }
+        this->m_rto_ms *= 2;
+        if (this->m_rto_ms > PACER_MAX_RTO_MS) {
+            this->m_rto_ms = PACER_MAX_RTO_MS;
+        }
+        this->m_mutex.unlock();
+    }
+
+    // add any backoff gap we are still carrying
+    if (this->m_backoff_ms > 0) {
+        Thread::wait(this->m_backoff_ms);
+    }
+    return acked;
+}
+
+// an observation has just been sent
+void ObservationPacer::sent(int bytes) {
+    this->m_mutex.lock();
+    ++this->m_outstanding;
+    ++this->m_num_sent;
+    this->m_bytes_sent += bytes;
+    this->m_mutex.unlock();
+    this->m_rtt_timer.reset();
+    this->m_rtt_timer.start();
+}
+
+// an observation has been acknowledged
+void ObservationPacer::delivered() {
+    bool release = false;
+    this->m_mutex.lock();
+    this->m_acks_seen = true;
+    if (this->m_outstanding > 0) {
+        --this->m_outstanding;
+        release = true;
+
+        // update our smoothed RTT and RTO (RFC 6298 style... integer ms)
+        int rtt_ms = this->m_rtt_timer.read_ms();
+        if (this->m_srtt_ms == 0) {
+            this->m_srtt_ms = rtt_ms;
+        }
+        else {
+            this->m_srtt_ms = ((7 * this->m_srtt_ms) + rtt_ms) / 8;
+        }
+        this->m_rto_ms = 2 * this->m_srtt_ms;
+        if (this->m_rto_ms < PACER_MIN_RTO_MS) {
+            this->m_rto_ms = PACER_MIN_RTO_MS;
+        }
+        if (this->m_rto_ms > PACER_MAX_RTO_MS) {
+            this->m_rto_ms = PACER_MAX_RTO_MS;
+        }
+
+        // decay any backoff
+        this->m_backoff_ms /= 2;
+    }
+    this->m_mutex.unlock();
+
+    // hand back the credit
+    if (release) {
+        this->m_credits.release();
+    }
+}
+
+// end a transfer
+void ObservationPacer::end() {
+    // collect the whole window back (up to the RTO per credit) so the last observations are acknowledged... a late acknowledgement would hand the next transfer an extra credit
+    int held = 0;
+    while (held < this->m_window && this->m_outstanding > 0 && this->m_acks_seen) {
+        if (this->m_credits.wait(this->m_rto_ms) <= 0) {
+            break;
+        }
+        ++held;
+    }
+    for(int i=0;i<held;++i) {
+        this->m_credits.release();
+    }
+    this->m_transfer_timer.stop();
+    this->m_mutex.lock();
+    this->m_elapsed_ms = this->m_transfer_timer.read_ms();
+
+    // drain any stale credits/outstanding state so the next transfer starts with a full window
+    while (this->m_outstanding > 0) {
+        --this->m_outstanding;
+        this->m_credits.release();
+    }
+    this->m_mutex.unlock();
+}
+
+// stats: average time between observations (ms)
+int ObservationPacer::pacing_ms() {
+    if (this->m_num_sent > 0) {
+        return this->m_elapsed_ms / this->m_num_sent;
+    }
+    return 0;
+}
+
+// stats: achieved throughput (bytes/sec)
+int ObservationPacer::bytes_per_sec() {
+    if (this->m_elapsed_ms > 0) {
+        return (int)((this->m_bytes_sent * 1000LL) / this->m_elapsed_ms);
+    }
+    return 0;
+}
+
+// stats: current retransmission timeout (ms)
+int ObservationPacer::rto_ms() {
+    return this->m_rto_ms;
+}
+
+// stats: suspected retransmissions in the last transfer
+int ObservationPacer::retransmissions() {
+    return this->m_retransmissions;
+}
+
+// stats: have we ever seen a delivery callback?
+bool ObservationPacer::acks_seen() {
+    return this->m_acks_seen;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file    ObservationPacer.h
+ * @brief   mbed Endpoint credit based observation pacer (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __OBSERVATION_PACER_H__
+#define __OBSERVATION_PACER_H__
+
+// mbed API
+#include "mbed.h"
+
+// TUNE: number of un-acknowledged observations we allow in flight (mbed-client holds SN_COAP_DUPLICATION_MAX_MSGS_COUNT)
+#define PACER_DEFAULT_WINDOW			1
+
+// TUNE: retransmission timeout bounds (ms)
+#define PACER_INITIAL_RTO_MS			750		// legacy fixed pacing... used until we have RTT samples
+#define PACER_MIN_RTO_MS				100
+#define PACER_MAX_RTO_MS				8000
+
+// TUNE: extra gap added per suspected retransmission (ms)... decays by half with each acknowledgement
+#define PACER_BACKOFF_STEP_MS			250
+
+// TUNE: how long an unacknowledged observation keeps its credit once delivery callbacks are known to work (ms)... CoAP
+// retransmits it until then (RFC 7252: ACK_TIMEOUT 2 s doubling over MAX_RETRANSMIT 4... 2+4+8+16+32 s)
+#define PACER_GIVE_UP_MS				62000
+
+class ObservationPacer {
+    public:
+        // Default constructor
+        ObservationPacer(int window = PACER_DEFAULT_WINDOW);
+
+        // Destructor
+        virtual ~ObservationPacer();
+
+        // begin a transfer
+        void begin();
+
+        // wait for a credit to send the next observation (returns false if we gave up waiting for an acknowledgement)
+        bool acquire();
+
+        // an observation of "bytes" length has just been sent
+        void sent(int bytes);
+
+        // an observation has been acknowledged (notification delivery callback)
+        void delivered();
+
+        // end a transfer
+        void end();
+
+        // stats: average time between observations (ms) for the last transfer
+        int pacing_ms();
+
+        // stats: achieved throughput (bytes/sec) for the last transfer
+        int bytes_per_sec();
+
+        // stats: current retransmission timeout (ms)
+        int rto_ms();
+
+        // stats: suspected retransmissions in the last transfer
+        int retransmissions();
+
+        // stats: have we ever seen a delivery callback?
+        bool acks_seen();
+
+    private:
+        int         m_window;
+        int         m_outstanding;
+        Semaphore   m_credits;
+        Mutex       m_mutex;
+        Timer       m_rtt_timer;
+        Timer       m_transfer_timer;
+        int         m_srtt_ms;
+        int         m_rto_ms;
+        int         m_backoff_ms;
+        int         m_retransmissions;
+        int         m_num_sent;
+        int         m_bytes_sent;
+        int         m_elapsed_ms;
+        bool        m_acks_seen;
+};
+
+#endif // __OBSERVATION_PACER_H__
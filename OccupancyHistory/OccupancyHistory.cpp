@@ -0,0 +1,122 @@
+/**
+ * @file    OccupancyHistory.cpp
+ * @brief   mbed Endpoint occupancy transition history
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Class
+#include "OccupancyHistory.h"
+
+// Default constructor
+OccupancyHistory::OccupancyHistory() {
+    this->m_first = 0;
+    this->m_count = 0;
+    this->m_last_seq = 0;
+    this->m_acked_seq = 0;
+    this->m_overwritten = 0;
+    memset(this->m_records,0,sizeof(this->m_records));
+}
+
+// Destructor
+OccupancyHistory::~OccupancyHistory() {
+}
+
+// add a transition
+uint32_t OccupancyHistory::record(time_t timestamp,int stall,int from_state,int to_state,float range) {
+    this->m_mutex.lock();
+    if (this->m_count == OCCUPANCY_HISTORY_DEPTH) {
+        // full: lose the oldest
+        this->m_first = (this->m_first + 1) % OCCUPANCY_HISTORY_DEPTH;
+        --this->m_count;
+        ++this->m_overwritten;
+    }
+    occupancy_record_t *record = &this->m_records[(this->m_first + this->m_count) % OCCUPANCY_HISTORY_DEPTH];
+    record->seq = ++this->m_last_seq;
+    record->timestamp = timestamp;
+    record->stall = (uint8_t)stall;
+    record->from_state = (uint8_t)from_state;
+    record->to_state = (uint8_t)to_state;
+    record->range = range;
+    ++this->m_count;
+    uint32_t seq = record->seq;
+    this->m_mutex.unlock();
+    return seq;
+}
+
+// drop the transitions up to (and including) seq
+int OccupancyHistory::ack(uint32_t seq) {
+    int dropped = 0;
+    this->m_mutex.lock();
+    while (this->m_count > 0 && this->m_records[this->m_first].seq <= seq) {
+        this->m_first = (this->m_first + 1) % OCCUPANCY_HISTORY_DEPTH;
+        --this->m_count;
+        ++dropped;
+    }
+    if (seq > this->m_acked_seq && seq <= this->m_last_seq) {
+        this->m_acked_seq = seq;
+    }
+    this->m_mutex.unlock();
+    return dropped;
+}
+
+// the oldest unacknowledged transitions as a SenML pack: times relative to the first (bt)... v is the new state
+string OccupancyHistory::pack(const char *base_name,int max_records) {
+    char buf[OCCUPANCY_HISTORY_RECORD_LEN+1];
+    string pack = "[";
+    this->m_mutex.lock();
+    int count = (this->m_count < max_records) ? this->m_count : max_records;
+    for(int i=0;i<count;++i) {
+        const occupancy_record_t *record = &this->m_records[(this->m_first + i) % OCCUPANCY_HISTORY_DEPTH];
+        memset(buf,0,OCCUPANCY_HISTORY_RECORD_LEN+1);
+        if (i == 0) {
+            snprintf(buf,OCCUPANCY_HISTORY_RECORD_LEN,"{\"bn\":\"%s\",\"bt\":%ld,",base_name,(long)record->timestamp);
+            pack += buf;
+        }
+        else {
+            pack += ",{";
+        }
+        snprintf(buf,OCCUPANCY_HISTORY_RECORD_LEN,"\"n\":\"%d/state\",\"t\":%ld,\"v\":%d,\"from\":%d,\"range\":%.2f,\"seq\":%lu}",
+                 (int)record->stall,(long)(record->timestamp - this->m_records[this->m_first].timestamp),(int)record->to_state,(int)record->from_state,
+                 record->range,(unsigned long)record->seq);
+        pack += buf;
+    }
+    this->m_mutex.unlock();
+    pack += "]";
+    return pack;
+}
+
+// unacknowledged transitions
+int OccupancyHistory::pending() {
+    return this->m_count;
+}
+
+// last sequence number recorded
+uint32_t OccupancyHistory::last_seq() {
+    return this->m_last_seq;
+}
+
+// last sequence number acknowledged
+uint32_t OccupancyHistory::acked_seq() {
+    return this->m_acked_seq;
+}
+
+// stats: transitions overwritten before they were acknowledged
+int OccupancyHistory::overwritten() {
+    return this->m_overwritten;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file    OccupancyHistory.h
+ * @brief   mbed Endpoint occupancy transition history (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __OCCUPANCY_HISTORY_H__
+#define __OCCUPANCY_HISTORY_H__
+
+// mbed API
+#include "mbed.h"
+
+// TUNE: transitions kept on the device until acknowledged (a ~2 day outage at a busy stall)
+#define OCCUPANCY_HISTORY_DEPTH				64
+
+// TUNE: most transitions in one pack (bounds the notification size)
+#define OCCUPANCY_HISTORY_PACK_MAX			16
+
+// SenML record length (one transition)
+#define OCCUPANCY_HISTORY_RECORD_LEN		96
+
+// a stall transition
+typedef struct {
+    uint32_t    seq;            // sequence number (1.. gap-free)
+    time_t      timestamp;      // transition time (epoch seconds)
+    uint8_t     stall;
+    uint8_t     from_state;
+    uint8_t     to_state;
+    float       range;          // filtered range at the transition (m)
+} occupancy_record_t;
+
+/**
+ * Every stall transition in order, kept until the cloud acknowledges its sequence number. pack() renders the
+ * oldest unacknowledged transitions (of every stall) as a SenML pack (base name/time, one record per transition named
+ * "<stall>/state")... the same
+ * transitions are packed again until ack() drops them. When full, the oldest unacknowledged transition is
+ * overwritten (counted)... the cloud sees the seq gap.
+ */
+class OccupancyHistory {
+    public:
+        // Default constructor
+        OccupancyHistory();
+
+        // Destructor
+        virtual ~OccupancyHistory();
+
+        // any thread: add a transition... returns its sequence number
+        uint32_t record(time_t timestamp,int stall,int from_state,int to_state,float range);
+
+        // any thread: drop the transitions up to (and including) seq... returns the number dropped
+        int ack(uint32_t seq);
+
+        // any thread: the oldest unacknowledged transitions (at most max_records) as a SenML pack ("[]" if none)
+        string pack(const char *base_name,int max_records = OCCUPANCY_HISTORY_PACK_MAX);
+
+        // unacknowledged transitions
+        int pending();
+
+        // last sequence number recorded and acknowledged
+        uint32_t last_seq();
+        uint32_t acked_seq();
+
+        // stats: transitions overwritten before they were acknowledged
+        int overwritten();
+
+    private:
+        Mutex               m_mutex;
+        occupancy_record_t  m_records[OCCUPANCY_HISTORY_DEPTH];
+        int                 m_first;
+        int                 m_count;
+        uint32_t            m_last_seq;
+        uint32_t            m_acked_seq;
+        int                 m_overwritten;
+};
+
+#endif // __OCCUPANCY_HISTORY_H__
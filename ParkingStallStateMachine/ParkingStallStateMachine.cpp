@@ -0,0 +1,68 @@
+/**
+ * @file    ParkingStallStateMachine.cpp
+ * @brief   mbed Endpoint parking stall occupancy state machine
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// State machine
+#include "ParkingStallStateMachine.h"
+
+// transition table: [current state][range class]
+const stall_transition_t __stall_transitions[STALL_NUM_STATES][RANGE_NUM_CLASSES] = {
+	// RANGE_NO_READING            RANGE_BEYOND_MAX  RANGE_PARKED       RANGE_MOVING_IN     RANGE_MOVING_OUT     RANGE_STATIONARY
+	{ STALL_HOLD(STALL_EMPTY),     STALL_TO_EMPTY,   STALL_TO_OCCUPIED, STALL_TO_ARRIVING,  STALL_TO_DEPARTING,  STALL_STATIONARY(STALL_EMPTY) },		// STALL_EMPTY
+	{ STALL_HOLD(STALL_OCCUPIED),  STALL_TO_EMPTY,   STALL_TO_OCCUPIED, STALL_TO_ARRIVING,  STALL_TO_DEPARTING,  STALL_STATIONARY(STALL_OCCUPIED) },	// STALL_OCCUPIED
+	{ STALL_HOLD(STALL_ARRIVING),  STALL_TO_EMPTY,   STALL_TO_OCCUPIED, STALL_TO_ARRIVING,  STALL_TO_DEPARTING,  STALL_STATIONARY(STALL_ARRIVING) },	// STALL_ARRIVING
+	{ STALL_HOLD(STALL_DEPARTING), STALL_TO_EMPTY,   STALL_TO_OCCUPIED, STALL_TO_ARRIVING,  STALL_TO_DEPARTING,  STALL_STATIONARY(STALL_DEPARTING) }	// STALL_DEPARTING
+};
+
+// direction a stall is moving in
+MovementDirection parking_stall_movement(float rate_m_s,float min_rate) {
+	if (rate_m_s >= min_rate) {
+		return OUT_OF_STALL;
+	}
+	if (rate_m_s <= -(min_rate)) {
+		return INTO_STALL;
+	}
+	return NO_MOVEMENT;
+}
+
+// discretize the range and movement of a stall
+RangeClasses parking_stall_range_class(float range,MovementDirection movement,float occupied_range,float occupied_variance,float max_range) {
+	if (range >= DEFAULT_OUT_OF_RANGE) {
+		// suddenly out of range... just freeze at the current last known state
+		return RANGE_NO_READING;
+	}
+	if (range > max_range) {
+		// just moved out of our range of interest... so we are EMPTY now
+		return RANGE_BEYOND_MAX;
+	}
+
+	// within our parking range (make sure we dont bump the meter! no lower bound of occupied_range - occupied_variance)
+	if (range >= 0.0 && range <= occupied_range + occupied_variance) {
+		return RANGE_PARKED;
+	}
+	if (movement == INTO_STALL) {
+		return RANGE_MOVING_IN;
+	}
+	if (movement == OUT_OF_STALL) {
+		return RANGE_MOVING_OUT;
+	}
+	return RANGE_STATIONARY;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file    ParkingStallStateMachine.h
+ * @brief   mbed Endpoint parking stall occupancy state machine (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PARKING_STALL_STATE_MACHINE_H__
+#define __PARKING_STALL_STATE_MACHINE_H__
+
+// mbed API
+#include "mbed.h"
+
+// default OUT OF RANGE value
+#define DEFAULT_OUT_OF_RANGE	    	100.0	// defaulted out of range range value...
+
+// parking stall states
+enum ParkingStallStates {
+	STALL_EMPTY=0,			// stall is EMPTY
+	STALL_OCCUPIED=1,		// stall is OCCUPIED
+	STALL_ARRIVING=2,		// stall has car arriving into it
+	STALL_DEPARTING=3,		// stall has car departing from it
+	STALL_NUM_STATES=4		// number of states
+};
+
+// parking stall movement direction
+enum MovementDirection {
+	INTO_STALL=0,			// movement into the stall
+	NO_MOVEMENT=1,			// no movement
+	OUT_OF_STALL=2			// movement out of the stall
+};
+
+// range input to the state machine (the filtered range and movement, discretized)
+enum RangeClasses {
+	RANGE_NO_READING=0,		// out of range or no echo... hold the current state
+	RANGE_BEYOND_MAX=1,		// beyond max_range... stall is EMPTY
+	RANGE_PARKED=2,			// within the occupied range... stall is OCCUPIED
+	RANGE_MOVING_IN=3,		// in between and moving into the stall
+	RANGE_MOVING_OUT=4,		// in between and moving out of the stall
+	RANGE_STATIONARY=5,		// in between and not moving
+	RANGE_NUM_CLASSES=6		// number of range classes
+};
+
+// transition actions (bit mask... applied in this order)
+#define ACTION_NONE					0x0000
+#define ACTION_RANGE_EMPTY			0x0001	// range reset to OUT_OF_RANGE, no movement
+#define ACTION_RANGE_PARKED			0x0002	// range pinned to the occupied range, no movement
+#define ACTION_OBSERVE				0x0004	// new status string and observation (sent once per state change)
+#define ACTION_CAMERA_CAPTURE		0x0008	// local capture when the state changes (DO_LOCAL_CAPTURE)
+#define ACTION_BEACON_ON			0x0010
+#define ACTION_BEACON_OFF			0x0020
+#define ACTION_CAMERA_WARM_UP		0x0040
+#define ACTION_CAMERA_POWER_DOWN	0x0080
+#define ACTION_LEDS					0x0100	// LEDs of the new state
+#define ACTION_RATE_LOW				0x0200	// scene settled... sampling backs off
+#define ACTION_RATE_HIGH			0x0400	// car moving... fast sampling
+#define ACTION_PUBLISH_STATE		0x0800	// parking_stall_state() reports the new state
+
+// a transition: next state, its actions and what to log
+typedef struct {
+	ParkingStallStates	next;
+	uint16_t			actions;
+	const char		   *log;
+} stall_transition_t;
+
+// the transitions common to every state
+#define STALL_HOLD(state)		{ state, ACTION_NONE, NULL }
+#define STALL_TO_EMPTY			{ STALL_EMPTY, ACTION_RANGE_EMPTY|ACTION_OBSERVE|ACTION_BEACON_OFF|ACTION_CAMERA_POWER_DOWN|ACTION_LEDS|ACTION_RATE_LOW|ACTION_PUBLISH_STATE, "Parking stall has just turned EMPTY" }
+#define STALL_TO_OCCUPIED		{ STALL_OCCUPIED, ACTION_RANGE_PARKED|ACTION_OBSERVE|ACTION_CAMERA_CAPTURE|ACTION_BEACON_ON|ACTION_LEDS|ACTION_RATE_LOW|ACTION_PUBLISH_STATE, "stall is now OCCUPIED..." }
+#define STALL_TO_ARRIVING		{ STALL_ARRIVING, ACTION_RATE_HIGH|ACTION_LEDS|ACTION_CAMERA_WARM_UP|ACTION_PUBLISH_STATE, "stall has ARRIVING car..." }
+#define STALL_TO_DEPARTING		{ STALL_DEPARTING, ACTION_RATE_HIGH|ACTION_LEDS|ACTION_PUBLISH_STATE, "stall has DEPARTING car..." }
+#define STALL_STATIONARY(state)	{ state, ACTION_RATE_HIGH, "car is stationary..." }
+
+// transition table: [current state][range class]... every (state, input) pair has an entry
+extern const stall_transition_t __stall_transitions[STALL_NUM_STATES][RANGE_NUM_CLASSES];
+
+// direction a stall is moving in from its range rate (m/s... positive: away from the meter)
+MovementDirection parking_stall_movement(float rate_m_s,float min_rate);
+
+// discretize the (filtered) range and movement of a stall for the transition table
+RangeClasses parking_stall_range_class(float range,MovementDirection movement,float occupied_range,float occupied_variance,float max_range);
+
+#endif // __PARKING_STALL_STATE_MACHINE_H__
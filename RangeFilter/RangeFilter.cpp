@@ -0,0 +1,184 @@
+/**
+ * @file    RangeFilter.cpp
+ * @brief   mbed Endpoint range sample filter
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Class
+#include "RangeFilter.h"
+
+// Default constructor
+RangeFilter::RangeFilter() {
+    this->m_rejected = 0;
+    this->configure(RANGE_FILTER_DEFAULT_MEDIAN,RANGE_FILTER_DEFAULT_EMA_ALPHA,RANGE_FILTER_DEFAULT_MAX_VELOCITY);
+}
+
+// Destructor
+RangeFilter::~RangeFilter() {
+}
+
+// configure the stages
+void RangeFilter::configure(int median_n,float ema_alpha,float max_velocity) {
+    // median window: odd and bounded
+    if (median_n < 1) {
+        median_n = 1;
+    }
+    if (median_n > RANGE_FILTER_MAX_MEDIAN) {
+        median_n = RANGE_FILTER_MAX_MEDIAN;
+    }
+    if ((median_n % 2) == 0) {
+        ++median_n;
+    }
+    this->m_median_n = median_n;
+
+    // EMA weight of the new sample
+    if (ema_alpha <= 0.0 || ema_alpha > 1.0) {
+        ema_alpha = 1.0;
+    }
+    this->m_ema_alpha = ema_alpha;
+
+    // outlier gate
+    this->m_max_velocity = (max_velocity > 0.0) ? max_velocity : 0.0;
+    this->reset();
+}
+
+// forget all history
+void RangeFilter::reset() {
+    this->m_next = 0;
+    this->m_count = 0;
+    memset(this->m_window,0,sizeof(this->m_window));
+    memset(this->m_sorted,0,sizeof(this->m_sorted));
+    this->m_ema = 0.0;
+    this->m_ema_valid = false;
+    this->m_last_valid = false;
+    this->m_suspect_valid = false;
+}
+
+// filter a sample
+bool RangeFilter::filter(float range_m,uint32_t timestamp_us,float &filtered) {
+    // no echo: nothing to filter... the state machine holds its state
+    if (range_m < 0.0) {
+        filtered = range_m;
+        return true;
+    }
+
+    // 1. velocity gated outlier reject
+    if (this->m_max_velocity > 0.0 && this->m_last_valid) {
+        if (this->velocity(this->m_last_m,this->m_last_us,range_m,timestamp_us) > this->m_max_velocity) {
+            if (this->m_suspect_valid && this->velocity(this->m_suspect_m,this->m_suspect_us,range_m,timestamp_us) <= this->m_max_velocity) {
+                // two samples agree: a real step (car arrived or left)... start over from here
+                this->reset();
+            }
+            else {
+                // hold back until the next sample confirms it
+                this->m_suspect_m = range_m;
+                this->m_suspect_us = timestamp_us;
+                this->m_suspect_valid = true;
+                ++this->m_rejected;
+                return false;
+            }
+        }
+    }
+    this->m_suspect_valid = false;
+    this->m_last_m = range_m;
+    this->m_last_us = timestamp_us;
+    this->m_last_valid = true;
+
+    // 2. median
+    float value = this->median(range_m);
+
+    // 3. EMA
+    if (this->m_ema_valid == false || this->m_ema_alpha >= 1.0) {
+        this->m_ema = value;
+        this->m_ema_valid = true;
+    }
+    else {
+        this->m_ema += this->m_ema_alpha * (value - this->m_ema);
+    }
+    filtered = this->m_ema;
+    return true;
+}
+
+// configuration
+int RangeFilter::median_n() {
+    return this->m_median_n;
+}
+float RangeFilter::ema_alpha() {
+    return this->m_ema_alpha;
+}
+float RangeFilter::max_velocity() {
+    return this->m_max_velocity;
+}
+
+// stats: samples rejected as outliers
+int RangeFilter::rejected() {
+    return this->m_rejected;
+}
+
+// speed between two samples (m/s)
+float RangeFilter::velocity(float from_m,uint32_t from_us,float to_m,uint32_t to_us) {
+    uint32_t interval_us = to_us - from_us;
+    if (interval_us == 0) {
+        interval_us = 1;
+    }
+    return fabs(to_m - from_m) / (interval_us / 1000000.0);
+}
+
+// add a sample to the median window and return the median
+float RangeFilter::median(float range_m) {
+    if (this->m_median_n <= 1) {
+        return range_m;
+    }
+
+    // never trust the window beyond the configured size (configure() resets it... belt and braces)
+    if (this->m_count > this->m_median_n || this->m_next >= this->m_median_n) {
+        this->m_count = 0;
+        this->m_next = 0;
+    }
+
+    // window full: drop the oldest value from the sorted copy
+    int count = this->m_count;
+    if (count >= this->m_median_n) {
+        float oldest = this->m_window[this->m_next];
+        int i = 0;
+        while (i < count - 1 && this->m_sorted[i] != oldest) {
+            ++i;
+        }
+        for(;i<count-1;++i) {
+            this->m_sorted[i] = this->m_sorted[i+1];
+        }
+        --count;
+    }
+
+    // insert the new value in order
+    int j = count;
+    while (j > 0 && this->m_sorted[j-1] > range_m) {
+        this->m_sorted[j] = this->m_sorted[j-1];
+        --j;
+    }
+    this->m_sorted[j] = range_m;
+    this->m_count = count + 1;
+
+    // and in arrival order
+    this->m_window[this->m_next] = range_m;
+    this->m_next = (this->m_next + 1) % this->m_median_n;
+
+    // median of what we have (the window fills after a reset)
+    return this->m_sorted[this->m_count / 2];
+}
@@ -0,0 +1,101 @@
+/**
+ * @file    RangeFilter.h
+ * @brief   mbed Endpoint range sample filter (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __RANGE_FILTER_H__
+#define __RANGE_FILTER_H__
+
+// mbed API
+#include "mbed.h"
+
+// TUNE: largest median window (odd)
+#define RANGE_FILTER_MAX_MEDIAN			7
+
+// defaults: median of 3, no smoothing, reject jumps faster than 1 m/s
+#define RANGE_FILTER_DEFAULT_MEDIAN			3
+#define RANGE_FILTER_DEFAULT_EMA_ALPHA		1.0		// 1.0: EMA off
+#define RANGE_FILTER_DEFAULT_MAX_VELOCITY	1.0		// m/s... 0.0: outlier rejection off
+
+/**
+ * Filter stage between the range finder and the occupancy state machine. Each valid sample goes through:
+ *   1. velocity gated outlier reject: a sample implying a speed above max_velocity is held back... it is only
+ *      accepted (and the filter re-seeded) if the next sample agrees with it, so one spurious echo never gets through
+ *   2. median of the last N accepted samples (fixed ring, N <= RANGE_FILTER_MAX_MEDIAN)
+ *   3. exponential moving average (alpha 1.0 passes the median through)
+ * Every step is bounded by RANGE_FILTER_MAX_MEDIAN... constant work per sample. "No echo" (< 0) samples pass straight through.
+ */
+class RangeFilter {
+    public:
+        // Default constructor
+        RangeFilter();
+
+        // Destructor
+        virtual ~RangeFilter();
+
+        // configure the stages (median_n <= 1: median off, ema_alpha >= 1.0: EMA off, max_velocity <= 0.0: reject off)... resets the filter
+        void configure(int median_n,float ema_alpha,float max_velocity);
+
+        // forget all history
+        void reset();
+
+        // filter a sample taken at "timestamp_us"... false if it was rejected as an outlier ("filtered" is not set)
+        bool filter(float range_m,uint32_t timestamp_us,float &filtered);
+
+        // configuration
+        int median_n();
+        float ema_alpha();
+        float max_velocity();
+
+        // stats: samples rejected as outliers
+        int rejected();
+
+    private:
+        // speed between two samples (m/s)
+        float velocity(float from_m,uint32_t from_us,float to_m,uint32_t to_us);
+
+        // add a sample to the median window and return the median
+        float median(float range_m);
+
+        int         m_median_n;
+        float       m_ema_alpha;
+        float       m_max_velocity;
+
+        // median window: ring in arrival order plus the same values sorted
+        float       m_window[RANGE_FILTER_MAX_MEDIAN];
+        float       m_sorted[RANGE_FILTER_MAX_MEDIAN];
+        int         m_next;
+        int         m_count;
+
+        // EMA
+        float       m_ema;
+        bool        m_ema_valid;
+
+        // outlier gate: last accepted sample and a held back suspect
+        float       m_last_m;
+        uint32_t    m_last_us;
+        bool        m_last_valid;
+        float       m_suspect_m;
+        uint32_t    m_suspect_us;
+        bool        m_suspect_valid;
+        int         m_rejected;
+};
+
+#endif // __RANGE_FILTER_H__
@@ -0,0 +1,184 @@
+/**
+ * @file    RangeMultiplexer.cpp
+ * @brief   mbed Endpoint time slotted ultrasonic range finder multiplexer
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Class
+#include "RangeMultiplexer.h"
+
+// Default constructor
+RangeMultiplexer::RangeMultiplexer() {
+    this->m_num_sensors = 0;
+    this->m_slot_ms = 0;
+    this->m_next = 0;
+    this->m_last_ping_ms = 0;
+    this->m_wake_ms = 0;
+    this->m_running = false;
+    this->m_idle_slots = 0;
+    for(int i=0;i<RANGE_MUX_MAX_SENSORS;++i) {
+        this->m_finders[i] = NULL;
+        this->m_period_ms[i] = 0;
+        this->m_due_ms[i] = 0;
+        this->m_fired_ms[i] = 0;
+    }
+}
+
+// Destructor
+RangeMultiplexer::~RangeMultiplexer() {
+    this->stop();
+}
+
+// add a range finder
+int RangeMultiplexer::add(AsyncRangeFinder *finder,int period_ms) {
+    if (finder == NULL || this->m_num_sensors >= RANGE_MUX_MAX_SENSORS) {
+        return -1;
+    }
+    int sensor = this->m_num_sensors++;
+    this->m_finders[sensor] = finder;
+    this->m_period_ms[sensor] = period_ms;
+    this->m_due_ms[sensor] = 0;
+    return sensor;
+}
+
+// start slotting
+void RangeMultiplexer::start(int slot_ms) {
+    this->m_slot_ms = slot_ms;
+    if (this->m_num_sensors == 1) {
+        // nothing to share the air with
+        this->m_running = true;
+        this->m_finders[0]->set_period(this->m_period_ms[0]);
+        return;
+    }
+    this->m_clock.start();
+    core_util_critical_section_enter();
+    uint32_t now_ms = (uint32_t)this->m_clock.read_ms();
+    for(int i=0;i<this->m_num_sensors;++i) {
+        this->m_due_ms[i] = now_ms;
+        this->m_fired_ms[i] = now_ms;
+    }
+    this->m_last_ping_ms = now_ms - slot_ms;
+    this->m_running = true;
+    this->schedule(now_ms);
+    core_util_critical_section_exit();
+}
+
+// stop slotting
+void RangeMultiplexer::stop() {
+    this->m_running = false;
+    this->m_timeout.detach();
+    if (this->m_num_sensors == 1) {
+        this->m_finders[0]->set_period(0);
+    }
+}
+
+// change the period of a sensor
+void RangeMultiplexer::set_period(int sensor,int period_ms) {
+    if (sensor < 0 || sensor >= this->m_num_sensors) {
+        return;
+    }
+    if (this->m_num_sensors == 1) {
+        // its own Ticker (only re-armed when the period changes)
+        this->m_period_ms[sensor] = period_ms;
+        if (this->m_running == true) {
+            this->m_finders[sensor]->set_period(period_ms);
+        }
+        return;
+    }
+    core_util_critical_section_enter();
+    this->m_period_ms[sensor] = period_ms;
+    uint32_t due_ms = this->m_fired_ms[sensor] + period_ms;
+    if ((int32_t)(due_ms - this->m_due_ms[sensor]) < 0) {
+        // sooner than planned (a car started moving)... wake up earlier if need be
+        this->m_due_ms[sensor] = due_ms;
+        if (this->m_running == true && (int32_t)(due_ms - this->m_wake_ms) < 0) {
+            this->schedule((uint32_t)this->m_clock.read_ms());
+        }
+    }
+    core_util_critical_section_exit();
+}
+
+// number of sensors
+int RangeMultiplexer::sensors() {
+    return this->m_num_sensors;
+}
+
+// slot length
+int RangeMultiplexer::slot_ms() {
+    return this->m_slot_ms;
+}
+
+// stats: wake ups with nothing due
+int RangeMultiplexer::idle_slots() {
+    return this->m_idle_slots;
+}
+
+// ISR (Timeout): fire the most overdue sensor
+void RangeMultiplexer::slot() {
+    if (this->m_running == false) {
+        return;
+    }
+    uint32_t now_ms = (uint32_t)this->m_clock.read_ms();
+    int chosen = -1;
+    int32_t most_overdue = 0;
+    for(int i=0;i<this->m_num_sensors;++i) {
+        // round robin from the sensor after the last one fired... the first of equally overdue sensors wins
+        int sensor = (this->m_next + i) % this->m_num_sensors;
+        int32_t overdue = (int32_t)(now_ms - this->m_due_ms[sensor]);
+        if (overdue >= 0 && (chosen < 0 || overdue > most_overdue)) {
+            chosen = sensor;
+            most_overdue = overdue;
+        }
+    }
+    if (chosen < 0) {
+        ++this->m_idle_slots;
+    }
+    else {
+        if (this->m_finders[chosen]->fire() == true) {
+            this->m_fired_ms[chosen] = now_ms;
+            this->m_due_ms[chosen] = now_ms + this->m_period_ms[chosen];
+            this->m_next = (chosen + 1) % this->m_num_sensors;
+        }
+
+        // the slot is taken either way (an echo still outstanding is retried in the next one)
+        this->m_last_ping_ms = now_ms;
+    }
+    this->schedule(now_ms);
+}
+
+// arm the Timeout for the next sensor due... at least a slot after the last ping
+void RangeMultiplexer::schedule(uint32_t now_ms) {
+    uint32_t wake_ms = this->m_due_ms[0];
+    for(int i=1;i<this->m_num_sensors;++i) {
+        if ((int32_t)(this->m_due_ms[i] - wake_ms) < 0) {
+            wake_ms = this->m_due_ms[i];
+        }
+    }
+    uint32_t free_ms = this->m_last_ping_ms + this->m_slot_ms;
+    if ((int32_t)(free_ms - wake_ms) > 0) {
+        wake_ms = free_ms;
+    }
+    int32_t delay_ms = (int32_t)(wake_ms - now_ms);
+    if (delay_ms < 1) {
+        delay_ms = 1;
+        wake_ms = now_ms + 1;
+    }
+    this->m_wake_ms = wake_ms;
+    this->m_timeout.attach_us(callback(this,&RangeMultiplexer::slot),delay_ms * 1000);
+}
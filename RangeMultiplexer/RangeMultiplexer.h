@@ -0,0 +1,93 @@
+/**
+ * @file    RangeMultiplexer.h
+ * @brief   mbed Endpoint time slotted ultrasonic range finder multiplexer (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __RANGE_MULTIPLEXER_H__
+#define __RANGE_MULTIPLEXER_H__
+
+// mbed API
+#include "mbed.h"
+
+// interrupt driven range finder
+#include "AsyncRangeFinder.h"
+
+// most range finders multiplexed
+#define RANGE_MUX_MAX_SENSORS			4
+
+/**
+ * Several ultrasonic range finders sharing the air: one Timeout wakes up when the next sensor is due and fires the
+ * most overdue one (ties go round robin)... never sooner than one slot (longer than the echo timeout) after the last
+ * ping, so a ping never overlaps another sensor's echo. Each sensor asks for its own period (its SampleScheduler).
+ * With N sensors all fast, each effectively ranges every N slots... with nothing due the MCU is not woken up.
+ * A single sensor has nothing to share: it ranges on its own Ticker (exactly as without the multiplexer).
+ */
+class RangeMultiplexer {
+    public:
+        // Default constructor
+        RangeMultiplexer();
+
+        // Destructor
+        virtual ~RangeMultiplexer();
+
+        // add a range finder (before start())... returns its index (-1: full)
+        int add(AsyncRangeFinder *finder,int period_ms);
+
+        // start slotting... "slot_ms" must cover the echo timeout of every sensor
+        void start(int slot_ms);
+
+        // stop slotting
+        void stop();
+
+        // any thread: change the period of a sensor (a shorter period takes effect at once)
+        void set_period(int sensor,int period_ms);
+
+        // number of sensors
+        int sensors();
+
+        // slot length
+        int slot_ms();
+
+        // stats: wake ups with nothing due (a period was lengthened after the Timeout was armed)
+        int idle_slots();
+
+    private:
+        // ISR (Timeout): fire the most overdue sensor
+        void slot();
+
+        // arm the Timeout for the next sensor due (critical section held)
+        void schedule(uint32_t now_ms);
+
+        Timeout             m_timeout;
+        Timer               m_clock;
+        AsyncRangeFinder   *m_finders[RANGE_MUX_MAX_SENSORS];
+        volatile int        m_period_ms[RANGE_MUX_MAX_SENSORS];
+        volatile uint32_t   m_due_ms[RANGE_MUX_MAX_SENSORS];
+        volatile uint32_t   m_fired_ms[RANGE_MUX_MAX_SENSORS];
+        volatile uint32_t   m_last_ping_ms;    // times from m_clock (wrap... compare differences only)
+        volatile uint32_t   m_wake_ms;
+        volatile bool       m_running;
+        int                 m_num_sensors;
+        int                 m_slot_ms;
+        int                 m_next;
+        volatile int        m_idle_slots;
+};
+
+#endif // __RANGE_MULTIPLEXER_H__
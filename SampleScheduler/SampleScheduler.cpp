@@ -0,0 +1,107 @@
+/**
+ * @file    SampleScheduler.cpp
+ * @brief   mbed Endpoint adaptive range sampling scheduler
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Class
+#include "SampleScheduler.h"
+
+// Default constructor
+SampleScheduler::SampleScheduler() {
+    this->configure(SCHEDULER_DEFAULT_FAST_MS,SCHEDULER_DEFAULT_MAX_MS,SCHEDULER_DEFAULT_CHANGE_M,SCHEDULER_DEFAULT_REFERENCE_SPEED);
+    this->m_period_ms = this->m_fast_ms;
+    this->m_last_range_m = 0.0;
+    this->m_last_valid = false;
+    this->m_static_ms = 0;
+}
+
+// Destructor
+SampleScheduler::~SampleScheduler() {
+}
+
+// configure
+void SampleScheduler::configure(int fast_ms,int max_ms,float change_m,float reference_speed,int idle_ms,int idle_after_ms) {
+    if (fast_ms > SCHEDULER_MAX_PERIOD_MS) fast_ms = SCHEDULER_MAX_PERIOD_MS;
+    if (max_ms > SCHEDULER_MAX_PERIOD_MS) max_ms = SCHEDULER_MAX_PERIOD_MS;
+    this->m_fast_ms = (fast_ms < SCHEDULER_MIN_PERIOD_MS) ? SCHEDULER_MIN_PERIOD_MS : fast_ms;
+    this->m_max_ms = (max_ms < this->m_fast_ms) ? this->m_fast_ms : max_ms;
+    this->m_change_m = (change_m > 0.0) ? change_m : SCHEDULER_DEFAULT_CHANGE_M;
+    this->m_reference_speed = (reference_speed > 0.0) ? reference_speed : SCHEDULER_DEFAULT_REFERENCE_SPEED;
+    if (idle_ms > SCHEDULER_MAX_IDLE_PERIOD_MS) idle_ms = SCHEDULER_MAX_IDLE_PERIOD_MS;
+    this->m_idle_ms = (idle_ms < this->m_max_ms) ? this->m_max_ms : idle_ms;
+    this->m_idle_after_ms = (idle_after_ms > 0) ? idle_after_ms : 0;
+}
+
+// a sample has been processed... pick the next period
+int SampleScheduler::update(float range_m,float speed_m_s,bool active) {
+    // any range change is activity
+    if (this->m_last_valid && fabs(range_m - this->m_last_range_m) > this->m_change_m) {
+        active = true;
+    }
+    this->m_last_range_m = range_m;
+    this->m_last_valid = true;
+
+    if (active) {
+        // fast... faster still for a fast approach
+        int period_ms = this->m_fast_ms;
+        if (speed_m_s > this->m_reference_speed) {
+            period_ms = (int)(this->m_fast_ms * (this->m_reference_speed / speed_m_s));
+        }
+        this->m_period_ms = (period_ms < SCHEDULER_MIN_PERIOD_MS) ? SCHEDULER_MIN_PERIOD_MS : period_ms;
+        this->m_static_ms = 0;
+    }
+    else {
+        // static: back off... past max_ms once settled for long enough
+        this->m_static_ms += this->m_period_ms;
+        if (this->m_static_ms > this->m_idle_after_ms) {
+            this->m_static_ms = this->m_idle_after_ms;
+        }
+        int ceiling_ms = (this->m_static_ms >= this->m_idle_after_ms) ? this->m_idle_ms : this->m_max_ms;
+        this->m_period_ms *= 2;
+        if (this->m_period_ms > ceiling_ms) {
+            this->m_period_ms = ceiling_ms;
+        }
+    }
+    return this->m_period_ms;
+}
+
+// the current period (ms)
+int SampleScheduler::period_ms() {
+    return this->m_period_ms;
+}
+
+// configuration
+int SampleScheduler::fast_ms() {
+    return this->m_fast_ms;
+}
+int SampleScheduler::max_ms() {
+    return this->m_max_ms;
+}
+int SampleScheduler::idle_ms() {
+    return this->m_idle_ms;
+}
+int SampleScheduler::idle_after_ms() {
+    return this->m_idle_after_ms;
+}
+
+// how long the scene has been static (ms)
+int SampleScheduler::static_ms() {
+    return this->m_static_ms;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file    SampleScheduler.h
+ * @brief   mbed Endpoint adaptive range sampling scheduler (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SAMPLE_SCHEDULER_H__
+#define __SAMPLE_SCHEDULER_H__
+
+// mbed API
+#include "mbed.h"
+
+// shortest period we will ever ask for (must cover the echo timeout of the range finder)
+#define SCHEDULER_MIN_PERIOD_MS				50
+
+// longest period we will ever ask for (the fixed 1s ranging of old... an approach is seen within it, so EMPTY goes through ARRIVING)
+#define SCHEDULER_MAX_PERIOD_MS				1000
+
+// longest period we will ever ask for once a stall has been settled for a long time (worst case detection delay from long idle)
+#define SCHEDULER_MAX_IDLE_PERIOD_MS		10000
+
+// defaults
+#define SCHEDULER_DEFAULT_FAST_MS			150		// something is moving
+#define SCHEDULER_DEFAULT_MAX_MS			1000	// ceiling of the back off (worst case detection delay of a static scene... at most SCHEDULER_MAX_PERIOD_MS)
+#define SCHEDULER_DEFAULT_CHANGE_M			0.02	// a range change larger than this is "activity"
+#define SCHEDULER_DEFAULT_REFERENCE_SPEED	0.10	// m/s... faster approaches scale the fast period down
+#define SCHEDULER_DEFAULT_IDLE_MS			4000	// ceiling once settled for idle_after_ms (at most SCHEDULER_MAX_IDLE_PERIOD_MS... max_ms: never back off past it)
+#define SCHEDULER_DEFAULT_IDLE_AFTER_MS		60000	// static this long before the period backs off past max_ms
+
+/**
+ * Picks the next ranging period from each processed sample:
+ *   - activity (the state machine says so, or the range moved more than change_m): jump straight to the fast
+ *     period... scaled down by the measured speed above reference_speed (never below SCHEDULER_MIN_PERIOD_MS)
+ *   - a static scene: double the period each sample up to the ceiling (never above SCHEDULER_MAX_PERIOD_MS)
+ *   - a scene static for idle_after_ms (a stall sat EMPTY or OCCUPIED): keep doubling up to idle_ms... most of the
+ *     day is spent here, so this is what sets the wake ups per hour. A car arriving from long idle may be seen
+ *     first as OCCUPIED (no ARRIVING) and up to idle_ms late: the first activity drops straight back to fast.
+ */
+class SampleScheduler {
+    public:
+        // Default constructor
+        SampleScheduler();
+
+        // Destructor
+        virtual ~SampleScheduler();
+
+        // configure (values out of range are clamped)
+        void configure(int fast_ms,int max_ms,float change_m,float reference_speed,int idle_ms = SCHEDULER_DEFAULT_IDLE_MS,int idle_after_ms = SCHEDULER_DEFAULT_IDLE_AFTER_MS);
+
+        // a sample has been processed: range (m), measured speed (m/s) and whether the state machine wants fast sampling... returns the next period (ms)
+        int update(float range_m,float speed_m_s,bool active);
+
+        // the current period (ms)
+        int period_ms();
+
+        // configuration
+        int fast_ms();
+        int max_ms();
+        int idle_ms();
+        int idle_after_ms();
+
+        // how long the scene has been static (ms... stops counting at idle_after_ms)
+        int static_ms();
+
+    private:
+        int         m_fast_ms;
+        int         m_max_ms;
+        int         m_idle_ms;
+        int         m_idle_after_ms;
+        int         m_static_ms;
+        float       m_change_m;
+        float       m_reference_speed;
+        int         m_period_ms;
+        float       m_last_range_m;
+        bool        m_last_valid;
+};
+
+#endif // __SAMPLE_SCHEDULER_H__
@@ -0,0 +1,42 @@
+/**
+ * @file    SharedEventQueue.cpp
+ * @brief   mbed Endpoint shared event queue
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Interface
+#include "SharedEventQueue.h"
+
+// the queue and its dispatch thread (static stack)
+static EventQueue __shared_event_queue(SHARED_EVENT_QUEUE_SIZE);
+static unsigned char __shared_event_queue_stack[SHARED_EVENT_QUEUE_STACK_SIZE];
+static Thread __shared_event_queue_thread(osPriorityNormal,SHARED_EVENT_QUEUE_STACK_SIZE,__shared_event_queue_stack);
+static Mutex __shared_event_queue_mutex;
+static bool __shared_event_queue_started = false;
+
+// the shared event queue (its dispatch thread is started on first use)
+EventQueue *shared_event_queue() {
+    __shared_event_queue_mutex.lock();
+    if (__shared_event_queue_started == false) {
+        __shared_event_queue_thread.start(callback(&__shared_event_queue,&EventQueue::dispatch_forever));
+        __shared_event_queue_started = true;
+    }
+    __shared_event_queue_mutex.unlock();
+    return &__shared_event_queue;
+}
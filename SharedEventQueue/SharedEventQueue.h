@@ -0,0 +1,45 @@
+/**
+ * @file    SharedEventQueue.h
+ * @brief   mbed Endpoint shared event queue (header)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SHARED_EVENT_QUEUE_H__
+#define __SHARED_EVENT_QUEUE_H__
+
+// mbed API
+#include "mbed.h"
+#include "mbed_events.h"
+
+// TUNE: dispatch thread stack (resource handlers run here... logging, JSON and observations)
+#define SHARED_EVENT_QUEUE_STACK_SIZE		4096
+
+// TUNE: event storage (bytes)
+#define SHARED_EVENT_QUEUE_SIZE				(32 * EVENTS_EVENT_SIZE)
+
+/**
+ * One event queue (and one thread) for the short, non-blocking work of the resources (sensor processing,
+ * state machines). ISRs hand work to it with call()... handlers must not block (the camera keeps its own threads).
+ * Anything that can be held for long (the notification gate, the camera lock) is tried and retried with call_in():
+ * see NotificationScheduler::try_begin() and NotificationMailbox (MAILBOX_BUSY).
+ * The dispatch thread is started on first use... after the endpoint main loop is running.
+ */
+EventQueue *shared_event_queue();
+
+#endif // __SHARED_EVENT_QUEUE_H__
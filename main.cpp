@@ -120,6 +120,10 @@ extern "C" void init_lcd_and_leds();
 #endif
 
 #if ENABLE_V2_OCCUPANCY_DETECTOR
+	// V2: OccupancyHistoryResource (batched transition history for the detector)
+	#include "mbed-endpoint-resources/OccupancyHistoryResource.h"
+	OccupancyHistoryResource occupancy_history(&logger,"401","1",true);
+
 	// V2: ParkingStallOccupancyDetectorResource
 	#include "mbed-endpoint-resources/ParkingStallOccupancyDetectorResource.h"
 	ParkingStallOccupancyDetectorResource occupancy_detector(&logger,"400","1",true);
@@ -157,6 +161,7 @@ Connector::Options *configure_endpoint(Connector::OptionsBuilder &config)
 #endif
 #if ENABLE_V2_OCCUPANCY_DETECTOR
 	.addResource(&occupancy_detector,(bool)false)	// observation issued upon motion detection...
+	.addResource(&occupancy_history,(bool)false)	// observation issued upon transitions (batched)...
 #endif			
                    
         // finalize the configuration...
@@ -36,28 +36,146 @@ static CameraOV528 __camera(A3,A2);
 // our instance
 void *_camera_instance = NULL;
 
-// Base64 encoder/decoder
-#include "Base64.h"
+// Base64 incremental encoder (no heap... encodes into caller supplied buffers)
+#include "Base64StreamEncoder.h"
 
-// Gzip utils
-#include "gzip_utils.h"
+// Streaming gzip (fixed zlib workspace)
+#include "GzipStreamCompressor.h"
+
+// JSON parsing support
+#include "MbedJSONValue.h"
+
+// mbed-client configuration (blockwise payload size)
+#include "mbed_client_config.h"
+
+// credit based observation pacing
+#include "ObservationPacer.h"
+
+// capture budget (smoothed image throughput)
+#include "CaptureBudget.h"
+
+// notification scheduler (image chunks yield to state changes and expiry)
+#include "NotificationScheduler.h"
+
+// JPEG luma grid fingerprint (duplicate suppression)
+#include "ImageFingerprint.h"
+
+// shared event queue (the occupancy detector hooks run there)
+#include "SharedEventQueue.h"
+
+// camera command queues (commands carry their own resend chunk lists)
+#include "CameraCommandQueue.h"
+
+// OPTION: Enable/Disable Base64 encode of image
+#define DO_BASE64_ENCODE_IMAGE				true		 // true: base64 encode of final image data (text), false - send raw image bytes as opaque (application/octet-stream) chunks
+
+// OPTION: Enable/Disable GZIP of image
+#define DO_GZIP_IMAGE						false		 // true: gzip prior to base64 encoding... false: just base64 encode raw JPEG
 
 // TUNE: buffer sizes
 #define MAX_CAMERA_BUFFER_SIZE              5192         // ~5k jpeg for image resolution 160x120... plus some wiggle room...
+
+// capture slot buffer: GZIP reserves its worst case stream (GZIP_BOUND: +754 bytes of RAM per slot for 5192) so any picture
+// that fits MAX_CAMERA_BUFFER_SIZE keeps its resolution with compression on
+#if DO_GZIP_IMAGE
+#define CAMERA_SLOT_BUFFER_SIZE				GZIP_BOUND(MAX_CAMERA_BUFFER_SIZE)
+#else
+#define CAMERA_SLOT_BUFFER_SIZE				MAX_CAMERA_BUFFER_SIZE
+#endif
 #define MAX_MESSAGE_SIZE                    1024         // CoAP limits to 1024 - max message length
 #define PREFERRED_MESSAGE_LEN				225	         // preferred "chunk" size for a single observation
 
-// TUNE: how long we wait between sending image observations
-#define WAIT_BETWEEN_OBSERVATIONS_MS		750	     	 // # of seconds (in ms) to wait between sending observations
+// TUNE: how many image observations we allow in flight (credits) before waiting for a delivery acknowledgement
+#define OBSERVATION_WINDOW					1			 // pacing adapts to the acknowledgement RTT (starts at 750ms... the old fixed wait)
 
 // OPTION: use a Thread to dispatch the observations
-#define USE_THREADING						true		 // true: a dispatch thread will send observations, false: post() execution will send observations
+#define USE_THREADING						true		 // true: the camera worker thread captures and the streamer thread sends observations, false: post() execution will capture and send observations
 
-// OPTION: Enable/Disable Base64 encode of image
-#define DO_BASE64_ENCODE_IMAGE				true		 // true: base64 encode of final image data, false - send as raw data (may break!)
+// TUNE: camera worker and streamer threads (statically allocated stacks... their bounded command queues: see CameraCommandQueue.h)
+#define CAMERA_WORKER_STACK_SIZE			4096
+#define CAMERA_STREAMER_STACK_SIZE			4096
 
-// OPTION: Enable/Disable GZIP of image
-#define DO_GZIP_IMAGE						false		 // true: gzip prior to base64 encoding... false: just base64 encode raw JPEG
+// TUNE: image history - streamed images kept (beyond the double buffer) for resend/select after their END has gone out
+// RAM: each entry is one more capture slot of CAMERA_SLOT_BUFFER_SIZE (~5.3 KB... ~6 KB with DO_GZIP_IMAGE). With 0 a streamed
+// image is still retained in its slot until the camera needs that slot again (a resend right after END still finds it)
+#define CAMERA_HISTORY_DEPTH				0
+
+// TUNE: capture slots (double buffering: the next picture is captured into one slot while another is streamed... the rest hold the history)
+// RAM: (2 + CAMERA_HISTORY_DEPTH) x sizeof(camera_slot_t)... ~10.6 KB by default
+#define CAMERA_CAPTURE_SLOTS				(2 + CAMERA_HISTORY_DEPTH)
+
+// TUNE: longest history listing we will build for GET
+#define CAMERA_HISTORY_ENTRY_LEN			96
+
+// OPTION: camera power management
+#define DO_CAMERA_POWER_MANAGEMENT			true		 // true: camera stays powered down while the stall is EMPTY, warms up when a car is ARRIVING (or on demand for a capture), false: powered up once at startup
+
+// capture slot states
+enum CameraSlotStates {
+	CAMERA_SLOT_FREE=0,				// never used
+	CAMERA_SLOT_CAPTURING=1,		// being filled by the camera
+	CAMERA_SLOT_READY=2,			// captured... waiting for the streamer
+	CAMERA_SLOT_STREAMING=3,		// being observed (stream, resend or select)
+	CAMERA_SLOT_RETAINED=4			// streamed... kept for resend/select until the camera needs the slot again
+};
+
+// capture slot: one picture and its own image id
+typedef struct {
+	uint8_t           buffer[CAMERA_SLOT_BUFFER_SIZE+1];
+	uint32_t          picture_length;	// size reported by the camera (clipped to the buffer)
+	uint32_t          length;			// bytes captured (gzipped length if DO_GZIP_IMAGE)
+	volatile uint32_t encode_length;	// bytes to encode (expected until the capture completes... 0 if unknown)
+	volatile uint32_t fill;				// bytes the streamer may encode so far
+	volatile bool     complete;			// capture finished... encode_length is final
+	volatile bool     failed;			// capture failed after streaming may have started (END carries an error)
+	uint16_t          image_id;
+	int               resolution;		// index into __camera_resolutions actually used
+	bool              preview;			// progressive preview (smallest resolution, large chunks)
+	int               chunk_length;		// encoded bytes per chunk observation
+	int               capture_ms;		// capture start (latency instrumentation)
+	time_t            timestamp;		// capture time (epoch seconds)
+	int               event;			// stall event counter that triggered a local capture (0: cloud POST)
+	ImageFingerprint  fingerprint;		// JPEG luma grid fingerprint (decoded as the camera is read)
+	CameraSlotStates  state;
+} camera_slot_t;
+
+// capture resolutions, largest first (a picture that will not fit is retaken one step down)
+typedef struct {
+	CameraOV528::Resolution resolution;
+	const char             *name;
+} camera_resolution_t;
+static const camera_resolution_t __camera_resolutions[] = {
+	{ CameraOV528::RES_640x480, "640x480" },
+	{ CameraOV528::RES_320x240, "320x240" },
+	{ CameraOV528::RES_160x120, "160x120" },
+	{ CameraOV528::RES_80x60,   "80x60"   }
+};
+#define NUM_CAMERA_RESOLUTIONS				((int)(sizeof(__camera_resolutions) / sizeof(camera_resolution_t)))
+
+// TUNE: preferred capture resolution (index into __camera_resolutions... each capture starts here)
+#define CAMERA_PREFERRED_RESOLUTION			2			 // 160x120
+
+// TUNE: link budget - longest we want to spend sending one image at the smoothed image throughput (0: no budget... only the buffer size bounds a capture)
+// (legacy 750 ms pacing of 225 characters is 300 bytes/sec: 30 s still carries a ~5 KB 160x120 frame)
+#define CAMERA_TRANSFER_BUDGET_MS			30000
+
+// TUNE: camera read block size (each block is handed to the streamer, or gzip compressed, as soon as it is read from the camera)
+#define CAMERA_READ_BLOCK_SIZE				512
+
+// OPTION: pipeline camera read, encode and send
+#define PIPELINE_CAMERA_READ				true		 // true: the first chunk goes out while the tail of the picture is still being read, false: read the whole picture before streaming
+
+// TUNE: how long the streamer waits for the next camera block before re-checking (ms)
+#define CAMERA_FILL_WAIT_MS					100
+
+// TUNE: how long the camera worker retries handing a captured picture to a full streamer queue (ms)
+#define CAMERA_STREAM_ENQUEUE_MS			10000
+
+// TUNE: how soon a detector hook request is retried while the camera holds its lock (ms... the shared event queue never blocks on it)
+#define CAMERA_HOOK_RETRY_MS				10
+
+// OPTION: Enable/Disable CoAP blockwise (Block2) delivery of the image
+#define USE_BLOCKWISE_TRANSFER				false		 // true: one "image ready" observation then the server GETs the whole image blockwise, false: chunked observations + END
 
 // OPTION: Clip message
 #define DO_CLIP_MESSAGE						false		 // set to true to clip an image...
@@ -66,32 +184,124 @@ void *_camera_instance = NULL;
 // END delimiter - this will be checked in the NodeRED flow to initiate the "join" node to combine the image segments
 #define END_DELIMITER						"END"
 
+// camera event resource (/300/0/2): the stall event that triggered a local capture is observed here after its END (END itself stays literal)
+#define CAMERA_EVENT_RES_NAME				"2"
+#define CAMERA_EVENT_LEN					80
+
+// OPTION: Enable/Disable per-chunk headers (image id, chunk index, total count, CRC32)
+#define DO_CHUNK_HEADERS					false		 // true: "<id>:<index>/<total>:<crc32>:" text (or 12 byte binary) header per chunk and "END:<id>:<total>:<resolution>", false: anonymous chunks + END (total is 0 while a pipelined gzip capture is still being read)
+#define CHUNK_HEADER_MAX_LEN				32			 // room reserved for a chunk header
+#define END_MAX_LEN							48			 // tagged END: "END:<id>:<total>:<resolution>"
+#define END_ERROR							"ERROR"		 // failed capture: "END:<id>:ERROR" (chunks already sent for it must be discarded)
+#define BINARY_CHUNK_HEADER_LEN				12			 // id(2) index(2) total(2) reserved(2) crc32(4)... big endian
+
+// OPTION: Enable/Disable progressive delivery
+#define DO_PROGRESSIVE_PREVIEW				false		 // true: each POST first streams an 80x60 preview (its own image id and END) while the full picture is captured, false: full picture only
+#define PREVIEW_MESSAGE_LEN					900			 // preview "chunk" size (a few large observations... leaves room for a chunk header)
+
+// OPTION: Enable/Disable duplicate image suppression
+#define DO_SUPPRESS_DUPLICATES				false		 // true: a capture matching the last delivered image (within tolerance) sends one "unchanged" observation instead of its chunks, false: always stream
+#define CAMERA_DUPLICATE_TOLERANCE			50			 // share of the luma grid cells (per mille) that may change (beyond the exposure shift) for a capture to count as unchanged... 0: every cell within FINGERPRINT_CELL_THRESHOLD
+
+// "unchanged" observation length (duplicate suppression)
+#define UNCHANGED_LEN						48
+
+// "image ready" observation length (BLOCKWISE mode)
+#define IMAGE_READY_LEN						80
+
+// blockwise GET encode scratch (BLOCKWISE mode... on the mbed-client thread stack)
+#define BLOCKWISE_ENCODE_LEN				128
+
 // Thumbnail debugging length
 #define THUMBNAIL_LEN						20
 
-// RangeFinder Observation Latch reset
-extern "C" void reset_observation_latch();
+// Binary thumbnail debugging length (bytes dumped in hex)
+#define BINARY_THUMBNAIL_LEN				8
+
+// CoAP content type of the camera resource (binary chunks are opaque... explicit lengths, NULs are safe)
+#if DO_BASE64_ENCODE_IMAGE
+	#define CAMERA_RESOURCE_TYPE			M2MResourceInstance::STRING
+#else
+	#define CAMERA_RESOURCE_TYPE			M2MResourceInstance::OPAQUE
+#endif
 
-// observation processor forward reference
-extern "C" void _process_observations(const void *args);
+// camera worker forward reference
+extern "C" void _camera_worker(const void *args);
 
-// temp buffer
-static uint8_t tmp_buffer[MAX_CAMERA_BUFFER_SIZE+1];
+// camera worker stack
+static unsigned char __camera_worker_stack[CAMERA_WORKER_STACK_SIZE];
+
+// camera streamer forward reference
+extern "C" void _camera_streamer(const void *args);
+
+// camera streamer stack
+static unsigned char __camera_streamer_stack[CAMERA_STREAMER_STACK_SIZE];
+
+// notification delivery callback forward reference
+extern "C" void _camera_notification_sent(void);
+
+// detector hook requests forward reference (EVENT QUEUE)
+extern "C" void _camera_apply_requests(void);
+
+#if DO_GZIP_IMAGE
+// gzip: fixed zlib workspace, camera read block and streaming compressor (the camera is read directly into the capture buffer otherwise)
+static uint8_t __gzip_workspace[GZIP_WORKSPACE_SIZE(GZIP_WINDOW_BITS,GZIP_MEM_LEVEL)];
+static uint8_t __camera_read_block[CAMERA_READ_BLOCK_SIZE];
+static GzipStreamCompressor __gzip(__gzip_workspace,sizeof(__gzip_workspace));
+#endif
 
 /** CameraResource class
  */
 class CameraResource : public DynamicResource
 {
 private:
-	Thread         *m_observer;
-    uint8_t         m_camera_buffer[MAX_CAMERA_BUFFER_SIZE+1];
-    uint32_t        m_camera_buffer_length;
-    string          m_image;
-    vector<string>  m_image_list;
-    int			    m_image_list_index;
-    Base64          m_base64;
+	Thread          m_worker;
+	Thread          m_streamer;
+	bool            m_worker_started;
+	int             m_requested_power;
+	int             m_requested_capture_event;
+	bool            m_requests_retry_scheduled;
+	CameraCommandQueue m_commands;
+	CameraCommandQueue m_stream_commands;
+	Mutex           m_capture_mutex;
+	bool            m_capture_pending;
+	int             m_capture_event;
+	int             m_current_event;
+	int             m_coalesced_captures;
+	int             m_stream_enqueue_failures;
+    camera_slot_t   m_slots[CAMERA_CAPTURE_SLOTS];
+    camera_slot_t  *m_slot;
+    Mutex           m_slot_mutex;
+    Semaphore       m_slot_released;
+    Semaphore       m_slot_filled;
+    Timer           m_clock;
+    char            m_chunk[MAX_MESSAGE_SIZE+1];
+    int             m_chunk_length;
+    int             m_chunk_index;
+    volatile int    m_ready_image_id;
+    Base64StreamEncoder m_base64;
+    Base64StreamEncoder m_block_base64;
     Authenticator  *m_authenticator;
-    string 			m_end;
+    string          m_camera_res_name;
+    M2MResource    *m_event_res;
+    ObservationPacer m_pacer;
+    CaptureBudget   m_budget;
+    uint16_t        m_image_id;
+    int             m_preferred_resolution;
+    int             m_retakes;
+    ImageFingerprintDecoder m_fingerprinter;
+    ImageFingerprint m_delivered;
+    int             m_delivered_id;
+    int             m_duplicate_tolerance;
+    int             m_suppressed;
+    bool            m_powered;
+    bool            m_power_wanted;
+    int             m_power_changed_ms;
+    int             m_power_on_ms;
+    int             m_power_off_ms;
+    int             m_capture_requested_ms;
+    int             m_capture_latency_ms[2];
+    int             m_num_captures[2];
 
 public:
     /**
@@ -101,74 +311,239 @@ public:
     @param res_name input the Light Resource name
     @param observable input the resource is Observable (default: FALSE)
     */
-    CameraResource(const Logger *logger,const char *obj_name,const char *res_name,const bool observable = false,Authenticator *authenticator = NULL) : DynamicResource(logger,obj_name,res_name,"Camera",M2MBase::GET_POST_ALLOWED,observable) {
+    CameraResource(const Logger *logger,const char *obj_name,const char *res_name,const bool observable = false,Authenticator *authenticator = NULL) : DynamicResource(logger,obj_name,res_name,"Camera",M2MBase::GET_PUT_POST_ALLOWED,observable,CAMERA_RESOURCE_TYPE), m_worker(osPriorityNormal,CAMERA_WORKER_STACK_SIZE,__camera_worker_stack), m_streamer(osPriorityNormal,CAMERA_STREAMER_STACK_SIZE,__camera_streamer_stack), m_slot_released(0), m_slot_filled(0), m_pacer(OBSERVATION_WINDOW), m_budget(CAMERA_SLOT_BUFFER_SIZE,CAMERA_TRANSFER_BUDGET_MS,DO_BASE64_ENCODE_IMAGE) {
         _camera_instance = (void *)this;
+        this->m_camera_res_name = res_name;
+        this->m_event_res = NULL;
     	this->m_authenticator = authenticator;
-        memset(this->m_camera_buffer,0,MAX_CAMERA_BUFFER_SIZE+1);   
-        this->m_camera_buffer_length = 0;
-        this->m_image = "";
-        this->m_image_list.empty();
-        this->m_image_list_index = -1;
-        this->init_camera();
-        this->m_observer = NULL;
-        this->m_end = END_DELIMITER;
+        for(int i=0;i<CAMERA_CAPTURE_SLOTS;++i) {
+        	memset(this->m_slots[i].buffer,0,CAMERA_SLOT_BUFFER_SIZE+1);
+        	this->m_slots[i].picture_length = 0;
+        	this->m_slots[i].length = 0;
+        	this->m_slots[i].encode_length = 0;
+        	this->m_slots[i].fill = 0;
+        	this->m_slots[i].complete = false;
+        	this->m_slots[i].image_id = 0;
+        	this->m_slots[i].resolution = CAMERA_PREFERRED_RESOLUTION;
+        	this->m_slots[i].preview = false;
+        	this->m_slots[i].chunk_length = PREFERRED_MESSAGE_LEN;
+        	this->m_slots[i].capture_ms = 0;
+        	this->m_slots[i].timestamp = 0;
+        	this->m_slots[i].event = 0;
+        	this->m_slots[i].state = CAMERA_SLOT_FREE;
+        }
+        this->m_slot = NULL;
+        this->m_clock.start();
+        this->m_ready_image_id = -1;
+        this->clear_chunk();
+        this->m_preferred_resolution = CAMERA_PREFERRED_RESOLUTION;
+        this->m_retakes = 0;
+        this->m_delivered_id = -1;
+        this->m_duplicate_tolerance = CAMERA_DUPLICATE_TOLERANCE;
+        this->m_suppressed = 0;
+        this->m_power_changed_ms = 0;
+        this->m_power_on_ms = 0;
+        this->m_power_off_ms = 0;
+        this->m_capture_requested_ms = -1;
+        memset(this->m_capture_latency_ms,0,sizeof(this->m_capture_latency_ms));
+        memset(this->m_num_captures,0,sizeof(this->m_num_captures));
+        this->m_powered = false;
+        this->m_power_wanted = false;
+        if (DO_CAMERA_POWER_MANAGEMENT == false) {
+        	// powered up once... and left on
+        	this->init_camera();
+        	this->m_powered = true;
+        	this->m_power_wanted = true;
+        }
+        this->m_image_id = 0;
+        this->m_worker_started = false;
+        this->m_requested_power = -1;
+        this->m_requested_capture_event = 0;
+        this->m_requests_retry_scheduled = false;
+        this->m_capture_pending = false;
+        this->m_capture_event = 0;
+        this->m_current_event = 0;
+        this->m_coalesced_captures = 0;
+        this->m_stream_enqueue_failures = 0;
+    }
+
+    /**
+    Bind the resource... also hooks the notification delivery callback that paces our observations
+    and creates the (read only, observable) camera event resource for local captures
+    @param p input the endpoint instance
+    @returns M2MObject for the camera
+    */
+    virtual M2MObject *bind(void *p) {
+        M2MObject *obj = DynamicResource::bind(p);
+        if (obj != NULL && obj->object_instance() != NULL) {
+        	M2MResource *res = obj->object_instance()->resource(this->m_camera_res_name.c_str());
+        	if (res != NULL) {
+        		res->set_notification_sent_callback(_camera_notification_sent);
+        	}
+        	this->m_event_res = obj->object_instance()->create_dynamic_resource(CAMERA_EVENT_RES_NAME,"CameraEvent",M2MResourceInstance::STRING,true);
+        	if (this->m_event_res != NULL) {
+        		this->m_event_res->set_operation(M2MBase::GET_ALLOWED);
+        	}
+        	else {
+        		this->logger()->log("CameraResource: unable to create the camera event resource");
+        	}
+        }
+        return obj;
+    }
+
+    /**
+    Notification delivery acknowledged (mbed-client callback)
+    */
+    void notification_sent() {
+        this->m_pacer.delivered();
+    }
+
+    // observe as bulk data... state change and expiry notifications waiting go first (so images yield at each chunk)
+    void observe_bulk() {
+    	notification_scheduler()->begin(NOTIFY_BULK);
+    	this->observe();
+    	notification_scheduler()->end(NOTIFY_BULK);
     }
 
     /**
-    Get the Camera's last taken picture
-    @returns string containing base64 encoded image from the camera
+    Get the Camera's current image chunk
+    Random access: PUT "select" (or "history") first... the GET then returns that chunk of any retained image (or the listing)
+    @returns string containing the current (base64 encoded) image chunk, the END delimiter, the history listing, or empty
     */
     virtual string get() { 
-        // return the last image we have taken...
-    	if (this->m_image.compare(this->m_end) != 0 && this->m_image_list_index >= 0 && this->m_image_list.size() > 0 && this->m_image_list_index < (int)this->m_image_list.size()) {
-    		// DEBUG
-    		int last = this->m_image_list[this->m_image_list_index].size() - THUMBNAIL_LEN;
-    		this->logger()->log("CameraResource: GET(%d): (%d bytes): %s...%s",this->m_image_list_index,this->m_image_list[this->m_image_list_index].size(),this->m_image_list[this->m_image_list_index].substr(0,THUMBNAIL_LEN).c_str(),this->m_image_list[this->m_image_list_index].substr(last,THUMBNAIL_LEN).c_str());
+        // BLOCKWISE: once the "image ready" observation is out, a GET returns the whole retained image (mbed-client splits it into Block2 blocks)
+        int ready_image_id = this->m_ready_image_id;
+        if (USE_BLOCKWISE_TRANSFER && ready_image_id >= 0) {
+        	return this->encode_image(ready_image_id);
+        }
 
-    		// return the current string from our array of strings
-    		return this->m_image_list[this->m_image_list_index];
-    	}
+        // DEBUG
+        this->log_chunk("GET");
 
-    	// default is to just return this image...
-    	this->logger()->log("CameraResource: GET: (%d bytes): %s",this->m_image.size(),this->m_image.c_str());
-        return this->m_image;
+        // the current chunk is the only copy of the image payload outside of the capture buffer
+        return string(this->m_chunk,this->m_chunk_length);
     }
     
+    /**
+    PUT: configure the camera or request chunks of the retained picture (AUTHENTICATED)
+    Format: {"cmd":"config","gzip_level":6,"resolution":"160x120","auth":"arm1234"}
+    gzip_level - zlib compression level (0..9) used for subsequent captures (DO_GZIP_IMAGE must be enabled)
+    resolution - preferred capture resolution (640x480, 320x240, 160x120 or 80x60)... captures step down from it when a picture will not fit
+    dup_tolerance - share of the luma grid cells (per mille) that may change for a capture to be reported "unchanged" (DO_SUPPRESS_DUPLICATES must be enabled)
+    Format: {"cmd":"resend","img":7,"chunks":[3,9],"auth":"arm1234"}
+    resend - re-observe the listed chunk indexes of retained image "img" (followed by END)
+    Format: {"cmd":"select","img":7,"chunk":3,"auth":"arm1234"}
+    select - make chunk "chunk" of retained image "img" the value returned by GET
+    Format: {"cmd":"history","auth":"arm1234"}
+    history - make the retained images the value returned by GET: {"history":[{"img":7,"ts":1490000000,"res":"160x120","chunks":31},...]}
+    */
+    virtual void put(const string value) {
+    	// parse the JSON
+    	MbedJSONValue parsed;
+    	parse(parsed,value.c_str());
+
+    	// we need the authorization string
+    	string cmd = parsed["cmd"].get<string>();
+    	string auth = parsed["auth"].get<string>();
+    	if (strcmp(auth.c_str(),MY_DM_PASSPHRASE) != 0) {
+    		this->logger()->log("CameraResource: put() authentication ERROR. Invalid/Missing auth: [%s]",auth.c_str());
+    		return;
+    	}
+
+    	// act on the command
+    	if (cmd.compare(string("config")) == 0) {
+    		if (parsed.hasMember((char *)"gzip_level")) {
+#if DO_GZIP_IMAGE
+    			__gzip.set_level(parsed["gzip_level"].get<int>());
+    			this->logger()->log("CameraResource: put() gzip level: %d",__gzip.level());
+#else
+    			this->logger()->log("CameraResource: put() gzip not enabled... ignoring gzip_level (OK).");
+#endif
+    		}
+    		if (parsed.hasMember((char *)"resolution")) {
+    			string resolution = parsed["resolution"].get<string>();
+    			int index = this->find_resolution(resolution.c_str());
+    			if (index >= 0) {
+    				this->m_preferred_resolution = index;
+    				this->logger()->log("CameraResource: put() preferred resolution: %s",__camera_resolutions[index].name);
+    			}
+    			else {
+    				this->logger()->log("CameraResource: put() resolution %s unsupported... ignoring (OK).",resolution.c_str());
+    			}
+    		}
+    		if (parsed.hasMember((char *)"dup_tolerance")) {
+    			this->m_duplicate_tolerance = parsed["dup_tolerance"].get<int>();
+    			this->logger()->log("CameraResource: put() duplicate tolerance: %d (suppression %s)",this->m_duplicate_tolerance,DO_SUPPRESS_DUPLICATES ? "enabled" : "disabled");
+    		}
+    	}
+    	else if (cmd.compare(string("resend")) == 0 || cmd.compare(string("select")) == 0) {
+    		// the chunks must come from a picture we are still retaining (the streamer checks again when it runs)
+    		int image_id = parsed["img"].get<int>();
+    		if (this->find_slot(image_id) < 0) {
+    			this->logger()->log("CameraResource: put() image %d is not retained (latest: %d)... ignoring (OK).",image_id,(int)this->m_image_id);
+    		}
+    		else if (cmd.compare(string("resend")) == 0) {
+    			// the requested chunk indexes travel with the command... the streamer re-observes them
+    			uint16_t chunks[MAX_RESEND_CHUNKS];
+    			int num_chunks = 0;
+    			for(int i=0;i<parsed["chunks"].size() && num_chunks < MAX_RESEND_CHUNKS;++i) {
+    				int chunk = parsed["chunks"][i].get<int>();
+    				if (chunk >= 0 && chunk <= 0xFFFF) {
+    					chunks[num_chunks++] = (uint16_t)chunk;
+    				}
+    			}
+    			this->logger()->log("CameraResource: put() resend %d chunks of image %d",num_chunks,image_id);
+    			this->start_worker();
+    			this->queue_command(CAMERA_CMD_RESEND,0,image_id,chunks,num_chunks);
+    		}
+    		else {
+    			// select the chunk for the next GET
+    			this->start_worker();
+    			this->queue_command(CAMERA_CMD_SELECT,parsed["chunk"].get<int>(),image_id);
+    		}
+    	}
+    	else if (cmd.compare(string("history")) == 0) {
+    		// list the retained images for the next GET
+    		this->start_worker();
+    		this->queue_command(CAMERA_CMD_HISTORY);
+    	}
+    	else {
+    		this->logger()->log("CameraResource: put() cmd=%s is unrecognized... ignoring (OK).",cmd.c_str());
+    	}
+    }
+
     /**
     POST: Take a picture with the camera (AUTHENTICATED)
+    Captures are queued to the camera worker. Queueing policy: at most one capture is pending at a time.
+    A POST arriving while a capture is pending (not yet started) is coalesced into it... that capture
+    is taken after both POSTs arrived so it satisfies both. A POST arriving while a capture or transfer
+    is in progress queues a fresh capture. The camera worker captures into a free slot while the streamer
+    is still sending the previous picture... it only waits when every slot is captured or streaming.
+    Every captured picture is streamed: a full streamer queue is retried for up to CAMERA_STREAM_ENQUEUE_MS
+    and only then is the picture retained (reachable by a resend) and the failure logged as an ERROR.
     */
     virtual void post(void *args) {
         if (this->authenticate(args)) {
         	// authenticatd
         	this->logger()->log("CameraResource: POST authenticated successfully...");
 
-    		// reset observation state
-    		this->resetObservationState();
+            if (USE_THREADING) {
+            	// we have to wait until the main loop starts in the endpoint before we start our worker...
+            	this->start_worker();
 
-    		// take a picture
-    		this->logger()->log("CameraResource: Taking a picture...");
-    		this->take_picture();
-
-            // start a new observer thread
-            if (USE_THREADING && this->m_observer == NULL) {
-            	// launch a thread that will invoke process_observations()...
-            	this->logger()->log("CameraResource: Starting observation processing thread...");
-            	this->m_observer = new Thread();
-            	if (this->m_observer != NULL) {
-            		this->m_observer->start(callback(_process_observations,(const void *)NULL));
-            	}
-            	else {
-            		this->logger()->log("CameraResource: unable to allocate Thread. Aborting...");
-            	}
-            }
-            else if (this->m_observer == NULL) {
-            	// call directly...
-            	this->logger()->log("CameraResource: calling process_observations() directly...");
-            	this->process_observations();
+            	// queue (or coalesce) the capture
+            	this->queue_capture();
             }
             else {
-            	// ERROR
-            	this->logger()->log("CameraResource: observation process thread lingering (ERROR)");
+            	// call directly...
+            	this->logger()->log("CameraResource: capturing and calling process_observations() directly...");
+            	this->m_capture_requested_ms = this->m_clock.read_ms();
+            	this->m_current_event = 0;
+            	if (DO_PROGRESSIVE_PREVIEW) {
+            		this->process_observations(this->capture(true)->image_id);
+            	}
+            	this->process_observations(this->capture(false)->image_id);
+            	this->power_down_if_unwanted();
             }
         }
         else {
@@ -177,44 +552,183 @@ public:
         }
     }
 
-    // process observations: split an image into suitable CoAP messages and create "n" observations with it
-	void process_observations() {
-		// encode the image
-		this->logger()->log("CameraResource: Base64 encoding picture...");
-		this->encode_image();
+    // camera worker: process the capture queue forever
+    void run_worker() {
+    	this->run_commands(this->m_commands);
+    }
+
+    // camera streamer: process the stream queue forever
+    void run_streamer() {
+    	this->run_commands(this->m_stream_commands);
+    }
+
+    // POWER: the stall wants the camera on (ARRIVING/OCCUPIED) or off (EMPTY)... the camera worker does the (slow) power up/down (EVENT QUEUE)
+    void request_power(bool on) {
+    	if (DO_CAMERA_POWER_MANAGEMENT == false) {
+    		return;
+    	}
+    	this->m_requested_power = on ? 1 : 0;
+    	this->apply_requests();
+    }
+
+    // local capture: the stall went OCCUPIED... capture now instead of waiting for the cloud POST (image stream tagged with "event") (EVENT QUEUE)
+    void request_local_capture(int event) {
+    	if (USE_THREADING == false) {
+    		// the capture would run on the detector thread... leave it to the cloud POST
+    		this->logger()->log("CameraResource: local capture needs USE_THREADING... ignoring event %d",event);
+    		return;
+    	}
+    	this->logger()->log("CameraResource: local capture requested (event: %d)",event);
+    	this->m_requested_capture_event = event;
+    	this->apply_requests();
+    }
+
+    // apply the latest detector requests (EVENT QUEUE)... never blocks: retried in CAMERA_HOOK_RETRY_MS while the camera holds its lock
+    void apply_requests() {
+    	if (this->m_capture_mutex.trylock() == false) {
+    		if (this->m_requests_retry_scheduled == false) {
+    			this->m_requests_retry_scheduled = (shared_event_queue()->call_in(CAMERA_HOOK_RETRY_MS,_camera_apply_requests) != 0);
+    		}
+    		return;
+    	}
+    	if (USE_THREADING) {
+    		this->start_worker_locked();
+    	}
+
+    	// power first... a capture wants the camera on anyway
+    	int power = this->m_requested_power;
+    	this->m_requested_power = -1;
+    	if (power >= 0 && this->m_power_wanted != (power == 1)) {
+    		this->m_power_wanted = (power == 1);
+    		if (USE_THREADING) {
+    			this->queue_command(this->m_power_wanted ? CAMERA_CMD_POWER_UP : CAMERA_CMD_POWER_DOWN);
+    		}
+    	}
+    	int event = this->m_requested_capture_event;
+    	this->m_requested_capture_event = 0;
+    	if (event > 0) {
+    		this->queue_capture_locked(event);
+    	}
+    	this->m_capture_mutex.unlock();
+    }
+
+    // retry the detector requests (EVENT QUEUE)
+    void retry_requests() {
+    	this->m_requests_retry_scheduled = false;
+    	this->apply_requests();
+    }
+
+    // process observations: encode each CoAP message sized chunk of captured image "image_id" on demand and create "n" observations with it
+	void process_observations(int image_id) {
+		// take the captured slot
+		if (this->checkout_slot(image_id,CAMERA_SLOT_READY) == NULL) {
+			this->logger()->log("CameraResource: image %d is not ready to stream... ignoring",image_id);
+			return;
+		}
 
-		// wait a bit...
-		this->logger()->log("CameraResource: waiting a bit...");
-		Thread::wait(2*WAIT_BETWEEN_OBSERVATIONS_MS);
+		// OPTION: same picture as the last one we delivered? just say so
+		this->resetObservationState();
+		if (DO_SUPPRESS_DUPLICATES && this->m_slot->preview == false && this->is_duplicate()) {
+			this->send_unchanged_observation();
+			this->send_event_observation();
+			this->release_slot(this->m_slot);
+			return;
+		}
+
+		// stream it... then retain it for resend/select
+		this->logger()->log("CameraResource: streaming image %d (slot %d)...",image_id,(int)(this->m_slot - this->m_slots));
+		this->stream_observations();
+		if (this->m_slot->preview == false && this->m_slot->fingerprint.valid()) {
+			// the reference for duplicate suppression is the last image actually delivered
+			this->m_delivered = this->m_slot->fingerprint;
+			this->m_delivered_id = this->m_slot->image_id;
+		}
+		this->release_slot(this->m_slot);
+	}
+
+	// stream the encoded image as observations
+	void stream_observations() {
+		// BLOCKWISE: just announce the image... the server pulls it with a single blockwise GET
+		if (USE_BLOCKWISE_TRANSFER) {
+			this->wait_for_capture();
+			this->send_image_ready_observation();
+			this->logger()->log("CameraResource: image %d latency: capture-to-ready: %d ms",(int)this->m_slot->image_id,this->m_clock.read_ms() - this->m_slot->capture_ms);
+			return;
+		}
+
+		// each observation (including END) waits for a credit... acknowledgements pace us, not a fixed sleep
+		int num_observations = 0;
+		int first_chunk_ms = -1;
+		this->m_pacer.begin();
 
-		// get the number of chunks we have to make
-		int num_observations = this->calculateNumberOfObservations(PREFERRED_MESSAGE_LEN);
-		if (num_observations > 0) {
-			// loop through and send each observation
-			for(int i=0;i<num_observations;++i) {
-				// set current the ith observation
-				this->setCurrentObservation(i);
+		// PIPELINE: each chunk goes out as soon as its bytes have come off the camera
+		while (this->wait_for_chunk(num_observations,this->m_slot->chunk_length)) {
+			// wait for a credit
+			this->m_pacer.acquire();
 
-				// create/send the observation
-				this->observe();
+			// encode the ith chunk as the current observation
+			this->setCurrentObservation(num_observations,this->m_slot->chunk_length);
 
-				// wait a bit
-				Thread::wait(WAIT_BETWEEN_OBSERVATIONS_MS);
+			// create/send the observation
+			this->observe_bulk();
+			this->m_pacer.sent(this->m_chunk_length);
+			if (num_observations == 0) {
+				first_chunk_ms = this->m_clock.read_ms() - this->m_slot->capture_ms;
 			}
+			++num_observations;
 		}
-		else {
+		if (num_observations == 0) {
 			// image is empty... no observations made
 			this->logger()->log("CameraResource: Image is emnpty... no observations made (OK).");
 		}
 
-		// wait a bit
-		Thread::wait(WAIT_BETWEEN_OBSERVATIONS_MS);
+		// wait for a credit
+		this->m_pacer.acquire();
 
 		// send the end message - this will invoke processing on the image...
 		this->send_end_observation();
+		this->m_pacer.sent(this->m_chunk_length);
+		this->m_pacer.end();
+		this->m_budget.transfer(this->transfer_kind(num_observations),this->m_pacer.bytes_per_sec());
+		this->send_event_observation();
+
+		// DEBUG
+		this->logger()->log("CameraResource: pacing: %d ms/obs throughput: %d bytes/sec (image average: %d) rto: %d ms retransmissions: %d (acks: %s)",
+				this->m_pacer.pacing_ms(),this->m_pacer.bytes_per_sec(),this->m_budget.bytes_per_sec(),this->m_pacer.rto_ms(),this->m_pacer.retransmissions(),this->m_pacer.acks_seen() ? "yes" : "no");
+		this->logger()->log("CameraResource: image %d (%s, %d bytes) latency: %d observations (including END) time-to-first-chunk: %d ms capture-to-END: %d ms",
+				(int)this->m_slot->image_id,this->m_slot->preview ? "preview" : "full",this->encodedLength(),num_observations+1,first_chunk_ms,this->m_clock.read_ms() - this->m_slot->capture_ms);
+		this->logger()->log("CameraResource: notification queueing (avg/max ms): state: %d/%d (%d) expiry: %d/%d (%d) bulk: %d/%d (%d)",
+				notification_scheduler()->average_wait_ms(NOTIFY_STATE),notification_scheduler()->max_wait_ms(NOTIFY_STATE),notification_scheduler()->count(NOTIFY_STATE),
+				notification_scheduler()->average_wait_ms(NOTIFY_EXPIRY),notification_scheduler()->max_wait_ms(NOTIFY_EXPIRY),notification_scheduler()->count(NOTIFY_EXPIRY),
+				notification_scheduler()->average_wait_ms(NOTIFY_BULK),notification_scheduler()->max_wait_ms(NOTIFY_BULK),notification_scheduler()->count(NOTIFY_BULK));
+	}
+
+	// re-observe the requested chunks of retained image "image_id" (then END)
+	void resend_observations(int image_id,const uint16_t *chunks,int num_chunks) {
+		// hold the retained slot while we resend from it
+		if (this->checkout_slot(image_id,CAMERA_SLOT_RETAINED) == NULL) {
+			this->logger()->log("CameraResource: resend: image %d is no longer retained... ignoring (OK).",image_id);
+			return;
+		}
 
-		// now that the image has been observed... release the RangeFinder observation latch
-		reset_observation_latch();
+		// re-send them (paced)
+		int total = this->chunkCount(this->m_slot->chunk_length);
+		this->logger()->log("CameraResource: resending %d of %d chunks of image %d...",num_chunks,total,image_id);
+		this->m_pacer.begin();
+		for(int i=0;i<num_chunks;++i) {
+			if (chunks[i] < total) {
+				this->m_pacer.acquire();
+				this->setCurrentObservation(chunks[i],this->m_slot->chunk_length);
+				this->observe_bulk();
+				this->m_pacer.sent(this->m_chunk_length);
+			}
+		}
+		this->m_pacer.acquire();
+		this->send_end_observation();
+		this->m_pacer.sent(this->m_chunk_length);
+		this->m_pacer.end();
+		this->m_budget.transfer(CAPTURE_TRANSFER_RESEND,this->m_pacer.bytes_per_sec());
+		this->release_slot(this->m_slot);
 	}
 
 private:
@@ -229,185 +743,909 @@ private:
     // send the "END" observation
     void send_end_observation() {
     	this->logger()->log("CameraResource: Sending END observation...");
-    	this->m_image = END_DELIMITER;
-    	this->observe();
+    	if (this->m_slot->failed) {
+    		// ERROR: the server must discard whatever it has received for this image
+    		char buf[END_MAX_LEN+1];
+    		memset(buf,0,END_MAX_LEN+1);
+    		snprintf(buf,END_MAX_LEN,"%s:%d:%s",END_DELIMITER,(int)this->m_slot->image_id,END_ERROR);
+    		this->set_chunk(buf,strlen(buf));
+    	}
+    	else if (DO_CHUNK_HEADERS) {
+    		// END carries the image id and chunk count so the server can detect gaps
+    		char buf[END_MAX_LEN+1];
+    		memset(buf,0,END_MAX_LEN+1);
+    		snprintf(buf,END_MAX_LEN,"%s:%d:%d:%s",END_DELIMITER,(int)this->m_slot->image_id,this->chunkCount(this->m_slot->chunk_length),__camera_resolutions[this->m_slot->resolution].name);
+    		this->set_chunk(buf,strlen(buf));
+    	}
+    	else {
+    		// literal END... the NodeRED join completes on it
+    		this->set_chunk(END_DELIMITER,strlen(END_DELIMITER));
+    	}
+    	this->m_chunk_index = -1;
+    	this->observe_bulk();
+    }
+
+    // local capture: observe its stall event on the camera event resource (after its END... cloud POSTs have none)
+    void send_event_observation() {
+    	if (this->m_slot->event <= 0 || this->m_event_res == NULL) {
+    		return;
+    	}
+    	char buf[CAMERA_EVENT_LEN+1];
+    	memset(buf,0,CAMERA_EVENT_LEN+1);
+    	snprintf(buf,CAMERA_EVENT_LEN,"{\"img\":%d,\"event\":%d,\"res\":\"%s\",\"chunks\":%d,\"ok\":%d}",(int)this->m_slot->image_id,this->m_slot->event,
+    			__camera_resolutions[this->m_slot->resolution].name,this->chunkCount(this->m_slot->chunk_length),this->m_slot->failed ? 0 : 1);
+    	this->logger()->log("CameraResource: Sending camera event observation: %s",buf);
+    	notification_scheduler()->begin(NOTIFY_STATE);
+    	this->m_event_res->set_value((const uint8_t *)buf,(uint32_t)strlen(buf));
+    	notification_scheduler()->end(NOTIFY_STATE);
+    }
+
+    // DUPLICATE: does the streaming slot match the last delivered image (waits for the capture... the fingerprint is complete at EOI)
+    bool is_duplicate() {
+    	this->wait_for_capture();
+    	if (this->m_delivered_id < 0 || this->m_slot->encode_length == 0) {
+    		return false;
+    	}
+    	int difference = this->m_slot->fingerprint.difference(this->m_delivered);
+    	this->logger()->log("CameraResource: image %d differs from delivered image %d by %d/%d (tolerance: %d)",(int)this->m_slot->image_id,this->m_delivered_id,difference,FINGERPRINT_MAX_DIFFERENCE,this->m_duplicate_tolerance);
+    	return (difference <= this->m_duplicate_tolerance);
+    }
+
+    // send the "unchanged" observation (duplicate suppression)
+    void send_unchanged_observation() {
+    	char buf[UNCHANGED_LEN+1];
+    	memset(buf,0,UNCHANGED_LEN+1);
+    	snprintf(buf,UNCHANGED_LEN,"{\"img\":%d,\"unchanged\":1,\"same_as\":%d}",(int)this->m_slot->image_id,this->m_delivered_id);
+    	++this->m_suppressed;
+    	this->logger()->log("CameraResource: Sending unchanged observation: %s (suppressed: %d, saved %d bytes)",buf,this->m_suppressed,this->encodedLength());
+    	this->m_pacer.begin();
+    	this->m_pacer.acquire();
+    	this->set_chunk(buf,strlen(buf));
+    	this->m_chunk_index = -1;
+    	this->observe_bulk();
+    	this->m_pacer.sent(this->m_chunk_length);
+    	this->m_pacer.end();
+    	this->m_budget.transfer(CAPTURE_TRANSFER_UNCHANGED,this->m_pacer.bytes_per_sec());
+    }
+
+    // kind of the transfer of the streaming slot (only full images sample the link for the capture budget)
+    CaptureTransferKind transfer_kind(int num_observations) {
+    	if (num_observations == 0 || this->m_slot->failed) {
+    		return CAPTURE_TRANSFER_END;
+    	}
+    	return this->m_slot->preview ? CAPTURE_TRANSFER_PREVIEW : CAPTURE_TRANSFER_IMAGE;
+    }
+
+    // send the "image ready" observation (BLOCKWISE mode)
+    void send_image_ready_observation() {
+    	char buf[IMAGE_READY_LEN+1];
+    	memset(buf,0,IMAGE_READY_LEN+1);
+    	snprintf(buf,IMAGE_READY_LEN,"{\"ready\":%d,\"length\":%d,\"res\":\"%s\",\"event\":%d}",(this->encodedLength() > 0) ? 1 : 0,this->encodedLength(),__camera_resolutions[this->m_slot->resolution].name,this->m_slot->event);
+    	this->logger()->log("CameraResource: Sending image ready observation: %s",buf);
+    	this->set_chunk(buf,strlen(buf));
+    	this->m_chunk_index = -1;
+    	this->observe_bulk();
+
+    	// subsequent GETs return the image itself (from the slot... retained once we release it)
+    	this->m_ready_image_id = (this->encodedLength() > 0) ? (int)this->m_slot->image_id : -1;
+    }
+
+    // encode retained image "image_id" for a blockwise GET (BLOCKWISE mode... mbed-client thread)
+    string encode_image(int image_id) {
+    	string image;
+    	char block[BLOCKWISE_ENCODE_LEN];
+
+    	// the camera cannot reclaim the slot while we hold the slot lock... the streamer never writes a captured slot
+    	this->m_slot_mutex.lock();
+    	camera_slot_t *slot = NULL;
+    	for(int i=0;i<CAMERA_CAPTURE_SLOTS && slot == NULL;++i) {
+    		camera_slot_t *candidate = &this->m_slots[i];
+    		if ((candidate->state == CAMERA_SLOT_RETAINED || candidate->state == CAMERA_SLOT_STREAMING) && candidate->complete && candidate->image_id == (uint16_t)image_id) {
+    			slot = candidate;
+    		}
+    	}
+    	if (slot == NULL) {
+    		this->m_slot_mutex.unlock();
+    		this->logger()->log("CameraResource: blockwise GET: image %d is no longer retained",image_id);
+    		return image;
+    	}
+
+    	// encode straight from the slot with our own encoder (never the streaming chunk)... mbed-client holds the result for the Block2 exchange
+    	image.reserve(this->encodedLength(slot));
+    	if (DO_BASE64_ENCODE_IMAGE) {
+    		this->m_block_base64.reset();
+    		uint32_t offset = 0;
+    		while (offset < slot->encode_length) {
+    			int consumed = 0;
+    			int written = this->m_block_base64.encode(slot->buffer + offset,slot->encode_length - offset,block,BLOCKWISE_ENCODE_LEN,&consumed);
+    			image.append(block,written);
+    			offset += consumed;
+    		}
+    		int written = this->m_block_base64.finish(block,BLOCKWISE_ENCODE_LEN);
+    		image.append(block,written);
+    	}
+    	else {
+    		image.append((const char *)slot->buffer,slot->encode_length);
+    	}
+    	this->m_slot_mutex.unlock();
+
+    	// DEBUG
+    	this->logger()->log("CameraResource: blockwise GET: image %d: %d bytes (%d byte blocks)",image_id,image.size(),SN_COAP_MAX_BLOCKWISE_PAYLOAD_SIZE);
+    	return image;
+    }
+
+    // clear the current chunk
+    void clear_chunk() {
+    	memset(this->m_chunk,0,MAX_MESSAGE_SIZE+1);
+    	this->m_chunk_length = 0;
+    	this->m_chunk_index = -1;
+    }
+
+    // set the current chunk contents
+    void set_chunk(const char *data,int length) {
+    	if (length > MAX_MESSAGE_SIZE) {
+    		length = MAX_MESSAGE_SIZE;
+    	}
+    	memcpy(this->m_chunk,data,length);
+    	this->m_chunk[length] = '\0';
+    	this->m_chunk_length = length;
+    }
+
+    // length of the encoded image (base64 grows every 3 bytes into 4 characters)
+    int encodedLength() {
+    	if (this->m_slot == NULL) {
+    		return 0;
+    	}
+    	return this->encodedLength(this->m_slot);
+    }
+
+    // length of a slot's encoded image
+    int encodedLength(camera_slot_t *slot) {
+    	if (DO_BASE64_ENCODE_IMAGE) {
+    		return (int)(((slot->encode_length + 2) / 3) * 4);
+    	}
+    	return (int)slot->encode_length;
+    }
+
+    // number of chunks in the encoded image
+    int chunkCount(int preferred_msg_length) {
+    	return (this->encodedLength() + preferred_msg_length - 1) / preferred_msg_length;
+    }
+
+    // PIPELINE: wait until chunk "index" can be encoded (its bytes have landed or the capture is complete)... false past the last chunk
+    bool wait_for_chunk(int index,int preferred_msg_length) {
+    	// raw bytes covering the chunk (whole base64 groups... no padding until the capture is complete)
+    	uint32_t needed = (index + 1) * preferred_msg_length;
+    	if (DO_BASE64_ENCODE_IMAGE) {
+    		needed = ((needed + 3) / 4) * 3;
+    	}
+    	while (true) {
+    		if (this->m_slot->complete) {
+    			return index < this->chunkCount(preferred_msg_length);
+    		}
+    		if (this->m_slot->fill >= needed) {
+    			return true;
+    		}
+    		this->m_slot_filled.wait(CAMERA_FILL_WAIT_MS);
+    	}
+    }
+
+    // wait until the streaming slot's capture is complete
+    void wait_for_capture() {
+    	while (this->m_slot->complete == false) {
+    		this->m_slot_filled.wait(CAMERA_FILL_WAIT_MS);
+    	}
+    }
+
+    // camera worker: publish how much of the slot the streamer may encode
+    void publish_fill(camera_slot_t *slot,uint32_t fill) {
+    	// OPTION: a clipped image is only known once complete... hold back anything that may be clipped
+    	if (DO_CLIP_MESSAGE && fill > (MAX_MESSAGE_SIZE - CLIP_LENGTH)) {
+    		fill = MAX_MESSAGE_SIZE - CLIP_LENGTH;
+    	}
+    	slot->fill = fill;
+    	this->m_slot_filled.release();
     }
 
-    // calculate the number of observations needed
-    int calculateNumberOfObservations(int preferred_msg_length) {
-    	// split the string into a vector<string> array
-    	this->m_image_list = this->split_string(this->m_image,preferred_msg_length);
+    // encode the ith chunk directly from the streaming slot and set it as current
+    void setCurrentObservation(int index,int preferred_msg_length) {
+    	int begin = index * preferred_msg_length;
+    	int end = begin + preferred_msg_length;
+    	if (this->m_slot->complete && end > this->encodedLength()) {
+    		end = this->encodedLength();
+    	}
 
-    	// get the array length
-    	int count = this->m_image_list.size();
+    	// encode the chunk into our scratch buffer
+    	this->encode_chunk(begin,end);
+    	this->m_chunk_index = index;
+
+    	// OPTION: prefix the chunk header
+    	if (DO_CHUNK_HEADERS) {
+    		this->add_chunk_header(index,this->chunkCount(preferred_msg_length));
+    	}
 
     	// DEBUG
-    	this->logger()->log("CameraResource: Number of observations to send (including END obs): %d",count+1);
+    	this->log_chunk("CoAP observation");
+    }
 
-    	// return the array length
-    	return count;
+    // prefix the current chunk with its header (image id, index, total, CRC32 of the chunk payload)
+    void add_chunk_header(int index,int total) {
+    	char header[CHUNK_HEADER_MAX_LEN+1];
+    	int header_length = 0;
+    	uint32_t crc = crc32(0L,Z_NULL,0);
+    	crc = crc32(crc,(const Bytef *)this->m_chunk,this->m_chunk_length);
+    	memset(header,0,CHUNK_HEADER_MAX_LEN+1);
+    	if (DO_BASE64_ENCODE_IMAGE) {
+    		// text header
+    		header_length = snprintf(header,CHUNK_HEADER_MAX_LEN,"%d:%d/%d:%08lx:",(int)this->m_slot->image_id,index,total,(unsigned long)crc);
+    	}
+    	else {
+    		// binary header (big endian)
+    		header[0] = (char)(this->m_slot->image_id >> 8); header[1] = (char)(this->m_slot->image_id & 0xFF);
+    		header[2] = (char)(index >> 8);            header[3] = (char)(index & 0xFF);
+    		header[4] = (char)(total >> 8);            header[5] = (char)(total & 0xFF);
+    		header[6] = 0;                             header[7] = 0;
+    		header[8] = (char)(crc >> 24); header[9] = (char)(crc >> 16); header[10] = (char)(crc >> 8); header[11] = (char)(crc & 0xFF);
+    		header_length = BINARY_CHUNK_HEADER_LEN;
+    	}
+
+    	// shift the payload up and drop the header in front of it
+    	if (header_length > 0 && this->m_chunk_length + header_length <= MAX_MESSAGE_SIZE) {
+    		memmove(this->m_chunk + header_length,this->m_chunk,this->m_chunk_length);
+    		memcpy(this->m_chunk,header,header_length);
+    		this->m_chunk_length += header_length;
+    		this->m_chunk[this->m_chunk_length] = '\0';
+    	}
     }
 
-    // split our string into a vector<string> each with a specific length
-    vector<string> split_string(string str,int length) {
-    	vector<string> strings;
-    	for (int i=0;i<(int)str.length();i+=(int)length) {
-    		strings.push_back(str.substr(i,length));
+    // DEBUG: log the current chunk (text thumbnail or hex dump for binary chunks)
+    void log_chunk(const char *what) {
+    	if (this->m_chunk_index < 0) {
+    		// END/ready/empty values are always text
+    		this->logger()->log("CameraResource: %s: (%d bytes): %.*s",what,this->m_chunk_length,this->m_chunk_length,this->m_chunk);
+    	}
+    	else if (DO_BASE64_ENCODE_IMAGE && this->m_chunk_length > THUMBNAIL_LEN) {
+    		int last = this->m_chunk_length - THUMBNAIL_LEN;
+    		this->logger()->log("CameraResource: %s %d: (%d bytes) begin: %.*s end: %.*s...",what,this->m_chunk_index+1,this->m_chunk_length,THUMBNAIL_LEN,this->m_chunk,THUMBNAIL_LEN,this->m_chunk + last);
+    	}
+    	else if (this->m_chunk_length >= BINARY_THUMBNAIL_LEN) {
+    		char hex[(2*BINARY_THUMBNAIL_LEN)+1];
+    		for(int i=0;i<BINARY_THUMBNAIL_LEN;++i) {
+    			sprintf(hex + (2*i),"%02x",(uint8_t)this->m_chunk[i]);
+    		}
+    		this->logger()->log("CameraResource: %s %d: (%d bytes) opaque begin: %s...",what,this->m_chunk_index+1,this->m_chunk_length,hex);
     	}
-    	return strings;
     }
 
-    // set the ith observation as current
-    void setCurrentObservation(int index) {
-    	this->m_image_list_index = index;
+    // encode the [begin,end) range of the encoded image into the chunk buffer
+    void encode_chunk(int begin,int end) {
+    	this->clear_chunk();
+    	if (end <= begin) {
+    		return;
+    	}
+
+    	// OPTION: Base64 Encode
+    	if (DO_BASE64_ENCODE_IMAGE) {
+    		// encode just the 3 byte groups that cover this chunk... straight into the chunk buffer (only what has landed while the capture is in progress)
+    		uint32_t length = this->m_slot->complete ? this->m_slot->encode_length : this->m_slot->fill;
+    		this->m_chunk_length = this->m_base64.encode_range(this->m_slot->buffer,length,begin,end,this->m_chunk);
+    		this->m_chunk[this->m_chunk_length] = '\0';
+    		if (this->m_chunk_length != (end - begin)) {
+    			this->logger()->log("CameraResource: ERROR Base64 chunk encode short: %d < %d",this->m_chunk_length,end - begin);
+    		}
+    	}
+    	else {
+    		// binary: the chunk is an explicit length slice of the capture (opaque content... NULs are fine)
+    		this->set_chunk((const char *)(this->m_slot->buffer + begin),end - begin);
+    	}
+    }
+
+    // start the camera worker and streamer (once)
+    void start_worker() {
+    	this->m_capture_mutex.lock();
+    	this->start_worker_locked();
+    	this->m_capture_mutex.unlock();
+    }
+
+    // start the camera worker and streamer (once... capture mutex held)
+    void start_worker_locked() {
+    	if (this->m_worker_started == false) {
+    		this->logger()->log("CameraResource: Starting camera worker and streamer threads...");
+    		this->m_worker.start(callback(_camera_worker,(const void *)NULL));
+    		this->m_streamer.start(callback(_camera_streamer,(const void *)NULL));
+    		this->m_worker_started = true;
+    	}
+    }
+
+    // process a command queue forever
+    void run_commands(CameraCommandQueue &commands) {
+    	camera_command_t command;
+    	while (true) {
+    		if (commands.get(&command)) {
+    			this->dispatch_command(command);
+    		}
+    	}
+    }
+
+    // queue a command (captures to the camera worker, everything else to the streamer)
+    bool queue_command(CameraCommands cmd,int arg = 0,int img = 0,const uint16_t *chunks = NULL,int num_chunks = 0) {
+    	bool camera_command = (cmd == CAMERA_CMD_CAPTURE || cmd == CAMERA_CMD_POWER_UP || cmd == CAMERA_CMD_POWER_DOWN);
+    	CameraCommandQueue &commands = camera_command ? this->m_commands : this->m_stream_commands;
+    	if (commands.put(cmd,arg,img,chunks,num_chunks)) {
+    		return true;
+    	}
+    	this->logger()->log("CameraResource: camera command queue full (cmd: %d)",(int)cmd);
+    	return false;
+    }
+
+    // queue a capture (coalesced with any capture that is still pending... the latest stall event wins)
+    void queue_capture(int event = 0) {
+    	this->m_capture_mutex.lock();
+    	this->queue_capture_locked(event);
+    	this->m_capture_mutex.unlock();
+    }
+
+    // queue (or coalesce) a capture (capture mutex held)
+    void queue_capture_locked(int event) {
+    	if (event > 0) {
+    		this->m_capture_event = event;
+    	}
+    	if (this->m_capture_pending == true) {
+    		// coalesce: the pending capture has not started yet... it will satisfy this POST too
+    		++this->m_coalesced_captures;
+    		this->logger()->log("CameraResource: capture already pending... coalesced (total coalesced: %d)",this->m_coalesced_captures);
+    	}
+    	else if (this->queue_command(CAMERA_CMD_CAPTURE,this->m_clock.read_ms())) {
+    		this->m_capture_pending = true;
+    		this->logger()->log("CameraResource: capture queued...");
+    	}
+    }
+
+    // dispatch a camera command (CAPTURE on the camera worker, the rest on the streamer)
+    void dispatch_command(const camera_command_t &command) {
+    	int arg = command.arg;
+    	int img = command.img;
+    	switch (command.cmd) {
+    		case CAMERA_CMD_CAPTURE: {
+    			// POSTs from here on need a fresh capture
+    			this->m_capture_mutex.lock();
+    			this->m_capture_pending = false;
+    			this->m_current_event = this->m_capture_event;
+    			this->m_capture_event = 0;
+    			this->m_capture_mutex.unlock();
+
+    			// OPTION: progressive... the preview streams while the full picture is captured into the other slot
+    			this->m_capture_requested_ms = arg;
+    			if (DO_PROGRESSIVE_PREVIEW) {
+    				this->capture_and_stream(true);
+    			}
+    			this->capture_and_stream(false);
+
+    			// POWER: an on-demand capture of an EMPTY stall does not leave the camera on
+    			this->power_down_if_unwanted();
+    			break;
+    		}
+    		case CAMERA_CMD_POWER_UP:
+    			this->set_power(true);
+    			break;
+    		case CAMERA_CMD_POWER_DOWN:
+    			this->set_power(false);
+    			break;
+    		case CAMERA_CMD_STREAM:
+    			this->process_observations(img);
+    			break;
+    		case CAMERA_CMD_RESEND:
+    			this->resend_observations(img,command.chunks,command.num_chunks);
+    			break;
+    		case CAMERA_CMD_SELECT:
+    			this->select_chunk(img,arg);
+    			break;
+    		case CAMERA_CMD_HISTORY:
+    			this->select_history();
+    			break;
+    		default:
+    			this->logger()->log("CameraResource: unknown camera command: %d",(int)command.cmd);
+    			break;
+    	}
+    }
+
+    // make chunk "index" of retained image "image_id" the GET value
+    void select_chunk(int image_id,int index) {
+    	if (this->checkout_slot(image_id,CAMERA_SLOT_RETAINED) == NULL) {
+    		this->logger()->log("CameraResource: select: image %d is no longer retained... ignoring (OK).",image_id);
+    		return;
+    	}
+    	if (index >= 0 && index < this->chunkCount(this->m_slot->chunk_length)) {
+    		this->setCurrentObservation(index,this->m_slot->chunk_length);
+    	}
+    	else {
+    		this->logger()->log("CameraResource: select: chunk %d out of range",index);
+    	}
+    	this->release_slot(this->m_slot);
+    }
+
+    // make the list of retained images the GET value (id, capture time, resolution and chunk count of each)
+    void select_history() {
+    	char entry[CAMERA_HISTORY_ENTRY_LEN+1];
+    	int num_images = 0;
+    	this->clear_chunk();
+    	this->m_chunk_length = snprintf(this->m_chunk,MAX_MESSAGE_SIZE,"{\"history\":[");
+    	this->m_slot_mutex.lock();
+    	for(int i=0;i<CAMERA_CAPTURE_SLOTS;++i) {
+    		camera_slot_t *slot = &this->m_slots[i];
+    		if (slot->state == CAMERA_SLOT_RETAINED && slot->complete) {
+    			int chunks = (this->encodedLength(slot) + slot->chunk_length - 1) / slot->chunk_length;
+    			int length = snprintf(entry,CAMERA_HISTORY_ENTRY_LEN,"%s{\"img\":%d,\"ts\":%ld,\"res\":\"%s\",\"chunks\":%d,\"event\":%d}",(num_images > 0) ? "," : "",
+    					(int)slot->image_id,(long)slot->timestamp,__camera_resolutions[slot->resolution].name,chunks,slot->event);
+    			if (this->m_chunk_length + length + 2 <= MAX_MESSAGE_SIZE) {
+    				memcpy(this->m_chunk + this->m_chunk_length,entry,length);
+    				this->m_chunk_length += length;
+    				++num_images;
+    			}
+    		}
+    	}
+    	this->m_slot_mutex.unlock();
+    	memcpy(this->m_chunk + this->m_chunk_length,"]}",2);
+    	this->m_chunk_length += 2;
+    	this->m_chunk[this->m_chunk_length] = '\0';
 
     	// DEBUG
-		int last = this->m_image_list[this->m_image_list_index].size() - THUMBNAIL_LEN;
-		this->logger()->log("CameraResource: %dth CoAP observation (%d bytes) begin: %s end: %s...",this->m_image_list_index+1,this->m_image_list[this->m_image_list_index].size(),this->m_image_list[this->m_image_list_index].substr(0,THUMBNAIL_LEN).c_str(),this->m_image_list[this->m_image_list_index].substr(last,THUMBNAIL_LEN).c_str());
+    	this->logger()->log("CameraResource: history: %d retained images",num_images);
+    }
+
+    // index of the streamed (or streaming) slot holding image "image_id" (-1 if not retained)
+    int find_slot(int image_id) {
+    	int index = -1;
+    	this->m_slot_mutex.lock();
+    	for(int i=0;i<CAMERA_CAPTURE_SLOTS && index < 0;++i) {
+    		if ((this->m_slots[i].state == CAMERA_SLOT_RETAINED || this->m_slots[i].state == CAMERA_SLOT_STREAMING) && this->m_slots[i].image_id == (uint16_t)image_id) {
+    			index = i;
+    		}
+    	}
+    	this->m_slot_mutex.unlock();
+    	return index;
+    }
+
+    // streamer: take the slot holding image "image_id" (in the expected state) as the streaming slot
+    camera_slot_t *checkout_slot(int image_id,CameraSlotStates expected) {
+    	camera_slot_t *slot = NULL;
+    	this->m_slot_mutex.lock();
+    	for(int i=0;i<CAMERA_CAPTURE_SLOTS && slot == NULL;++i) {
+    		if (this->m_slots[i].state == expected && this->m_slots[i].image_id == (uint16_t)image_id) {
+    			slot = &this->m_slots[i];
+    			slot->state = CAMERA_SLOT_STREAMING;
+    			this->m_slot = slot;
+    		}
+    	}
+    	this->m_slot_mutex.unlock();
+    	return slot;
+    }
+
+    // retain a slot (until the camera needs it again) and wake a capture waiting for one
+    void release_slot(camera_slot_t *slot) {
+    	this->m_slot_mutex.lock();
+    	slot->state = CAMERA_SLOT_RETAINED;
+    	this->m_slot_mutex.unlock();
+    	this->m_slot_released.release();
+    }
+
+    // camera worker: claim a slot to capture into (unused first, then the oldest retained... waits while every slot is busy)
+    camera_slot_t *acquire_capture_slot() {
+    	while (true) {
+    		camera_slot_t *slot = NULL;
+    		this->m_slot_mutex.lock();
+    		for(int i=0;i<CAMERA_CAPTURE_SLOTS;++i) {
+    			camera_slot_t *candidate = &this->m_slots[i];
+    			if (candidate->state == CAMERA_SLOT_FREE) {
+    				slot = candidate;
+    				break;
+    			}
+    			if (candidate->state == CAMERA_SLOT_RETAINED && (slot == NULL || (uint16_t)(this->m_image_id - candidate->image_id) > (uint16_t)(this->m_image_id - slot->image_id))) {
+    				slot = candidate;
+    			}
+    		}
+    		if (slot != NULL) {
+    			// a blockwise GET must not read the picture we are about to overwrite
+    			if ((int)slot->image_id == this->m_ready_image_id) {
+    				this->m_ready_image_id = -1;
+    			}
+    			slot->state = CAMERA_SLOT_CAPTURING;
+    		}
+    		this->m_slot_mutex.unlock();
+    		if (slot != NULL) {
+    			return slot;
+    		}
+
+    		// every slot is captured or streaming... wait for the streamer to release one
+    		this->logger()->log("CameraResource: all capture slots busy... waiting for the streamer");
+    		this->m_slot_released.wait();
+    	}
+    }
+
+    // camera worker: capture into a free slot (overlaps any stream in progress) and hand it to the streamer
+    void capture_and_stream(bool preview) {
+    	camera_slot_t *slot = NULL;
+    	bool streaming = false;
+    	if (PIPELINE_CAMERA_READ) {
+    		// PIPELINE: the streamer starts on the slot while we are still reading the camera
+    		slot = this->begin_capture(preview);
+    		streaming = this->queue_stream(slot);
+    		this->transfer_picture(slot);
+    		this->end_capture(slot);
+    	}
+    	else {
+    		slot = this->capture(preview);
+    		streaming = this->queue_stream(slot);
+    	}
+    	if (streaming == false) {
+    		// cannot stream it... retain it so resend can still reach it
+    		this->release_slot(slot);
+    	}
+    }
+
+    // hand a captured slot to the streamer (the streamer drains its queue... retry a full queue for a bounded time)
+    bool queue_stream(camera_slot_t *slot) {
+    	int waited_ms = 0;
+    	while (this->queue_command(CAMERA_CMD_STREAM,0,slot->image_id) == false) {
+    		if (waited_ms >= CAMERA_STREAM_ENQUEUE_MS) {
+    			++this->m_stream_enqueue_failures;
+    			this->logger()->log("CameraResource: ERROR: image %d not streamed... streamer queue full for %d ms (retained for resend, failures: %d)",
+    					(int)slot->image_id,waited_ms,this->m_stream_enqueue_failures);
+    			return false;
+    		}
+    		Thread::wait(CAMERA_FILL_WAIT_MS);
+    		waited_ms += CAMERA_FILL_WAIT_MS;
+    	}
+    	return true;
+    }
+
+    // take a picture into a free slot (its own image id) and read it in
+    camera_slot_t *capture(bool preview) {
+    	camera_slot_t *slot = this->begin_capture(preview);
+    	this->transfer_picture(slot);
+    	this->end_capture(slot);
+    	return slot;
+    }
+
+    // take a picture into a free slot... the slot is ready to stream (it fills as transfer_picture() reads the camera)
+    camera_slot_t *begin_capture(bool preview) {
+    	camera_slot_t *slot = this->acquire_capture_slot();
+
+    	// take a picture (new image id... a preview starts at the smallest resolution)
+    	slot->image_id = ++this->m_image_id;
+    	slot->capture_ms = this->m_clock.read_ms();
+    	slot->timestamp = time(NULL);
+    	slot->preview = preview;
+    	slot->event = this->m_current_event;
+    	slot->chunk_length = preview ? PREVIEW_MESSAGE_LEN : PREFERRED_MESSAGE_LEN;
+    	this->logger()->log("CameraResource: Taking a %s picture (image %d, slot %d)...",preview ? "preview" : "full",(int)slot->image_id,(int)(slot - this->m_slots));
+    	bool cold = (this->m_powered == false);
+    	if (cold) {
+    		// POWER: cold path... the sensor powers up (sync and exposure settle) inside this capture
+    		this->set_power(true);
+    	}
+    	uint32_t buffer_size = this->take_picture(slot,preview ? NUM_CAMERA_RESOLUTIONS - 1 : this->m_preferred_resolution);
+    	this->record_capture_latency(cold);
+
+    	// clear the slot... gzipped length is unknown until the capture completes
+    	memset(slot->buffer,0,CAMERA_SLOT_BUFFER_SIZE+1);
+    	slot->picture_length = buffer_size;
+    	slot->length = 0;
+    	slot->fill = 0;
+    	slot->complete = false;
+    	slot->failed = false;
+    	this->m_fingerprinter.begin(&slot->fingerprint);
+    	slot->encode_length = DO_GZIP_IMAGE ? 0 : this->clip_length(buffer_size);
+
+    	// ready to stream
+    	this->m_slot_mutex.lock();
+    	slot->state = CAMERA_SLOT_READY;
+    	this->m_slot_mutex.unlock();
+    	return slot;
+    }
+
+    // the picture has been read in... finalize its length and release the streamer
+    void end_capture(camera_slot_t *slot) {
+    	// size the encoded image
+    	this->logger()->log("CameraResource: sizing encoded picture...");
+    	this->size_encoded_image(slot);
+    	slot->complete = true;
+    	this->m_slot_filled.release();
+
+    	// DEBUG
+    	this->logger()->log("CameraResource: image %d (%s) captured in %d ms",(int)slot->image_id,__camera_resolutions[slot->resolution].name,this->m_clock.read_ms() - slot->capture_ms);
     }
 
     // reset any observation state
     void resetObservationState() {
-    	// kill any previous observe thread
-		if (this->m_observer != NULL) {
-			delete this->m_observer;
-		}
-		this->m_observer = NULL;
-		this->m_image_list.empty();
-		this->m_image = "";
-		this->m_image_list_index = -1;
+		this->clear_chunk();
     }
 
-    // take a picture
-    void take_picture() {         
-        // take a picture
-        __camera.take_picture();
-        
-        // transfer the picture
-        this->transfer_picture();
+    // take a picture that fits, starting at "resolution" (returns its size... 0 if even the smallest resolution will not fit the buffer)
+    uint32_t take_picture(camera_slot_t *slot,int resolution) {         
+        uint32_t budget = this->m_budget.budget();
+        while (true) {
+            // take a picture
+            __camera.set_resolution(__camera_resolutions[resolution].resolution);
+            __camera.take_picture();
+            slot->resolution = resolution;
+            
+            // get the buffer size - never clip... a truncated JPEG cannot be decoded
+            uint32_t buffer_size = __camera.get_picture_size();
+            // GZIP: reserve the worst case framing up front... the stream must never overflow once chunks are going out
+            uint32_t stored_size = this->stored_length(buffer_size);
+            bool last = (resolution == NUM_CAMERA_RESOLUTIONS - 1);
+            if (this->m_budget.fits(buffer_size,stored_size,last)) {
+                // DEBUG
+                this->logger()->log("CameraResource: picture: %d bytes at %s (budget: %d bytes, retakes: %d)",buffer_size,__camera_resolutions[resolution].name,budget,this->m_retakes);
+                return buffer_size;
+            }
+            if (last) {
+                // ERROR
+                this->logger()->log("CameraResource: ERROR picture: %d bytes (%d stored) at %s does not fit the %d byte buffer... not sending it",buffer_size,stored_size,__camera_resolutions[resolution].name,CAMERA_SLOT_BUFFER_SIZE);
+                return 0;
+            }
+
+            // retake one step down
+            this->logger()->log("CameraResource: picture: %d bytes at %s over budget (%d bytes)... retaking at %s",buffer_size,__camera_resolutions[resolution].name,budget,__camera_resolutions[resolution+1].name);
+            ++resolution;
+            ++this->m_retakes;
+        }
+    }
+
+    // bytes a picture can occupy in the slot: the worst case gzip stream if compressing (the link budget is checked against the picture itself)
+    uint32_t stored_length(uint32_t picture_length) {
+#if DO_GZIP_IMAGE
+        return GzipStreamCompressor::bound(picture_length);
+#else
+        return picture_length;
+#endif
+    }
+
+    // index of a resolution by name (-1 if unsupported)
+    int find_resolution(const char *name) {
+        for(int i=0;i<NUM_CAMERA_RESOLUTIONS;++i) {
+            if (strcmp(name,__camera_resolutions[i].name) == 0) {
+                return i;
+            }
+        }
+        return -1;
     }
     
+    // POWER: power the camera up or down (camera worker... powerup() syncs with the sensor and can take a while)
+    void set_power(bool on) {
+    	if (on == this->m_powered) {
+    		return;
+    	}
+
+    	// account for the time spent in the state we are leaving
+    	int now = this->m_clock.read_ms();
+    	if (this->m_powered) {
+    		this->m_power_on_ms += now - this->m_power_changed_ms;
+    	}
+    	else {
+    		this->m_power_off_ms += now - this->m_power_changed_ms;
+    	}
+    	this->m_power_changed_ms = now;
+
+    	// switch
+    	if (on) {
+    		this->init_camera();
+    	}
+    	else {
+    		__camera.powerdown();
+    	}
+    	this->m_powered = on;
+
+    	// DEBUG
+    	this->logger()->log("CameraResource: camera powered %s in %d ms (total on: %d s off: %d s)",on ? "UP" : "DOWN",this->m_clock.read_ms() - now,this->m_power_on_ms/1000,this->m_power_off_ms/1000);
+    }
+
+    // POWER: power down after an on-demand capture if the stall does not want the camera on
+    void power_down_if_unwanted() {
+    	this->m_capture_mutex.lock();
+    	bool wanted = this->m_power_wanted;
+    	this->m_capture_mutex.unlock();
+    	if (DO_CAMERA_POWER_MANAGEMENT && wanted == false) {
+    		this->set_power(false);
+    	}
+    }
+
+    // POWER: capture latency (request to picture taken) for the warm and cold paths
+    void record_capture_latency(bool cold) {
+    	if (this->m_capture_requested_ms < 0) {
+    		// only the first picture of a request (not the full picture after a preview)
+    		return;
+    	}
+    	int path = cold ? 1 : 0;
+    	int latency_ms = this->m_clock.read_ms() - this->m_capture_requested_ms;
+    	this->m_capture_requested_ms = -1;
+    	this->m_capture_latency_ms[path] += latency_ms;
+    	++this->m_num_captures[path];
+
+    	// DEBUG
+    	this->logger()->log("CameraResource: capture latency: %d ms (%s) average warm: %d ms (%d) cold: %d ms (%d)",latency_ms,cold ? "cold" : "warm",
+    			(this->m_num_captures[0] > 0) ? this->m_capture_latency_ms[0]/this->m_num_captures[0] : 0,this->m_num_captures[0],
+    			(this->m_num_captures[1] > 0) ? this->m_capture_latency_ms[1]/this->m_num_captures[1] : 0,this->m_num_captures[1]);
+    }
+
     // initialize the camera
     void init_camera() {
         // initialize the camera
         __camera.powerup();
         
-        // set the resolution
-        __camera.set_resolution(CameraOV528::RES_160x120);
+        // set the (preferred) resolution
+        __camera.set_resolution(__camera_resolutions[this->m_preferred_resolution].resolution);
         
         // set the format
         __camera.set_format(CameraOV528::FMT_JPEG);
     }
     
-    // transfer the camera picture
-    void transfer_picture() {
-        // clear the buffer
-        memset(this->m_camera_buffer,0,MAX_CAMERA_BUFFER_SIZE+1);
-        this->m_camera_buffer_length = 0;
-
-		// clear our tmp buffer
-		memset(tmp_buffer,0,MAX_CAMERA_BUFFER_SIZE+1);
-        
-        // get the buffer size - clip to the maximum buffer size available...
-        uint32_t buffer_size = __camera.get_picture_size();
-        if (buffer_size > MAX_CAMERA_BUFFER_SIZE) {
-            buffer_size = MAX_CAMERA_BUFFER_SIZE;
-        }
+    // transfer the camera picture into a slot (block by block... each block is published to the streamer as it lands)
+    void transfer_picture(camera_slot_t *slot) {
+        uint32_t buffer_size = slot->picture_length;
         
         // read in the picture...
         if (buffer_size > 0) {
-            // read in the image
-            int tmp_buffer_length = __camera.read_picture_data(tmp_buffer,buffer_size);
-
-			// DEBUG
-			this->logger()->log("CameraResource: RAW jpeg camera buffer size: %d (ret: %d)",buffer_size,tmp_buffer_length);
-
 			// DEBUG
 			char *image_type = (char *)"JPEG";
 
-			// check if we want to gzip up the jpeg...
-			if (DO_GZIP_IMAGE) {
-				// gzip the image
-				image_type = (char *)"GZIP_JPEG";
-				unsigned long gzip_length = MAX_CAMERA_BUFFER_SIZE;
-				int gzip_status = gzip((unsigned char *)this->m_camera_buffer,&gzip_length,(unsigned char *)tmp_buffer,(unsigned long)tmp_buffer_length);
-				if (gzip_status == Z_OK) {
-					// update to the gzipped length
-					this->m_camera_buffer_length = (uint32_t)gzip_length;
+#if DO_GZIP_IMAGE
+			// read the image in blocks... each block is compressed as soon as it is read
+			image_type = (char *)"GZIP_JPEG";
+			uint32_t raw_length = 0;
+			if (__gzip.begin(slot->buffer,CAMERA_SLOT_BUFFER_SIZE) == false) {
+				// nothing has been published yet... fall back to the uncompressed picture
+				this->logger()->log("CameraResource: ERROR GZIP unavailable... sending the picture uncompressed");
+				this->read_picture(slot,buffer_size);
+				this->logger()->log("CameraResource: JPEG camera buffer size: %d",slot->length);
+				return;
+			}
+			bool gzip_ok = true;
+			while (gzip_ok && raw_length < buffer_size) {
+				uint32_t block_length = buffer_size - raw_length;
+				if (block_length > CAMERA_READ_BLOCK_SIZE) {
+					block_length = CAMERA_READ_BLOCK_SIZE;
 				}
-				else {
-					// ERROR
-					this->m_camera_buffer_length = 0;
-					memset(this->m_camera_buffer,0,MAX_CAMERA_BUFFER_SIZE+1);
-					this->logger()->log("CameraResource: ERROR GZIP failed: %d",gzip_status);
+				uint32_t read_length = __camera.read_picture_data(__camera_read_block,block_length);
+				if (read_length == 0) {
+					break;
 				}
+				raw_length += read_length;
+				this->m_fingerprinter.update(__camera_read_block,read_length);
+				gzip_ok = __gzip.compress(__camera_read_block,read_length);
+				this->publish_fill(slot,__gzip.length());
+			}
+			gzip_ok = __gzip.finish() && gzip_ok;
+
+			// DEBUG
+			this->logger()->log("CameraResource: RAW jpeg camera buffer size: %d (ret: %d)",buffer_size,raw_length);
+
+			if (gzip_ok) {
+				// update to the gzipped length
+				slot->length = __gzip.length();
+				this->logger()->log("CameraResource: GZIP level: %d ratio: %d%% workspace peak: %d bytes",__gzip.level(),(raw_length > 0) ? (int)((100 * slot->length) / raw_length) : 0,__gzip.peak_memory());
 			}
 			else {
-				// do not gzip the image
-				this->m_camera_buffer_length = tmp_buffer_length;
-				memcpy(this->m_camera_buffer,tmp_buffer,tmp_buffer_length);
+				// ERROR: chunks may already be out (the stored length was reserved... this should not happen): stop the stream and fail the image in its END
+				slot->length = 0;
+				slot->failed = true;
+				this->logger()->log("CameraResource: ERROR GZIP failed (image %d)... END carries the error",(int)slot->image_id);
 			}
+#else
+            this->read_picture(slot,buffer_size);
+
+			// DEBUG
+			this->logger()->log("CameraResource: RAW jpeg camera buffer size: %d (ret: %d)",buffer_size,slot->length);
+#endif
 
 			// DEBUG
-			this->logger()->log("CameraResource: %s camera buffer size: %d",image_type,this->m_camera_buffer_length);
+			this->logger()->log("CameraResource: %s camera buffer size: %d",image_type,slot->length);
         }
     }
     
-    // encode the image into base64
-    void encode_image() {
-        // make sure that the buffer we have has stuff in it...
-        if (this->m_camera_buffer_length > 0) {
-            // OPTION: ability to clip part of the image...
-            int clip_length = this->m_camera_buffer_length;
-            if (DO_CLIP_MESSAGE && clip_length > MAX_MESSAGE_SIZE) {
-                // Base64 will add some to the length... so trim a bit more back (CLIP_LENGTH bytes)
-                clip_length = MAX_MESSAGE_SIZE - CLIP_LENGTH;
-                
+    // read the picture in blocks straight into the slot (no intermediate copy)
+    void read_picture(camera_slot_t *slot,uint32_t buffer_size) {
+        while (slot->length < buffer_size) {
+        	uint32_t block_length = buffer_size - slot->length;
+        	if (block_length > CAMERA_READ_BLOCK_SIZE) {
+        		block_length = CAMERA_READ_BLOCK_SIZE;
+        	}
+        	uint32_t read_length = __camera.read_picture_data(slot->buffer + slot->length,block_length);
+        	if (read_length == 0) {
+        		break;
+        	}
+        	this->m_fingerprinter.update(slot->buffer + slot->length,read_length);
+        	slot->length += read_length;
+        	this->publish_fill(slot,slot->length);
+        }
+    }
+
+    // OPTION: ability to clip part of the image...
+    uint32_t clip_length(uint32_t length) {
+        if (DO_CLIP_MESSAGE && length > MAX_MESSAGE_SIZE) {
+            // Base64 will add some to the length... so trim a bit more back (CLIP_LENGTH bytes)
+            return MAX_MESSAGE_SIZE - CLIP_LENGTH;
+        }
+        return length;
+    }
+
+    // size the image we will encode (chunks are encoded on demand from the slot)
+    void size_encoded_image(camera_slot_t *slot) {
+        // make sure that the buffer we have has stuff in it... (the streamer may be reading encode_length: set it once)
+        uint32_t encode_length = this->clip_length(slot->length);
+        slot->encode_length = encode_length;
+        if (slot->length > 0) {
+            if (encode_length < slot->length) {
                 // DEBUG
-                this->logger()->log("CameraResource: Image length: %d too big for CoAP... trimming to: %d bytes...",this->m_camera_buffer_length,clip_length);
+                this->logger()->log("CameraResource: Image length: %d too big for CoAP... trimming to: %d bytes...",slot->length,encode_length);
             }
-            
+
             // OPTION: Base64 Encode
-            if (DO_BASE64_ENCODE_IMAGE) {
-            	size_t buf_length = 0;
-				char *buf = this->m_base64.Encode((const char *)this->m_camera_buffer,clip_length,&buf_length);
-				if (buf != NULL && buf_length > 0) {
-					// copy to string
-					this->m_image = buf;
-
-					// DEBUG
-					int last = this->m_image.size() - THUMBNAIL_LEN;
-					this->logger()->log("CameraResource: Base64 encoded: length: %d begin: %s end: %s",this->m_image.size(),this->m_image.substr(0,THUMBNAIL_LEN).c_str(),this->m_image.substr(last,THUMBNAIL_LEN).c_str());
-
-					// Base64.Encode malloc()'d the buffer... so free() it
-					if (buf != NULL) {
-						free(buf);
-					}
-				}
-            }
-            else {
-            	// raw string copy (may not work given control characters in the binary stream)
-            	this->logger()->log("CameraResource: NOTE: not base64 encoding raw image data... control characters my break things...");
-            	this->m_image = (const char *)this->m_camera_buffer;
-            	this->logger()->log("CameraResource: Raw string length: %d buffer length: %d",this->m_image.size(),this->m_camera_buffer_length);
+            if (!DO_BASE64_ENCODE_IMAGE) {
+            	this->logger()->log("CameraResource: NOTE: sending raw image data as opaque (binary) chunks...");
             }
         }
         else {
         	// image is empty...
             this->logger()->log("CameraResource: empty image");
-            this->m_image = "";
         }
         
         // DEBUG
-        this->logger()->log("CameraResource: Base64 message length: %d",strlen(this->m_image.c_str()));
+        this->logger()->log("CameraResource: %s message length: %d",DO_BASE64_ENCODE_IMAGE ? "Base64" : "Opaque",DO_BASE64_ENCODE_IMAGE ? Base64StreamEncoder::encoded_length(encode_length) : (int)encode_length);
     }
 };
 
-// observation processor
-extern "C" void _process_observations(const void *args) {
+// camera power hooks (occupancy detector)
+extern "C" void camera_warm_up(void) {
+	if (_camera_instance != NULL) {
+		// car ARRIVING... have the sensor ready for the capture
+		((CameraResource *)_camera_instance)->request_power(true);
+	}
+}
+extern "C" void camera_power_down(void) {
+	if (_camera_instance != NULL) {
+		// stall EMPTY... no captures expected
+		((CameraResource *)_camera_instance)->request_power(false);
+	}
+}
+
+// local capture hook (occupancy detector)
+extern "C" void camera_capture(int event) {
+	if (_camera_instance != NULL) {
+		// stall OCCUPIED... capture without waiting for the cloud POST
+		((CameraResource *)_camera_instance)->request_local_capture(event);
+	}
+}
+
+// retry the detector requests (EVENT QUEUE)
+extern "C" void _camera_apply_requests(void) {
+	if (_camera_instance != NULL) {
+		((CameraResource *)_camera_instance)->retry_requests();
+	}
+}
+
+// notification delivery callback
+extern "C" void _camera_notification_sent(void) {
+	if (_camera_instance != NULL) {
+		// credit the pacer
+		((CameraResource *)_camera_instance)->notification_sent();
+	}
+}
+
+// camera worker (THREAD)
+extern "C" void _camera_worker(const void *args) {
+	if (_camera_instance != NULL) {
+		// process capture commands forever
+		((CameraResource *)_camera_instance)->run_worker();
+	}
+}
+
+// camera streamer (THREAD)
+extern "C" void _camera_streamer(const void *args) {
 	if (_camera_instance != NULL) {
-		// process the observations for the camera
-		((CameraResource *)_camera_instance)->process_observations();
+		// process stream commands forever
+		((CameraResource *)_camera_instance)->run_streamer();
 	}
 }
 
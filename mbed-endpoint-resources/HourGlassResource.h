@@ -35,6 +35,17 @@
 // JSON Parser
 #include "MbedJSONValue.h"
 
+// notification scheduler (expiry goes ahead of image data)
+#include "NotificationScheduler.h"
+
+// latest-value-wins notification mailbox
+#include "NotificationMailbox.h"
+
+// TUNE: countdown notification coalescing (ms, seconds of countdown)... every tick is posted, the server sees the newest at most every pmin (0: off)
+#define HOURGLASS_NOTIFY_PMIN_MS	10000
+#define HOURGLASS_NOTIFY_PMAX_MS	0
+#define HOURGLASS_NOTIFY_STEP		0.0
+
 #if ENABLE_V2_RESOURCES
 	// we define "a second" and match it to what the web app should expect
 	#define CLOCK_SECOND    1025
@@ -49,6 +60,9 @@
 // forward declarations
 static void *__instance = NULL;
 extern "C" void _decrementor(const void *args);
+extern "C" void _hourglass_notification_sent(void);
+extern "C" void _hourglass_notification_done(void);
+extern "C" MailboxSendResults _send_hourglass_notification(void);
 
 // hook for turning the beacon on/off
 extern "C" void turn_beacon_off(void);
@@ -77,6 +91,10 @@ class HourGlassResource : public DynamicResource
 private:
     Thread *m_countdown_thread;
     char m_last_timestamp[128];
+    NotificationMailbox m_mailbox;
+    notification_claim_t m_claim;
+    string m_res_name;
+    M2MResource *m_res;
     
 public:
     /**
@@ -86,9 +104,14 @@ public:
     @param res_name input the resource name
     @param observable input the resource is Observable (default: FALSE)
     */
-    HourGlassResource(const Logger *logger,const char *obj_name,const char *res_name,const bool observable = false) : DynamicResource(logger,obj_name,res_name,"HourGlass",M2MBase::GET_PUT_POST_ALLOWED,observable) {
+    HourGlassResource(const Logger *logger,const char *obj_name,const char *res_name,const bool observable = false) : DynamicResource(logger,obj_name,res_name,"HourGlass",M2MBase::GET_PUT_POST_ALLOWED,observable), m_mailbox(_send_hourglass_notification,_hourglass_notification_done) {
         // init
         __instance = (void *)this;
+        this->m_res_name = res_name;
+        this->m_res = NULL;
+        this->m_mailbox.configure(HOURGLASS_NOTIFY_PMIN_MS,HOURGLASS_NOTIFY_PMAX_MS,HOURGLASS_NOTIFY_STEP);
+        this->m_claim.deferred = false;
+        this->m_claim.start_ms = 0;
         
         // set to expired (0)
         __fill_seconds = 0;
@@ -174,8 +197,8 @@ public:
                                 // update the hourglass with a new velue
                                 this->logger()->log("HourGlassResource: put() adding additional seconds: %d  total: %d",fill_seconds,__fill_seconds);
                                 
-                                // observe
-                                //this->observe();
+                                // notify (coalesced with the countdown)
+                                this->notify();
                             }
                             else {
                                 // not updating... value unchanged or invalid
@@ -214,8 +237,8 @@ public:
                                 // initialize...
                                 this->reset();
                                 
-                                // observe
-                                //this->observe();
+                                // notify (coalesced with the countdown)
+                                this->notify();
                             }
                             else {
                                 // current timer already active... so you cannot set it again until the timer expires
@@ -275,6 +298,58 @@ public:
         
     }
     
+    /**
+    Bind the resource... also hooks the notification delivery callback for the mailbox
+    @param p input the endpoint instance
+    @returns M2MObject for the hourglass
+    */
+    virtual M2MObject *bind(void *p) {
+        M2MObject *obj = DynamicResource::bind(p);
+        if (obj != NULL && obj->object_instance() != NULL) {
+            M2MResource *res = obj->object_instance()->resource(this->m_res_name.c_str());
+            if (res != NULL) {
+                res->set_notification_sent_callback(_hourglass_notification_sent);
+                this->m_res = res;
+            }
+        }
+        return obj;
+    }
+
+    // queue a notification of the current countdown value (newest wins while the link is busy... "force": the expiry always goes out)
+    void notify(bool force = false) {
+        this->m_mailbox.post(this->get(),(float)__seconds,force);
+    }
+
+    // send the mailbox value (EVENT QUEUE)... not the live countdown (the expiry "0" must not turn into the next tick). The gate stays ours until notification_done()
+    MailboxSendResults send_notification() {
+        if (notification_scheduler()->try_begin(NOTIFY_EXPIRY,this->m_claim) == false) {
+            // an observation is going out... the mailbox retries (our claim keeps the image chunks behind us)
+            return MAILBOX_BUSY;
+        }
+        string value = this->m_mailbox.value();
+        if (this->m_res != NULL) {
+            this->m_res->set_value((const uint8_t *)value.c_str(),(uint32_t)value.length());
+        }
+        else {
+            // not bound yet... get() is all we have
+            this->observe();
+        }
+        this->logger()->log("HourGlassResource: notified %s (sent: %d coalesced: %d)",value.c_str(),this->m_mailbox.sent(),this->m_mailbox.coalesced());
+        return MAILBOX_SENT;
+    }
+
+    // the last notification was delivered (mbed-client callback)
+    void notification_sent() {
+        this->m_mailbox.delivered();
+    }
+
+    // the notification in flight was delivered or its acknowledgement timed out... release the gate
+    void notification_done() {
+        notification_scheduler()->end(NOTIFY_EXPIRY);
+        this->logger()->log("HourGlassResource: expiry notification latency avg: %d ms max: %d ms",
+                notification_scheduler()->average_latency_ms(NOTIFY_EXPIRY),notification_scheduler()->max_latency_ms(NOTIFY_EXPIRY));
+    }
+
     // reset the countdown... clear the thread, reset the counter...
     void reset() {
         if (this->m_countdown_thread != NULL && __expired == true) {
@@ -398,6 +473,11 @@ void _decrementor(const void *args) {
             __update_fill = false;
             __add_seconds = 0;
         }
+        
+        // post the tick... the mailbox coalesces it (the server sees the newest countdown at most every HOURGLASS_NOTIFY_PMIN_MS)
+        if (me != NULL && __seconds > 0) {
+            me->notify();
+        }
     }
     
     // we are done.. so zero out
@@ -406,7 +486,7 @@ void _decrementor(const void *args) {
     // Expired!  Observe it... you will get a "0" in the observation value... 
     if (me != NULL) {
         update_parking_meter_stats(0,__fill_seconds);
-        me->observe();
+        me->notify(true);
         __expired = true;
         
         // set the LCD
@@ -414,4 +494,26 @@ void _decrementor(const void *args) {
     }
 }
 
+// notification delivered (mbed-client callback)
+void _hourglass_notification_sent(void) {
+    if (__instance != NULL) {
+        ((HourGlassResource *)__instance)->notification_sent();
+    }
+}
+
+// notification delivered or given up on (mailbox)
+void _hourglass_notification_done(void) {
+    if (__instance != NULL) {
+        ((HourGlassResource *)__instance)->notification_done();
+    }
+}
+
+// send the mailbox value (EVENT QUEUE)
+MailboxSendResults _send_hourglass_notification(void) {
+    if (__instance != NULL) {
+        return ((HourGlassResource *)__instance)->send_notification();
+    }
+    return MAILBOX_IDLE;
+}
+
 #endif // __HOUR_GLASS_RESOURCE_H__
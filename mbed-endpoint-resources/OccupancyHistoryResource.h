@@ -0,0 +1,195 @@
+/**
+ * @file    OccupancyHistoryResource.h
+ * @brief   mbed CoAP Endpoint Occupancy History Resource
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __OCCUPANCY_HISTORY_RESOURCE_H__
+#define __OCCUPANCY_HISTORY_RESOURCE_H__
+
+// version info
+#include "version.h"
+
+// Base class
+#include "mbed-connector-interface/DynamicResource.h"
+
+// JSON parser
+#include "MbedJSONValue.h"
+
+// transition history
+#include "OccupancyHistory.h"
+
+// notification scheduler (history goes behind state changes and expiry)
+#include "NotificationScheduler.h"
+
+// latest-value-wins notification mailbox
+#include "NotificationMailbox.h"
+
+// SenML base name of the packs (the occupancy detector... records are named "<stall>/state")
+#define OCCUPANCY_HISTORY_BASE_NAME		"/400/"
+
+// TUNE: at most one pack per window (ms)... transitions meanwhile go out together in the next
+#define OCCUPANCY_HISTORY_BATCH_MS		5000
+
+// TUNE: unacknowledged transitions are packed again after this long (ms)
+#define OCCUPANCY_HISTORY_RESEND_MS		60000
+
+// mailbox marker: "transitions pending"... the pack itself is built by get() when the notification goes out
+#define OCCUPANCY_HISTORY_PENDING		""
+
+// forward declarations
+static void *__history_instance = NULL;
+extern "C" void _occupancy_history_notification_sent(void);
+extern "C" void _occupancy_history_notification_done(void);
+extern "C" MailboxSendResults _send_occupancy_history_notification(void);
+
+/** OccupancyHistoryResource class
+ */
+class OccupancyHistoryResource : public DynamicResource
+{
+private:
+    OccupancyHistory	m_history;
+    NotificationMailbox	m_mailbox;
+    notification_claim_t m_claim;
+    string				m_res_name;
+
+public:
+    /**
+    Default constructor
+    @param logger input logger instance for this resource
+    @param obj_name input the Light Object name
+    @param res_name input the Light Resource name
+    @param observable input the resource is Observable (default: FALSE)
+    */
+    OccupancyHistoryResource(const Logger *logger,const char *obj_name,const char *res_name,const bool observable = false) : DynamicResource(logger,obj_name,res_name,"OccupancyHistory",M2MBase::GET_PUT_ALLOWED,observable), m_mailbox(_send_occupancy_history_notification,_occupancy_history_notification_done) {
+        // init
+        __history_instance = (void *)this;
+        this->m_res_name = res_name;
+        this->m_mailbox.configure(OCCUPANCY_HISTORY_BATCH_MS,OCCUPANCY_HISTORY_RESEND_MS,0.0);
+        this->m_claim.deferred = false;
+        this->m_claim.start_ms = 0;
+    }
+
+    /**
+    Get the oldest unacknowledged transitions
+    @returns string containing a SenML pack of (up to OCCUPANCY_HISTORY_PACK_MAX) transitions
+    */
+    virtual string get() {
+        return this->m_history.pack(OCCUPANCY_HISTORY_BASE_NAME);
+    }
+
+    /**
+    Acknowledge transitions
+    JSON format: {"ack":17}
+    ack - the highest sequence number received (the transitions up to it are dropped... the next pack follows)
+    */
+    virtual void put(const string value) {
+    	MbedJSONValue parsed;
+    	parse(parsed, value.c_str());
+    	if (parsed.hasMember((char *)"ack") == false) {
+    		this->logger()->log("OccupancyHistoryResource: no ack in PUT: %s",value.c_str());
+    		return;
+    	}
+    	uint32_t seq = (uint32_t)parsed["ack"].get<int>();
+    	int dropped = this->m_history.ack(seq);
+    	this->logger()->log("OccupancyHistoryResource: ack %lu: dropped %d (pending: %d overwritten: %d)",(unsigned long)seq,dropped,this->m_history.pending(),this->m_history.overwritten());
+    	if (dropped > 0 && this->m_history.pending() > 0) {
+    		// more waiting... send the next pack
+    		this->m_mailbox.post(OCCUPANCY_HISTORY_PENDING,(float)this->m_history.last_seq());
+    	}
+    }
+
+    /**
+    Bind the resource... also hooks the notification delivery callback for the mailbox
+    @param p input the endpoint instance
+    @returns M2MObject for the occupancy history
+    */
+    virtual M2MObject *bind(void *p) {
+        M2MObject *obj = DynamicResource::bind(p);
+        if (obj != NULL && obj->object_instance() != NULL) {
+        	M2MResource *res = obj->object_instance()->resource(this->m_res_name.c_str());
+        	if (res != NULL) {
+        		res->set_notification_sent_callback(_occupancy_history_notification_sent);
+        	}
+        }
+        return obj;
+    }
+
+    // record a stall transition (EVENT QUEUE)... transitions within the batch window share a notification
+    void record(int stall,int from_state,int to_state,float range) {
+    	uint32_t seq = this->m_history.record(time(NULL),stall,from_state,to_state,range);
+    	this->m_mailbox.post(OCCUPANCY_HISTORY_PENDING,(float)seq);
+    }
+
+    // send the pending transitions (EVENT QUEUE)... get() packs them (idle: all acknowledged since, busy: the mailbox retries)
+    MailboxSendResults send_notification() {
+    	if (this->m_history.pending() == 0) {
+    		notification_scheduler()->cancel(NOTIFY_BULK,this->m_claim);
+    		return MAILBOX_IDLE;
+    	}
+    	if (notification_scheduler()->try_begin(NOTIFY_BULK,this->m_claim) == false) {
+    		return MAILBOX_BUSY;
+    	}
+    	this->observe();
+    	this->logger()->log("OccupancyHistoryResource: notified %d pending (last seq: %lu acked: %lu)",this->m_history.pending(),
+    			(unsigned long)this->m_history.last_seq(),(unsigned long)this->m_history.acked_seq());
+    	return MAILBOX_SENT;
+    }
+
+    // the last notification was delivered (mbed-client callback)
+    void notification_sent() {
+    	this->m_mailbox.delivered();
+    }
+
+    // the notification in flight was delivered or its acknowledgement timed out... release the gate
+    void notification_done() {
+    	notification_scheduler()->end(NOTIFY_BULK);
+    }
+};
+
+// record a stall transition (ParkingStallOccupancyDetectorResource)
+extern "C" void record_stall_transition(int stall,int from_state,int to_state,float range) {
+	if (__history_instance != NULL) {
+		((OccupancyHistoryResource *)__history_instance)->record(stall,from_state,to_state,range);
+	}
+}
+
+// notification delivered (mbed-client callback)
+extern "C" void _occupancy_history_notification_sent(void) {
+	if (__history_instance != NULL) {
+		((OccupancyHistoryResource *)__history_instance)->notification_sent();
+	}
+}
+
+// notification delivered or given up on (mailbox)
+extern "C" void _occupancy_history_notification_done(void) {
+	if (__history_instance != NULL) {
+		((OccupancyHistoryResource *)__history_instance)->notification_done();
+	}
+}
+
+// send the pending transitions (EVENT QUEUE)
+extern "C" MailboxSendResults _send_occupancy_history_notification(void) {
+	if (__history_instance != NULL) {
+		return ((OccupancyHistoryResource *)__history_instance)->send_notification();
+	}
+	return MAILBOX_IDLE;
+}
+
+#endif // __OCCUPANCY_HISTORY_RESOURCE_H__
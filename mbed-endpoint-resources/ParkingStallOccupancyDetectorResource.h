@@ -23,11 +23,35 @@
 #ifndef __PARKING_STALL_OCCUPANCY_DETECTOR_RESOURCE_H__
 #define __PARKING_STALL_OCCUPANCY_DETECTOR_RESOURCE_H__
 
+// version info
+#include "version.h"
+
 // Base class
 #include "mbed-connector-interface/DynamicResource.h"
 
-// RangeFinder 
-#include "RangeFinder.h"
+// interrupt driven range finder
+#include "AsyncRangeFinder.h"
+
+// time slotted range finder multiplexer (one ping in the air at a time)
+#include "RangeMultiplexer.h"
+
+// range sample filter
+#include "RangeFilter.h"
+
+// adaptive sampling scheduler
+#include "SampleScheduler.h"
+
+// occupancy state machine (transition table)
+#include "ParkingStallStateMachine.h"
+
+// notification scheduler (state changes go ahead of image data)
+#include "NotificationScheduler.h"
+
+// lock-free transition queue
+#include "LockFreeRing.h"
+
+// shared event queue (the state machine runs here)
+#include "SharedEventQueue.h"
 
 // JSON parsing support
 #include "MbedJSONValue.h"
@@ -36,14 +60,48 @@
 extern "C" void turn_beacon_on(void);
 extern "C" void turn_beacon_off(void);
 
-// Seeed ultrasound range finder
-static RangeFinder __range_finder(D2, 10, 5800.0, 100000);
+// hooks for camera power management (warm up on ARRIVING, power down on EMPTY)
+#if ENABLE_V2_CAMERA
+extern "C" void camera_warm_up(void);
+extern "C" void camera_power_down(void);
+extern "C" void camera_capture(int event);
+#endif
+
+// hook into the transition history (OccupancyHistoryResource)
+extern "C" void record_stall_transition(int stall,int from_state,int to_state,float range);
+
+// TUNE: parking stalls watched by this meter (one range finder each... object instances /400/0 .. /400/N-1)
+#define NUM_PARKING_STALLS				1
+#if NUM_PARKING_STALLS < 1 || NUM_PARKING_STALLS > RANGE_MUX_MAX_SENSORS
+	#error "NUM_PARKING_STALLS must be 1..RANGE_MUX_MAX_SENSORS"
+#endif
+
+// Seeed ultrasound range finder of each stall (ranged from interrupts... samples consumed on the shared event queue)
+static const PinName __stall_range_finder_pins[RANGE_MUX_MAX_SENSORS] = { D2, D3, A0, A1 };	// D3: free with the V2 beacon switch on D8
+
+// range finder trigger pulse (us), scale (us per m) and echo timeout (us)
+#define RANGE_FINDER_PULSE_US			10
+#define RANGE_FINDER_SCALE				5800.0
+#define RANGE_FINDER_TIMEOUT_US			40000	// 40ms: > the ~38ms "nothing there" echo... lets the scheduler go below 100ms
+
+// range finder slot (ms): one sensor pings per slot... covers the echo timeout so stalls never hear each other
+#define RANGE_FINDER_SLOT_MS			SCHEDULER_MIN_PERIOD_MS
 
 // Our wait time between checks for range detection (in ms)
-#define WAIT_TIME                   	1000    // 1 seconds between range checks
+#define WAIT_TIME                   	1000    // 1 seconds between range checks (at start)
 
 // High resolution wait time
-#define HREZ_WAIT_TIME			150	// 150ms between range checks
+#define HREZ_WAIT_TIME			150	// 150ms between range checks (car moving... shorter for a fast approach)
+
+// Longest wait time
+#define MAX_WAIT_TIME			1000	// nothing changing: back off (doubling) up to 1 second between range checks (the detection latency of a fixed 1s rate)
+
+// Longest wait time once a stall has sat EMPTY or OCCUPIED for IDLE_AFTER_TIME (MAX_WAIT_TIME: stay at the 1s rate)
+#define IDLE_WAIT_TIME			SCHEDULER_DEFAULT_IDLE_MS	// ~900 range checks per hour instead of 3600... an arrival from long idle is seen up to 4s late
+#define IDLE_AFTER_TIME			SCHEDULER_DEFAULT_IDLE_AFTER_MS
+
+// sampling metrics report interval (ms)
+#define SAMPLING_REPORT_MS		60000
 
 // Status String length
 #define STATUS_STRING_LENGTH		64
@@ -54,7 +112,10 @@ static RangeFinder __range_finder(D2, 10, 5800.0, 100000);
 #define ARRIVING_STR             	"2"     // object arriving
 #define DEPARTING_STR			"3"	// object leaving
 
-// CONFIG: {"min_move_rate":0.03,"occupied_range":0.12,"max_range":0.37,"occupied_variance":0.01,"range_end":0.60}
+// OPTION: capture on-device when the stall goes OCCUPIED (image stream tagged with the status "count")
+#define DO_LOCAL_CAPTURE		false	// true: OCCUPIED transition captures directly (the cloud flow must stop POSTing), false: wait for the cloud POST
+
+// CONFIG: {"min_move_rate":0.03,"occupied_range":0.12,"max_range":0.37,"occupied_variance":0.01,"range_end":0.60,"filter_median":3,"filter_ema":1.0,"filter_max_velocity":1.0,"fast_period_ms":150,"max_period_ms":1000,"idle_period_ms":4000,"idle_after_ms":60000}
 
 // minimum movement rate (denotes movement vs. non-movement)
 #define DEFAULT_MOVEMENT_RATE_M_S	0.03	// +-0.03 m/sec
@@ -71,26 +132,38 @@ static RangeFinder __range_finder(D2, 10, 5800.0, 100000);
 // range END
 #define DEFAULT_RANGE_END_M		0.60	// < MAX_RANGE and beyond which, we set the range value to "OUT_OF_RANGE"
 
-// default OUT OF RANGE value
-#define DEFAULT_OUT_OF_RANGE	    	100.0	// defaulted out of range range value...
-
 // forward declarations
 static void *_instance = NULL;
 
-// observation latch: true - observation allowed, false - observation not allowed
-static bool __observation_latch = true;
-
-// parking stall state
+// parking meter state (OCCUPIED if any stall is... see meter_state())
 static int __parking_stall_state = 0;
 extern "C" int parking_stall_state(void) {
 	return __parking_stall_state;
 }
 
-// reset the observation latch forward reference
-extern "C" void reset_observation_latch();
+// notification delivery callback forward references (one per stall)
+extern "C" void _parking_stall_0_notification_sent(void);
+extern "C" void _parking_stall_1_notification_sent(void);
+extern "C" void _parking_stall_2_notification_sent(void);
+extern "C" void _parking_stall_3_notification_sent(void);
+static void (* const __stall_notification_sent[RANGE_MUX_MAX_SENSORS])(void) = {
+	_parking_stall_0_notification_sent, _parking_stall_1_notification_sent, _parking_stall_2_notification_sent, _parking_stall_3_notification_sent
+};
+
+// notification delivery timeout forward reference
+extern "C" void _parking_stall_notification_timeout(void);
+
+// notification retry (gate busy) forward reference
+extern "C" void _parking_stall_notify_retry(void);
+
+// ranging start forward reference
+extern "C" void _start_parking_stall_ranging(void);
 
-// parking stall state updater forward reference
-extern "C" void _update_parking_stall_state(const void *args);
+// range sample consumer forward reference
+extern "C" void _process_parking_stall_range_samples(void);
+
+// configuration apply forward reference
+extern "C" void _apply_parking_stall_config(void);
 
 // LED togglers
 extern "C" void parking_status_led_red(bool on);
@@ -98,42 +171,94 @@ extern "C" void parking_status_led_yellow(bool on);
 extern "C" void parking_status_led_green(bool on);
 extern "C" void parking_status_led_blue(bool on);
 
-// parking stall states
-enum ParkingStallStates {
-	STALL_EMPTY=0,			// stall is EMPTY
-	STALL_OCCUPIED=1,		// stall is OCCUPIED
-	STALL_ARRIVING=2,		// stall has car arriving into it
-	STALL_DEPARTING=3,		// stall has car departing from it
-	STALL_NUM_STATES=4		// number of states
+// a stall transition, queued for notification
+typedef struct {
+	uint32_t			seq;		// sequence number of the stall (a gap at the server means a lost notification)
+	time_t				timestamp;	// transition time (epoch seconds)
+	int					count;		// status count
+	int					stall;
+	ParkingStallStates	state;
+} stall_event_t;
+
+// TUNE: stall transitions waiting for notification (power of two)
+#define STALL_EVENT_QUEUE_DEPTH		16
+
+// TUNE: send the next notification if the previous one is not acknowledged in time (ms)
+#define STALL_NOTIFY_TIMEOUT_MS		2000
+
+// stall transition notification length
+#define STALL_EVENT_STRING_LENGTH	96
+
+// LEDs of each state (red, yellow, green)
+static const bool __stall_leds[STALL_NUM_STATES][3] = {
+	{ true, false, false },		// STALL_EMPTY
+	{ true, false, false },		// STALL_OCCUPIED
+	{ true, true,  false },		// STALL_ARRIVING
+	{ true, true,  false }		// STALL_DEPARTING
 };
 
-// parking stall movement direction
-enum MovementDirection {
-	INTO_STALL=0,			// movement into the stall
-	NO_MOVEMENT=1,			// no movement
-	OUT_OF_STALL=2			// movement out of the stall
-};
+// state of each stall (struct of arrays: compact, no per-stall padding... one sample touches one column)
+typedef struct {
+	uint8_t				state[NUM_PARKING_STALLS];				// ParkingStallStates
+	uint8_t				movement[NUM_PARKING_STALLS];			// MovementDirection
+	bool				sampling_active[NUM_PARKING_STALLS];
+	bool				perform_observation[NUM_PARKING_STALLS];
+	bool				state_change[NUM_PARKING_STALLS];
+	float				range[NUM_PARKING_STALLS];
+	float				last_range[NUM_PARKING_STALLS];
+	float				speed[NUM_PARKING_STALLS];
+	uint32_t			last_sample_us[NUM_PARKING_STALLS];
+	uint32_t			event_seq[NUM_PARKING_STALLS];
+	int					notifications[NUM_PARKING_STALLS];
+	int					wait_time[NUM_PARKING_STALLS];
+	int					counter[NUM_PARKING_STALLS];
+} parking_stalls_t;
+
+// requested configuration of the per stall stages (PUT on the mbed-client thread... applied on the event queue, where the stages run)
+typedef struct {
+	bool				filter_changed;
+	int					filter_median;
+	float				filter_ema;
+	float				filter_max_velocity;
+	bool				sampling_changed;
+	int					fast_period_ms;
+	int					max_period_ms;
+	int					idle_period_ms;
+	int					idle_after_ms;
+} stall_config_t;
 
 /** ParkingStallOccupancyDetectorResource class
  */
 class ParkingStallOccupancyDetectorResource : public DynamicResource
 {
 private:
-    Thread         	   *m_parking_stall_state_transitioner;
-    int					m_wait_time;
-    float           	m_range;
-    float			    m_last_range;
+    bool				m_ranging_started;
+    bool				m_observable;
+    parking_stalls_t	m_stalls;
+    AsyncRangeFinder   *m_finders[NUM_PARKING_STALLS];
+    RangeMultiplexer	m_mux;
+    RangeFilter			m_filter[NUM_PARKING_STALLS];
+    SampleScheduler		m_scheduler[NUM_PARKING_STALLS];
+    Mutex				m_config_mutex;
+    stall_config_t		m_config;
+    M2MResource		   *m_stall_res[NUM_PARKING_STALLS];
+    string				m_state_str[NUM_PARKING_STALLS];
+    Timer				m_report_timer;
+    LockFreeRing<stall_event_t,STALL_EVENT_QUEUE_DEPTH> m_events;
+    int					m_dropped_events;
+    bool				m_notify_in_flight;
+    int					m_notify_stall;
+    int					m_notify_timeout_id;
+    stall_event_t		m_sending;
+    bool				m_has_sending;
+    bool				m_notify_retry_scheduled;
+    notification_claim_t m_claim;
+    string				m_res_name;
     float				m_min_rate;
     float           	m_occupied_range;
     float			    m_max_occupied_range_variance;
     float				m_max_range;
     float 				m_range_end;
-    string          	m_parking_stall_state_str;
-    bool            	m_perform_observation;
-    bool				m_state_change;
-    MovementDirection	m_movement;
-    int					m_counter;
-    ParkingStallStates  m_state;
 
 public:
     /**
@@ -146,15 +271,16 @@ public:
     ParkingStallOccupancyDetectorResource(const Logger *logger,const char *obj_name,const char *res_name,const bool observable = false) : DynamicResource(logger,obj_name,res_name,"OccupancyDetector",M2MBase::GET_PUT_ALLOWED,observable) {
         // init
         _instance = (void *)this;
-        
-        // initialize default states
-        this->m_range = DEFAULT_OUT_OF_RANGE;
-        this->m_last_range = DEFAULT_OUT_OF_RANGE;
-        this->m_wait_time = WAIT_TIME;
-        this->m_counter = 0;
-        this->m_movement = NO_MOVEMENT;
-        this->m_parking_stall_state_str = EMPTY_STR;
-        this->m_state = STALL_EMPTY;
+        this->m_res_name = res_name;
+        this->m_observable = observable;
+        this->m_dropped_events = 0;
+        this->m_notify_in_flight = false;
+        this->m_notify_stall = 0;
+        this->m_notify_timeout_id = 0;
+        this->m_has_sending = false;
+        this->m_notify_retry_scheduled = false;
+        this->m_claim.deferred = false;
+        this->m_claim.start_ms = 0;
 
         // default configuration
         this->m_min_rate = DEFAULT_MOVEMENT_RATE_M_S;
@@ -162,43 +288,70 @@ public:
         this->m_max_range = DEFAULT_MAX_RANGE_M;
         this->m_range_end = DEFAULT_RANGE_END_M;
         this->m_max_occupied_range_variance = DEFAULT_OCCUPIED_VARIANCE_M;
-        
-        // no Thread yet
-        this->m_parking_stall_state_transitioner = NULL;
-        
-        // no observation yet
-        this->m_perform_observation = false;
-        this->m_state_change = false;
+        this->m_config.filter_changed = false;
+        this->m_config.filter_median = this->m_filter[0].median_n();
+        this->m_config.filter_ema = this->m_filter[0].ema_alpha();
+        this->m_config.filter_max_velocity = this->m_filter[0].max_velocity();
+        this->m_config.sampling_changed = false;
+        this->m_config.fast_period_ms = HREZ_WAIT_TIME;
+        this->m_config.max_period_ms = MAX_WAIT_TIME;
+        this->m_config.idle_period_ms = IDLE_WAIT_TIME;
+        this->m_config.idle_after_ms = IDLE_AFTER_TIME;
+
+        // initialize default states of each stall
+        memset(&this->m_stalls,0,sizeof(this->m_stalls));
+        for(int stall=0;stall<NUM_PARKING_STALLS;++stall) {
+        	this->m_stalls.state[stall] = STALL_EMPTY;
+        	this->m_stalls.movement[stall] = NO_MOVEMENT;
+        	this->m_stalls.range[stall] = DEFAULT_OUT_OF_RANGE;
+        	this->m_stalls.last_range[stall] = DEFAULT_OUT_OF_RANGE;
+        	this->m_stalls.wait_time[stall] = WAIT_TIME;
+        	this->m_state_str[stall] = EMPTY_STR;
+        	this->m_stall_res[stall] = NULL;
+        	this->m_scheduler[stall].configure(HREZ_WAIT_TIME,MAX_WAIT_TIME,SCHEDULER_DEFAULT_CHANGE_M,SCHEDULER_DEFAULT_REFERENCE_SPEED,IDLE_WAIT_TIME,IDLE_AFTER_TIME);
+
+        	// not ranging yet... the multiplexer takes turns between the stalls
+        	this->m_finders[stall] = new AsyncRangeFinder(__stall_range_finder_pins[stall],RANGE_FINDER_PULSE_US,RANGE_FINDER_SCALE,RANGE_FINDER_TIMEOUT_US);
+        	this->m_mux.add(this->m_finders[stall],WAIT_TIME);
+        }
+        this->m_ranging_started = false;
     }
 
     /**
     Get the ParkingStallOccupancyDetectorResource value
-    @returns string containing the current state of the parking stall
+    @returns string containing the current state of the parking stall (stall 0... the other stalls are their own object instances)
     */
     virtual string get() {
-        // we have to wait until the main loop starts in the endpoint before we create our thread... 
-        if (this->m_parking_stall_state_transitioner == NULL) {
-            // create the processing thread
-            this->m_parking_stall_state_transitioner = new Thread();
-            if (this->m_parking_stall_state_transitioner != NULL) {
-            	this->m_parking_stall_state_transitioner->start(callback(_update_parking_stall_state,(const void *)NULL));
+        // we have to wait until the main loop starts in the endpoint before we start ranging... 
+        if (this->m_ranging_started == false) {
+            // wait a bit initially... then range from interrupts
+            if (shared_event_queue()->call_in(4*WAIT_TIME,_start_parking_stall_ranging) != 0) {
+            	this->m_ranging_started = true;
             }
             else {
-            	this->logger()->log("ParkingStallOccupancyDetectorResource: unable to allocate Thread. Aborting...");
+            	this->logger()->log("ParkingStallOccupancyDetectorResource: unable to schedule ranging. Retrying on next GET...");
             }
         }
         
         // return our latest range status
-        return this->m_parking_stall_state_str;
+        return this->m_state_str[0];
     }
     
     /**
-    Set the configuration for the parking stall occupancy detector
-    JSON format: {"min_move_rate":0.03,"occupied_range":0.12,"max_range":0.37,"occupied_variance":0.01,"range_end":0.50}
+    Set the configuration for the parking stall occupancy detector (every stall)
+    JSON format: {"min_move_rate":0.03,"occupied_range":0.12,"max_range":0.37,"occupied_variance":0.01,"range_end":0.50,"filter_median":3,"filter_ema":1.0,"filter_max_velocity":1.0,"fast_period_ms":150,"max_period_ms":1000,"idle_period_ms":4000,"idle_after_ms":60000}
     min_move_rate - the minimum rate to indicate "movemment" and is directional (negative: toward camera, positive: away from camera)
     occupied_range - range from the camera when a car is parked in the stall
     max_range - maximum range beyond which we dont care what happens
     occupied_variance - amount of "variance" we can have to accept the range as "occupied"
+    filter_median - median window (samples, odd, 1: off)
+    filter_ema - EMA weight of a new sample (1.0: off)
+    filter_max_velocity - samples implying a faster move (m/s) are held back until the next sample confirms them (0.0: off)
+    fast_period_ms - ranging period while a car is moving (shorter for a faster approach)
+    max_period_ms - ceiling of the ranging period while nothing changes (at most SCHEDULER_MAX_PERIOD_MS)
+    idle_period_ms - ceiling once the stall has sat EMPTY or OCCUPIED for idle_after_ms (at most SCHEDULER_MAX_IDLE_PERIOD_MS, max_period_ms: off)
+    idle_after_ms - how long a stall must sit EMPTY or OCCUPIED before backing off past max_period_ms
+    Each value is optional... omitted values are unchanged
     @param string input the string containing a JSON in the above format
     */
     virtual void put(const string json) {
@@ -209,111 +362,371 @@ public:
     	parse(parsed, json.c_str());
 
     	// set the configuration
-    	this->m_min_rate = (float)parsed["min_move_rate"].get<double>();
-    	this->m_occupied_range = (float)parsed["occupied_range"].get<double>();
-    	this->m_max_range = (float)parsed["max_range"].get<double>();
-    	this->m_max_occupied_range_variance = (float)parsed["occupied_variance"].get<double>();
-    	this->m_range_end = (float)parsed["range_end"].get<double>();
+    	if (parsed.hasMember((char *)"min_move_rate")) {
+    		this->m_min_rate = (float)parsed["min_move_rate"].get<double>();
+    	}
+    	if (parsed.hasMember((char *)"occupied_range")) {
+    		this->m_occupied_range = (float)parsed["occupied_range"].get<double>();
+    	}
+    	if (parsed.hasMember((char *)"max_range")) {
+    		this->m_max_range = (float)parsed["max_range"].get<double>();
+    	}
+    	if (parsed.hasMember((char *)"occupied_variance")) {
+    		this->m_max_occupied_range_variance = (float)parsed["occupied_variance"].get<double>();
+    	}
+    	if (parsed.hasMember((char *)"range_end")) {
+    		this->m_range_end = (float)parsed["range_end"].get<double>();
+    	}
+
+    	// filter configuration (restarts the filters... the filters run on the event queue: applied there)
+    	this->m_config_mutex.lock();
+    	if (parsed.hasMember((char *)"filter_median")) {
+    		this->m_config.filter_median = parsed["filter_median"].get<int>();
+    		this->m_config.filter_changed = true;
+    	}
+    	if (parsed.hasMember((char *)"filter_ema")) {
+    		this->m_config.filter_ema = (float)parsed["filter_ema"].get<double>();
+    		this->m_config.filter_changed = true;
+    	}
+    	if (parsed.hasMember((char *)"filter_max_velocity")) {
+    		this->m_config.filter_max_velocity = (float)parsed["filter_max_velocity"].get<double>();
+    		this->m_config.filter_changed = true;
+    	}
+
+    	// sampling configuration (the schedulers run on the event queue too)
+    	if (parsed.hasMember((char *)"fast_period_ms")) {
+    		this->m_config.fast_period_ms = parsed["fast_period_ms"].get<int>();
+    		this->m_config.sampling_changed = true;
+    	}
+    	if (parsed.hasMember((char *)"max_period_ms")) {
+    		this->m_config.max_period_ms = parsed["max_period_ms"].get<int>();
+    		this->m_config.sampling_changed = true;
+    	}
+    	if (parsed.hasMember((char *)"idle_period_ms")) {
+    		this->m_config.idle_period_ms = parsed["idle_period_ms"].get<int>();
+    		this->m_config.sampling_changed = true;
+    	}
+    	if (parsed.hasMember((char *)"idle_after_ms")) {
+    		this->m_config.idle_after_ms = parsed["idle_after_ms"].get<int>();
+    		this->m_config.sampling_changed = true;
+    	}
+    	this->m_config_mutex.unlock();
         
         // DEBUG
         this->logger()->log("ParkingStallOccupancyDetectorResource: min_rate: %.1f occupied: %.1f max_range: %.1f occupied_variance: %.2f",
         		this->m_min_rate,this->m_occupied_range,this->m_max_range,this->m_max_occupied_range_variance);
+
+        // apply the stage configuration on the event queue (also picked up by the next range sample if the queue is full)
+        if (shared_event_queue()->call(_apply_parking_stall_config) == 0) {
+        	this->logger()->log("ParkingStallOccupancyDetectorResource: unable to queue the configuration... applied with the next range sample");
+        }
+    }
+
+    // apply the requested stage configuration to every stall (EVENT QUEUE)
+    void apply_config() {
+    	this->m_config_mutex.lock();
+    	stall_config_t config = this->m_config;
+    	this->m_config.filter_changed = false;
+    	this->m_config.sampling_changed = false;
+    	this->m_config_mutex.unlock();
+
+    	if (config.filter_changed) {
+    		for(int stall=0;stall<NUM_PARKING_STALLS;++stall) {
+    			this->m_filter[stall].configure(config.filter_median,config.filter_ema,config.filter_max_velocity);
+    		}
+
+    		// DEBUG
+    		this->logger()->log("ParkingStallOccupancyDetectorResource: filter median: %d ema: %.2f max_velocity: %.2f (rejected so far: %d)",
+    				this->m_filter[0].median_n(),this->m_filter[0].ema_alpha(),this->m_filter[0].max_velocity(),this->m_filter[0].rejected());
+    	}
+    	if (config.sampling_changed) {
+    		for(int stall=0;stall<NUM_PARKING_STALLS;++stall) {
+    			this->m_scheduler[stall].configure(config.fast_period_ms,config.max_period_ms,SCHEDULER_DEFAULT_CHANGE_M,SCHEDULER_DEFAULT_REFERENCE_SPEED,
+    					config.idle_period_ms,config.idle_after_ms);
+    		}
+
+    		// DEBUG
+    		this->logger()->log("ParkingStallOccupancyDetectorResource: sampling fast: %d ms max: %d ms idle: %d ms (after %d ms)",this->m_scheduler[0].fast_ms(),
+    				this->m_scheduler[0].max_ms(),this->m_scheduler[0].idle_ms(),this->m_scheduler[0].idle_after_ms());
+    	}
     }
     
-    // get the wait time
-    int get_wait_time() {
-    	return this->m_wait_time;
+    // get the wait time of a stall
+    int get_wait_time(int stall = 0) {
+    	return this->m_stalls.wait_time[stall];
+    }
+
+    // start ranging (EVENT QUEUE)
+    void start_ranging() {
+    	this->logger()->log("ParkingStallOccupancyDetectorResource: ranging %d stall(s) in %d ms slots (every %d ms at start)...",NUM_PARKING_STALLS,RANGE_FINDER_SLOT_MS,WAIT_TIME);
+    	for(int stall=0;stall<NUM_PARKING_STALLS;++stall) {
+    		this->m_finders[stall]->start(0,shared_event_queue(),_process_parking_stall_range_samples);
+    	}
+    	this->m_mux.start(RANGE_FINDER_SLOT_MS);
+    	this->m_report_timer.start();
+    }
+
+    // consume the waiting range samples of every stall (EVENT QUEUE)
+    void process_range_samples() {
+    	range_sample_t sample;
+    	this->apply_config();
+    	for(int stall=0;stall<NUM_PARKING_STALLS;++stall) {
+    		while (this->m_finders[stall]->read(sample)) {
+    			this->update_parking_stall_state(stall,sample);
+    		}
+
+    		// the scheduler picked the ranging rate (fast while a car is moving... backing off while nothing changes)
+    		this->m_mux.set_period(stall,this->m_stalls.wait_time[stall]);
+    	}
+
+    	// METRICS: how much we range
+    	if (this->m_report_timer.read_ms() >= SAMPLING_REPORT_MS) {
+    		this->report_sampling();
+    		this->m_report_timer.reset();
+    	}
+    }
+
+    // METRICS: samples per minute and ranging duty cycle of each stall since the last report
+    void report_sampling() {
+    	for(int stall=0;stall<NUM_PARKING_STALLS;++stall) {
+    		uint32_t elapsed_us = 0;
+    		uint32_t active_us = 0;
+    		int triggers = 0;
+    		this->m_finders[stall]->take_stats(elapsed_us,active_us,triggers);
+    		if (elapsed_us > 0) {
+    			this->logger()->log("ParkingStallOccupancyDetectorResource: stall %d sampling: %.1f samples/min duty: %.3f%% period: %d ms (overruns: %d)",
+    					stall,(triggers * 60000000.0) / elapsed_us,(active_us * 100.0) / elapsed_us,this->m_stalls.wait_time[stall],this->m_finders[stall]->overruns());
+    		}
+    		this->logger()->log("ParkingStallOccupancyDetectorResource: stall %d state notifications: %d",stall,this->m_stalls.notifications[stall]);
+    	}
+    	this->logger()->log("ParkingStallOccupancyDetectorResource: idle wake ups: %d transitions queued: %d (dropped: %d) state notification queueing avg: %d ms max: %d ms delivery avg: %d ms max: %d ms",
+    			this->m_mux.idle_slots(),(int)this->m_events.count(),this->m_dropped_events,notification_scheduler()->average_wait_ms(NOTIFY_STATE),notification_scheduler()->max_wait_ms(NOTIFY_STATE),
+    			notification_scheduler()->average_latency_ms(NOTIFY_STATE),notification_scheduler()->max_latency_ms(NOTIFY_STATE));
     }
 
     // call to perform an observation if needed
-    void update_parking_stall_state() {
-        // get the latest range values
-        this->get_range();
+    void update_parking_stall_state(int stall,const range_sample_t &sample) {
+        // get the latest range values (a sample held back by the filter changes nothing... but is worth a quick second look)
+        if (this->get_range(stall,sample) == false) {
+        	this->m_stalls.wait_time[stall] = this->m_scheduler[stall].update(this->m_stalls.range[stall],0.0,true);
+        	return;
+        }
+        float range = this->m_stalls.range[stall];
         
         // update our status
-        this->parking_stall_state_transitioner();
-        
-        // set our value and create an observation event
-        if (this->m_perform_observation == true && __observation_latch == true && this->m_state_change == true) {
-        	// DEBUG
-        	this->logger()->log("ParkingStallOccupancyDetectorResource: Sending observation....");
-            this->observe();
+        this->parking_stall_state_transitioner(stall);
 
-            // reset latch
-            this->logger()->log("ParkingStallOccupancyDetectorResource: Latching until we are done with the camera...");
-            __observation_latch = false;
+        // next ranging period
+        this->m_stalls.wait_time[stall] = this->m_scheduler[stall].update(range,this->m_stalls.speed[stall],this->m_stalls.sampling_active[stall]);
+        
+        // queue the transition for notification... whatever the camera is doing
+        if (this->m_stalls.perform_observation[stall] == true && this->m_stalls.state_change[stall] == true) {
+        	this->publish_event(stall);
 
             // observation sent for this state once (state must change prior to another being sent)
-            this->m_state_change = false;
+            this->m_stalls.state_change[stall] = false;
         }
-        else if (this->m_perform_observation == true && this->m_state_change == true) {
-        	// latch locked... not observing...
-        	this->logger()->log("ParkingStallOccupancyDetectorResource: NOT observing... latch still locked...");
-        }
-        else if (this->m_perform_observation == true && __observation_latch == true) {
+        else if (this->m_stalls.perform_observation[stall] == true) {
 			// already observed for this particular state change event
-			this->logger()->log("ParkingStallOccupancyDetectorResource: already observed for this state change (OK)...");
+			this->logger()->log("ParkingStallOccupancyDetectorResource: stall %d already observed for this state change (OK)...",stall);
 		}
         else {
         	// DEBUG nothing to observe
         	//this->logger()->log("ParkingStallOccupancyDetectorResource: Nothing to observe (OK)");
-        	reset_observation_latch();
-        	this->m_state_change = false;
+        	this->m_stalls.state_change[stall] = false;
         }
     }
+
+    /**
+    Bind the resource... also hooks the notification delivery callbacks that pace our transition notifications
+    and creates the object instances of the other stalls (/400/1 ... read only, notified from the same state machine)
+    @param p input the endpoint instance
+    @returns M2MObject for the occupancy detector
+    */
+    virtual M2MObject *bind(void *p) {
+        M2MObject *obj = DynamicResource::bind(p);
+        if (obj != NULL && obj->object_instance() != NULL) {
+        	M2MResource *res = obj->object_instance()->resource(this->m_res_name.c_str());
+        	if (res != NULL) {
+        		res->set_notification_sent_callback(__stall_notification_sent[0]);
+        	}
+        	for(int stall=1;stall<NUM_PARKING_STALLS;++stall) {
+        		M2MObjectInstance *instance = obj->create_object_instance((uint16_t)stall);
+        		M2MResource *stall_res = (instance != NULL) ? instance->create_dynamic_resource(this->m_res_name.c_str(),"OccupancyDetector",M2MResourceInstance::STRING,this->m_observable) : NULL;
+        		if (stall_res == NULL) {
+        			this->logger()->log("ParkingStallOccupancyDetectorResource: unable to create the resource of stall %d",stall);
+        			continue;
+        		}
+        		stall_res->set_operation(M2MBase::GET_ALLOWED);
+        		stall_res->set_value((const uint8_t *)this->m_state_str[stall].c_str(),(uint32_t)this->m_state_str[stall].length());
+        		stall_res->set_notification_sent_callback(__stall_notification_sent[stall]);
+        		this->m_stall_res[stall] = stall_res;
+        	}
+        }
+        return obj;
+    }
+
+    // send the next queued transition (EVENT QUEUE)... one notification in flight at a time, every transition in order
+    void notify_events() {
+    	if (this->m_notify_in_flight == true || this->m_notify_retry_scheduled == true) {
+    		return;
+    	}
+    	if (this->m_has_sending == false) {
+    		if (this->m_events.pop(this->m_sending) == false) {
+    			return;
+    		}
+    		this->m_has_sending = true;
+    	}
+
+    	// never block the event queue: if an observation is going out, keep our claim and retry shortly
+    	if (notification_scheduler()->try_begin(NOTIFY_STATE,this->m_claim) == false) {
+    		if (shared_event_queue()->call_in(NOTIFY_RETRY_MS,_parking_stall_notify_retry) != 0) {
+    			this->m_notify_retry_scheduled = true;
+    		}
+    		else {
+    			// retried on the next transition
+    			notification_scheduler()->cancel(NOTIFY_STATE,this->m_claim);
+    		}
+    		return;
+    	}
+    	stall_event_t event = this->m_sending;
+    	this->m_has_sending = false;
+
+    	// the notification carries the transition itself (not just the latest state)
+    	char buf[STALL_EVENT_STRING_LENGTH+1];
+    	memset(buf,0,STALL_EVENT_STRING_LENGTH+1);
+    	snprintf(buf,STALL_EVENT_STRING_LENGTH,"{\"count\":%d,\"state\":%d,\"seq\":%lu,\"ts\":%ld}",event.count,(int)event.state,(unsigned long)event.seq,(long)event.timestamp);
+    	this->m_state_str[event.stall] = string(buf);
+
+    	// DEBUG
+    	this->logger()->log("ParkingStallOccupancyDetectorResource: Sending observation (stall %d seq: %lu state: %d queued: %d)....",event.stall,(unsigned long)event.seq,(int)event.state,(int)this->m_events.count());
+    	this->m_notify_in_flight = true;
+    	this->m_notify_stall = event.stall;
+    	++this->m_stalls.notifications[event.stall];
+    	if (event.stall == 0) {
+    		this->observe();
+    	}
+    	else if (this->m_stall_res[event.stall] != NULL) {
+    		// the other stalls notify through their own instance
+    		this->m_stall_res[event.stall]->set_value((const uint8_t *)buf,(uint32_t)strlen(buf));
+    	}
+
+    	// the gate stays ours until notification_done()... without a timeout to wait with, do not wait for the acknowledgement
+    	this->m_notify_timeout_id = shared_event_queue()->call_in(STALL_NOTIFY_TIMEOUT_MS,_parking_stall_notification_timeout);
+    	if (this->m_notify_timeout_id == 0) {
+    		this->m_notify_in_flight = false;
+    		notification_scheduler()->end(NOTIFY_STATE);
+    	}
+    }
+
+    // the notification in flight was delivered (or we gave up waiting)... send the next (EVENT QUEUE)
+    void notification_done(int stall,bool delivered) {
+    	if (this->m_notify_in_flight == false || stall != this->m_notify_stall) {
+    		// late acknowledgement of a notification we already gave up on
+    		return;
+    	}
+    	if (delivered && this->m_notify_timeout_id != 0) {
+    		shared_event_queue()->cancel(this->m_notify_timeout_id);
+    	}
+    	this->m_notify_timeout_id = 0;
+    	this->m_notify_in_flight = false;
+    	notification_scheduler()->end(NOTIFY_STATE);
+    	this->notify_events();
+    }
+
+    // the notification gate was busy... try again (EVENT QUEUE)
+    void notify_retry() {
+    	this->m_notify_retry_scheduled = false;
+    	this->notify_events();
+    }
+
+    // the stall of the notification in flight (its timeout gives up on it)
+    int notify_stall() {
+    	return this->m_notify_stall;
+    }
     
 private:
-    // LED annunciations
-    void led_stall_empty() {
-    	parking_status_led_red(true);
-    	parking_status_led_yellow(false);
-    	parking_status_led_green(false);
-    }
-    void led_stall_arriving() {
-	parking_status_led_red(true);
-	parking_status_led_yellow(true);
-	parking_status_led_green(false);
+    // queue the current transition of a stall for notification
+    void publish_event(int stall) {
+    	stall_event_t event;
+    	event.seq = ++this->m_stalls.event_seq[stall];
+    	event.timestamp = time(NULL);
+    	event.count = this->m_stalls.counter[stall];
+    	event.stall = stall;
+    	event.state = (ParkingStallStates)this->m_stalls.state[stall];
+    	if (this->m_events.push(event) == false) {
+    		// the network has been stalled for STALL_EVENT_QUEUE_DEPTH transitions... the server sees the seq gap
+    		++this->m_dropped_events;
+    		this->logger()->log("ParkingStallOccupancyDetectorResource: transition queue full... dropped stall %d seq %lu (total dropped: %d)",stall,(unsigned long)event.seq,this->m_dropped_events);
+    		return;
+    	}
+    	this->notify_events();
     }
-    void led_stall_occupied() {
-	parking_status_led_red(true);
-	parking_status_led_yellow(false);
-	parking_status_led_green(false);
+
+    // the state of the meter as a whole (shared beacon, camera and LEDs): any OCCUPIED stall, else any ARRIVING, else any DEPARTING
+    ParkingStallStates meter_state() {
+    	bool arriving = false;
+    	bool departing = false;
+    	for(int stall=0;stall<NUM_PARKING_STALLS;++stall) {
+    		switch (this->m_stalls.state[stall]) {
+    			case STALL_OCCUPIED:
+    				return STALL_OCCUPIED;
+    			case STALL_ARRIVING:
+    				arriving = true;
+    				break;
+    			case STALL_DEPARTING:
+    				departing = true;
+    				break;
+    			default:
+    				break;
+    		}
+    	}
+    	if (arriving) {
+    		return STALL_ARRIVING;
+    	}
+    	return departing ? STALL_DEPARTING : STALL_EMPTY;
     }
-    void led_stall_departing() {
-	parking_status_led_red(true);
-	parking_status_led_yellow(true);
-	parking_status_led_green(false);
+
+    // LED annunciations
+    void led_stall(ParkingStallStates state) {
+    	parking_status_led_red(__stall_leds[state][0]);
+    	parking_status_led_yellow(__stall_leds[state][1]);
+    	parking_status_led_green(__stall_leds[state][2]);
     }
 
-    // get the latest range value
-    void get_range() {
-    	float new_range = __range_finder.read_m();
-    	this->m_movement = NO_MOVEMENT;
+    // get the latest (filtered) range value of a stall... false if the filter held the sample back as an outlier
+    bool get_range(int stall,const range_sample_t &sample) {
+    	float new_range = 0.0;
+    	if (this->m_filter[stall].filter(sample.range_m,sample.timestamp_us,new_range) == false) {
+    		return false;
+    	}
+
+    	// rate is over the actual time between samples (the ranging period may have just changed)
+    	float interval_s = (this->m_stalls.last_sample_us[stall] != 0) ? (sample.timestamp_us - this->m_stalls.last_sample_us[stall])/1000000.0 : this->get_wait_time(stall)/1000.0;
+    	this->m_stalls.last_sample_us[stall] = sample.timestamp_us;
+    	if (interval_s <= 0.0) {
+    		interval_s = this->get_wait_time(stall)/1000.0;
+    	}
+
+    	this->m_stalls.movement[stall] = NO_MOVEMENT;
+    	this->m_stalls.speed[stall] = 0.0;
     	if (new_range < 0) {
     		// ERROR: set everything to 0
-			this->m_last_range = DEFAULT_OUT_OF_RANGE;
-			this->m_range = DEFAULT_OUT_OF_RANGE;
+			this->m_stalls.last_range[stall] = DEFAULT_OUT_OF_RANGE;
+			this->m_stalls.range[stall] = DEFAULT_OUT_OF_RANGE;
     	}
     	else {
-			this->m_last_range = this->m_range;
-			this->m_range = new_range;
-			float rate_m_s = (this->m_range - this->m_last_range)/(this->get_wait_time()/1000.0);
+			this->m_stalls.last_range[stall] = this->m_stalls.range[stall];
+			this->m_stalls.range[stall] = new_range;
+			float rate_m_s = (this->m_stalls.range[stall] - this->m_stalls.last_range[stall])/interval_s;
 
-			if (this->m_last_range >= DEFAULT_OUT_OF_RANGE || this->m_range >= DEFAULT_OUT_OF_RANGE) {
+			if (this->m_stalls.last_range[stall] >= DEFAULT_OUT_OF_RANGE || this->m_stalls.range[stall] >= DEFAULT_OUT_OF_RANGE) {
 				// zero out
 				rate_m_s = 0.0;
 			}
 
-			float fabs_rate = fabs(rate_m_s);
-			if (fabs_rate > 0.0 && fabs_rate < this->m_min_rate) {
-				this->m_movement = NO_MOVEMENT;
-			}
-			if (rate_m_s >= DEFAULT_MOVEMENT_RATE_M_S) {
-				this->m_movement = OUT_OF_STALL;
-			}
-			else if (rate_m_s <= -(DEFAULT_MOVEMENT_RATE_M_S)) {
-				this->m_movement = INTO_STALL;
-			}
+			this->m_stalls.speed[stall] = fabs(rate_m_s);
+			this->m_stalls.movement[stall] = parking_stall_movement(rate_m_s,DEFAULT_MOVEMENT_RATE_M_S);
 
 			//
 			// now that we have movement... cap the range.. we can watch it move beyond max_range...
@@ -321,257 +734,182 @@ private:
 			//
 			if (new_range > this->m_range_end) {
 				// set everything to 0
-				this->m_last_range = DEFAULT_OUT_OF_RANGE;
-				this->m_range = DEFAULT_OUT_OF_RANGE;
+				this->m_stalls.last_range[stall] = DEFAULT_OUT_OF_RANGE;
+				this->m_stalls.range[stall] = DEFAULT_OUT_OF_RANGE;
 			}
     	}
         
         // DEBUG
-        //this->logger()->log("ParkingStallOccupancyDetectorResource: Range: %.1f",this->m_range);
+        //this->logger()->log("ParkingStallOccupancyDetectorResource: Range: %.1f",this->m_stalls.range[stall]);
+        return true;
     }
     
-    // create our status string
-    string create_status_string(ParkingStallStates status) {
+    // create the status string of a stall
+    string create_status_string(int stall,ParkingStallStates status) {
     	char buf[STATUS_STRING_LENGTH+1];
 		memset(buf,0,STATUS_STRING_LENGTH+1);
-		++this->m_counter;
-		sprintf(buf,"{\"count\":%d,\"state\":%d}",this->m_counter,(int)status);
+		++this->m_stalls.counter[stall];
+		sprintf(buf,"{\"count\":%d,\"state\":%d}",this->m_stalls.counter[stall],(int)status);
 		return string(buf);
     }
 
     // setup for an observation event
-    void enable_observation() {
-    	this->logger()->log("ParkingStallOccupancyDetectorResource: ENABLE observation...");
-    	this->m_perform_observation = true;
+    void enable_observation(int stall) {
+    	this->logger()->log("ParkingStallOccupancyDetectorResource: ENABLE observation (stall %d)...",stall);
+    	this->m_stalls.perform_observation[stall] = true;
     }
 
     // disable observation
-    void disable_observation() {
-    	this->logger()->log("ParkingStallOccupancyDetectorResource: DISABLE observation...");
-    	this->m_perform_observation = false;
+    void disable_observation(int stall) {
+    	this->logger()->log("ParkingStallOccupancyDetectorResource: DISABLE observation (stall %d)...",stall);
+    	this->m_stalls.perform_observation[stall] = false;
     }
 
-    // we are within our parking range
-    bool within_parking_range(float range) {
-    	bool is_parked = false;
-
-    	// create our range
-    	float plus_range = this->m_occupied_range + this->m_max_occupied_range_variance;
-    	float minus_range = 0.0; // make sure we dont bump the meter! this->m_occupied_range - this->m_max_occupied_range_variance;
-
-    	// see if our input range lies inbetwee the values
-    	if (range >= minus_range && range <= plus_range) {
-    		is_parked = true;
-    	}
-
-    	// return our parking range status
-    	return is_parked;
+    // discretize the (filtered) range and movement of a stall for the state machine
+    RangeClasses classify_range(int stall) {
+    	return parking_stall_range_class(this->m_stalls.range[stall],(MovementDirection)this->m_stalls.movement[stall],this->m_occupied_range,this->m_max_occupied_range_variance,this->m_max_range);
     }
 
-    // update our parking stall state
-    void parking_stall_state_transitioner() {
+    // update the state of a stall
+    void parking_stall_state_transitioner(int stall) {
 		// DEBUG
-		//this->logger()->log("ParkingStallOccupancyDetectorResource: Distance: %.2f m, state: %d move: %d",this->m_range,(int)this->m_state,(int)this->m_movement);
+		//this->logger()->log("ParkingStallOccupancyDetectorResource: Distance: %.2f m, state: %d move: %d",this->m_stalls.range[stall],(int)this->m_stalls.state[stall],(int)this->m_stalls.movement[stall]);
 
         // reset our observation state
-        this->m_perform_observation = false;
-        
-        // handle cases of suddenly out of range... just freeze at the current last known state...
-        if (this->m_range >= DEFAULT_OUT_OF_RANGE && this->m_state == STALL_EMPTY) {
-			// stall is still EMPTY
-			//this->logger()->log("ParkingStallOccupancyDetectorResource: Parking stall is EMPTY");
-			//this->logger()->log("EMPTY: Distance: %.2f m, state: %d move: %d",this->m_range,(int)this->m_state,(int)this->m_movement);
-		}
-        else if (this->m_range >= DEFAULT_OUT_OF_RANGE && this->m_state == STALL_ARRIVING) {
-			// stall is still ARRIVING
-			//this->logger()->log("ParkingStallOccupancyDetectorResource: Parking stall is ARRIVING");
-			//this->logger()->log("ARRIVING: Distance: %.2f m, state: %d move: %d",this->m_range,(int)this->m_state,(int)this->m_movement);
-
-		}
-        else if (this->m_range >= DEFAULT_OUT_OF_RANGE && this->m_state == STALL_DEPARTING) {
-			// stall is still DEPARTING
-			//this->logger()->log("ParkingStallOccupancyDetectorResource: Parking stall is DEPARTING");
-			//this->logger()->log("DEPARTING: Distance: %.2f m, state: %d move: %d",this->m_range,(int)this->m_state,(int)this->m_movement);
-		}
-        else if (this->m_range >= DEFAULT_OUT_OF_RANGE && this->m_state == STALL_OCCUPIED) {
-			// stall is still OCCUPIED
-			//this->logger()->log("ParkingStallOccupancyDetectorResource: Parking stall is OCCUPIED");
-			//this->logger()->log("OCCUPIED: Distance: %.2f m, state: %d move: %d",this->m_range,(int)this->m_state,(int)this->m_movement);
-		}
-
-        // we are not out of range...
-        else if (this->m_range < DEFAULT_OUT_OF_RANGE) {
-			// just moved out of our range of interest... so we are EMPTY now...
-			if (this->m_range > this->m_max_range) {
-				// stall has just turned EMPTY
-				this->logger()->log("ParkingStallOccupancyDetectorResource: Parking stall has just turned EMPTY");
-
-				// send an observation only if we are DEPARTING the slot...
-				if (this->m_state != STALL_EMPTY) {
-					this->m_state_change = true;
-				}
-
-				// set the stall to EMPTY
-				this->m_range = DEFAULT_OUT_OF_RANGE;
-				this->m_last_range = DEFAULT_OUT_OF_RANGE;
-				this->m_state = STALL_EMPTY;
-				this->m_movement = NO_MOVEMENT;
-				this->m_parking_stall_state_str = this->create_status_string(this->m_state);
-
-				// enable observation
-				this->enable_observation();
-
-				// turn the BLE beacon off
-				turn_beacon_off();
-
-				// slot is now EMPTY
-				this->led_stall_empty();
-
-				// back to low-rez pinging
-				this->m_wait_time = WAIT_TIME;
-				
-				// we are empty
-				__parking_stall_state = 0;
-			}
-
-			// we are within our allowed "parked" range
-			else if (this->within_parking_range(this->m_range)) {
-				// DEBUG
-				this->logger()->log("ParkingStallOccupancyDetectorResource: stall is now OCCUPIED...");
-
-				// state change if we are ARRIVING into the slot
-				if (this->m_state != STALL_OCCUPIED) {
-					this->m_state_change = true;
-				}
-
-				// set our range
-				this->m_range = this->m_occupied_range;
-				this->m_last_range = this->m_occupied_range;
-				this->m_state = STALL_OCCUPIED;
-				this->m_movement = NO_MOVEMENT;
-				this->m_parking_stall_state_str = this->create_status_string(this->m_state);
-
-				// turn the BLE beacon on
-				turn_beacon_on();
-
-				// generate an observation
-				this->enable_observation();
-
-				// slot is now OCCUPIED
-				this->led_stall_occupied();
-
-				// back to low-rez pinging
-				this->m_wait_time = WAIT_TIME;
-				
-				// we are occupied
-				__parking_stall_state = 1;
-			}
-
-			// our range lies in between our parking range and our max range... so look at the object rate change
-			else {
-				// DEBUG
-				//this->logger()->log("ParkingStallOccupancyDetectorResource: Distance: %.2f m, state: %d move: %d",this->m_range,(int)this->m_state,(int)this->m_movement);
-
-				// start high-rez pinging
-				this->m_wait_time = HREZ_WAIT_TIME;
-
-				//
-				// object detected in range.. we must determine the stall state
-				//
-				// ARRIVING
-				if (this->m_movement == INTO_STALL) {
-					// DEBUG
-					this->logger()->log("ParkingStallOccupancyDetectorResource: stall has ARRIVING car...");
-
-					// ARRIVING
-					this->m_state = STALL_ARRIVING;
-
-					// car is ARRIVING
-					this->led_stall_arriving();
-
-					// we are arriving
-					__parking_stall_state = 2;
-				}
-
-				// DEPARTING
-				else if (this->m_movement == OUT_OF_STALL) {
-					// DEBUG
-					this->logger()->log("ParkingStallOccupancyDetectorResource: stall has DEPARTING car...");
+        this->m_stalls.perform_observation[stall] = false;
+
+        // look up the transition
+        ParkingStallStates from = (ParkingStallStates)this->m_stalls.state[stall];
+        float range = this->m_stalls.range[stall];
+        const stall_transition_t *transition = &__stall_transitions[from][this->classify_range(stall)];
+        bool changed = (transition->next != from);
+        uint16_t actions = transition->actions;
+        if (transition->log != NULL) {
+        	this->logger()->log("ParkingStallOccupancyDetectorResource: stall %d: %s",stall,transition->log);
+        }
 
-					// DEPARTING
-					this->m_state = STALL_DEPARTING;
+        // range
+        if (actions & ACTION_RANGE_EMPTY) {
+        	this->m_stalls.range[stall] = DEFAULT_OUT_OF_RANGE;
+        	this->m_stalls.last_range[stall] = DEFAULT_OUT_OF_RANGE;
+        	this->m_stalls.movement[stall] = NO_MOVEMENT;
+        }
+        if (actions & ACTION_RANGE_PARKED) {
+        	this->m_stalls.range[stall] = this->m_occupied_range;
+        	this->m_stalls.last_range[stall] = this->m_occupied_range;
+        	this->m_stalls.movement[stall] = NO_MOVEMENT;
+        }
 
-					// car is DEPARTING
-					this->led_stall_departing();
+        // new state... every change goes into the history (ARRIVING/DEPARTING too)
+        this->m_stalls.state[stall] = (uint8_t)transition->next;
+        if (changed) {
+        	record_stall_transition(stall,(int)from,(int)transition->next,range);
+        }
 
-					// we are departing
-					__parking_stall_state = 3;
-				}
+        // observation: sent only once for each state change
+        if (actions & ACTION_OBSERVE) {
+        	if (changed) {
+        		this->m_stalls.state_change[stall] = true;
+        	}
+        	this->m_state_str[stall] = this->create_status_string(stall,transition->next);
+        	this->enable_observation(stall);
+        }
 
-				else {
-					// car is not moving... its stationary...
-					this->logger()->log("ParkingStallOccupancyDetectorResource: car is stationary...");
-				}
-			}
+#if ENABLE_V2_CAMERA
+        // OPTION: capture now... tagged with the status count the cloud is about to see
+        if ((actions & ACTION_CAMERA_CAPTURE) && DO_LOCAL_CAPTURE && changed) {
+        	camera_capture(this->m_stalls.counter[stall]);
         }
-        else {
-			// out of range - hence EMPTY
-        	this->logger()->log("ParkingStallOccupancyDetectorResource: stall is EMPTY (OUT of RANGE)");
+#endif
 
-        	// send an observation only if we are DEPARTING the slot...
-			if (this->m_state != STALL_EMPTY) {
-				this->m_state_change = true;
-			}
+        // the beacon, camera and LEDs are shared by the stalls: they follow the meter state
+        ParkingStallStates meter = this->meter_state();
 
-			// set the stall to EMPTY
-			this->m_range = DEFAULT_OUT_OF_RANGE;
-			this->m_last_range = DEFAULT_OUT_OF_RANGE;
-			this->m_state = STALL_EMPTY;
-			this->m_movement = NO_MOVEMENT;
-			this->m_parking_stall_state_str = this->create_status_string(this->m_state);
-			this->led_stall_empty();
+        // BLE beacon (off only once no stall is OCCUPIED)
+        if (actions & ACTION_BEACON_ON) {
+        	turn_beacon_on();
+        }
+        if ((actions & ACTION_BEACON_OFF) && meter != STALL_OCCUPIED) {
+        	turn_beacon_off();
+        }
 
-			// enable observation
-			this->enable_observation();
+#if ENABLE_V2_CAMERA
+        // camera power: warm up the camera so the capture happens with the sensor ready... no captures expected once every stall is EMPTY
+        if (actions & ACTION_CAMERA_WARM_UP) {
+        	camera_warm_up();
+        }
+        if ((actions & ACTION_CAMERA_POWER_DOWN) && meter == STALL_EMPTY) {
+        	camera_power_down();
+        }
+#endif
 
-			// slot is now EMPTY
-			this->led_stall_empty();
+        // LEDs
+        if (actions & ACTION_LEDS) {
+        	this->led_stall(meter);
+        }
 
-			// turn the BLE beacon off
-			turn_beacon_off();
+        // ranging rate: fast while a car is moving in the stall (the scheduler picks the period)... never backs off out of ARRIVING or DEPARTING
+        this->m_stalls.sampling_active[stall] = ((actions & ACTION_RATE_HIGH) != 0) || transition->next == STALL_ARRIVING || transition->next == STALL_DEPARTING;
 
-			// back to low-rez pinging
-			this->m_wait_time = WAIT_TIME;
+        // publish our state
+        if (actions & ACTION_PUBLISH_STATE) {
+        	__parking_stall_state = (int)meter;
         }
     }
 };
 
-// update our parking stall state (THREAD)
-void _update_parking_stall_state(const void *args) {
-	int wait_time = WAIT_TIME;
+// start ranging (EVENT QUEUE)
+extern "C" void _start_parking_stall_ranging(void) {
+	if (_instance != NULL) {
+		((ParkingStallOccupancyDetectorResource *)_instance)->start_ranging();
+	}
+}
 
-	// wait a bit initially
-	Thread::wait(4*wait_time);
+// update our parking stall states from the waiting range samples (EVENT QUEUE)
+extern "C" void _process_parking_stall_range_samples(void) {
+	if (_instance != NULL) {
+		((ParkingStallOccupancyDetectorResource *)_instance)->process_range_samples();
+	}
+}
 
-	// loop forever...
-    while (true) {
-        if (_instance != NULL) {
-            // update our parking stall state
-            ((ParkingStallOccupancyDetectorResource *)_instance)->update_parking_stall_state();
+// apply a PUT configuration to the per stall stages (EVENT QUEUE)
+extern "C" void _apply_parking_stall_config(void) {
+	if (_instance != NULL) {
+		((ParkingStallOccupancyDetectorResource *)_instance)->apply_config();
+	}
+}
 
-            // update the wait time
-            wait_time = ((ParkingStallOccupancyDetectorResource *)_instance)->get_wait_time();
-        }
-        
-        // wait a bit and look again...
-        Thread::wait(wait_time);
-    }
+// notification of a stall delivered... continue on the event queue
+static void __parking_stall_notification_delivered(int stall) {
+	if (_instance != NULL) {
+		((ParkingStallOccupancyDetectorResource *)_instance)->notification_done(stall,true);
+	}
 }
 
-// reset the observation latch
-extern "C" void reset_observation_latch()  {
-    __observation_latch = true;
+// notification of a stall delivered (mbed-client callback)
+static void __parking_stall_notification_sent(int stall) {
+	if (stall < NUM_PARKING_STALLS) {
+		shared_event_queue()->call(__parking_stall_notification_delivered,stall);
+	}
+}
+extern "C" void _parking_stall_0_notification_sent(void) { __parking_stall_notification_sent(0); }
+extern "C" void _parking_stall_1_notification_sent(void) { __parking_stall_notification_sent(1); }
+extern "C" void _parking_stall_2_notification_sent(void) { __parking_stall_notification_sent(2); }
+extern "C" void _parking_stall_3_notification_sent(void) { __parking_stall_notification_sent(3); }
+
+// notification gate was busy (EVENT QUEUE)
+extern "C" void _parking_stall_notify_retry(void) {
+	if (_instance != NULL) {
+		((ParkingStallOccupancyDetectorResource *)_instance)->notify_retry();
+	}
 }
 
+// notification not acknowledged in time (EVENT QUEUE)
+extern "C" void _parking_stall_notification_timeout(void) {
+	if (_instance != NULL) {
+		ParkingStallOccupancyDetectorResource *detector = (ParkingStallOccupancyDetectorResource *)_instance;
+		detector->notification_done(detector->notify_stall(),false);
+	}
+}
 
 #endif // __PARKING_STALL_OCCUPANCY_DETECTOR_RESOURCE_H__
@@ -0,0 +1,141 @@
+/**
+ * @file    Base64StreamEncoderBenchmark.cpp
+ * @brief   host micro-benchmark: streaming Base64 encoder vs the legacy whole-image Base64::Encode() (throughput, allocations)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// host checks
+#include "HostTest.h"
+#include "HeapCounter.h"
+#include "LegacyBase64.h"
+
+// streaming Base64 encoder
+#include "Base64StreamEncoder.h"
+
+// benchmark images: a preview, a typical and a full 160x120 capture
+static const int __image_lengths[] = { 1200, 5000, 5192 };
+#define NUM_IMAGE_LENGTHS       ((int)(sizeof(__image_lengths) / sizeof(int)))
+#define MAX_IMAGE_LENGTH        5192
+#define MAX_ENCODED_LENGTH      (((MAX_IMAGE_LENGTH + 2) / 3) * 4)
+
+// camera read block (slices fed to encode()) and chunk length (encode_range())
+#define READ_BLOCK_SIZE         512
+#define CHUNK_LENGTH            225
+
+// repetitions of each measurement
+#define ITERATIONS              2000
+
+// one measurement
+typedef struct {
+    double      ns_per_image;
+    double      mb_per_sec;
+    double      allocations_per_image;
+    long        peak_heap;
+} measurement_t;
+
+static uint8_t __image[MAX_IMAGE_LENGTH];
+static char __out[MAX_ENCODED_LENGTH + 8];
+
+// legacy: Base64::Encode() the whole capture, then free()
+static void legacy_encode(int length) {
+    size_t out_length = 0;
+    char *out = legacy_base64_encode(__image,length,&out_length,heap_counted_malloc);
+    SINK(out[out_length / 2]);
+    heap_counted_free(out);
+}
+
+// streaming: the capture arrives in read blocks... encode() into a caller buffer
+static void stream_encode(int length) {
+    Base64StreamEncoder encoder;
+    int written = 0;
+    for(int offset=0;offset<length;) {
+        int in_length = (length - offset < READ_BLOCK_SIZE) ? length - offset : READ_BLOCK_SIZE;
+        int consumed = 0;
+        written += encoder.encode(__image + offset,in_length,__out + written,(int)sizeof(__out) - written,&consumed);
+        offset += consumed;
+    }
+    written += encoder.finish(__out + written,(int)sizeof(__out) - written);
+    SINK(__out[written / 2]);
+}
+
+// chunk views: each observation payload encoded on demand into one chunk buffer
+static void range_encode(int length) {
+    static char chunk[CHUNK_LENGTH + 1];
+    Base64StreamEncoder encoder;
+    int encoded_length = Base64StreamEncoder::encoded_length(length);
+    for(int begin=0;begin<encoded_length;begin+=CHUNK_LENGTH) {
+        SINK(encoder.encode_range(__image,length,begin,begin + CHUNK_LENGTH,chunk));
+    }
+}
+
+static measurement_t measure(void (*encode)(int),int length) {
+    measurement_t result;
+    encode(length);
+    heap_counter_reset();
+    double start = host_time_ns();
+    for(int i=0;i<ITERATIONS;++i) {
+        encode(length);
+    }
+    double elapsed = host_time_ns() - start;
+    result.ns_per_image = elapsed / ITERATIONS;
+    result.mb_per_sec = (length / 1e6) / (result.ns_per_image / 1e9);
+    result.allocations_per_image = (double)heap_allocations() / ITERATIONS;
+    result.peak_heap = heap_peak_bytes();
+    return result;
+}
+
+static void report(const char *name,int length,const measurement_t &m) {
+    printf("%-28s %5d bytes: %9.0f ns/image %8.1f MB/s %5.2f allocations/image peak heap %6ld bytes\n",
+            name,length,m.ns_per_image,m.mb_per_sec,m.allocations_per_image,m.peak_heap);
+}
+
+int main() {
+    srand(5);
+    for(int i=0;i<MAX_IMAGE_LENGTH;++i) {
+        __image[i] = (uint8_t)(rand() & 0xFF);
+    }
+    for(int i=0;i<NUM_IMAGE_LENGTHS;++i) {
+        int length = __image_lengths[i];
+
+        // same output first
+        size_t legacy_length = 0;
+        char *legacy = legacy_base64_encode(__image,length,&legacy_length);
+        stream_encode(length);
+        CHECK_EQUAL(legacy_length,Base64StreamEncoder::encoded_length(length));
+        CHECK(memcmp(legacy,__out,legacy_length) == 0);
+        free(legacy);
+
+        measurement_t m_legacy = measure(legacy_encode,length);
+        measurement_t m_stream = measure(stream_encode,length);
+        measurement_t m_range = measure(range_encode,length);
+        report("legacy Base64::Encode",length,m_legacy);
+        report("stream encode() 512 B slices",length,m_stream);
+        report("encode_range() 225 chunks",length,m_range);
+
+        // the point of the encoder: no heap at all
+        CHECK(m_legacy.allocations_per_image >= 1.0);
+        CHECK(m_stream.allocations_per_image == 0.0);
+        CHECK(m_range.allocations_per_image == 0.0);
+        CHECK_EQUAL(0,m_stream.peak_heap);
+        CHECK_EQUAL(0,m_range.peak_heap);
+    }
+    return host_test_result("Base64StreamEncoderBenchmark");
+}
@@ -0,0 +1,167 @@
+/**
+ * @file    BlockwiseTransferBenchmark.cpp
+ * @brief   host benchmark: time-to-last-byte of one image as chunked observations vs a CoAP Block2 GET
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// host checks
+#include "HostTest.h"
+#include "SimulatedLink.h"
+
+// pacer (chunked mode)
+#include "ObservationPacer.h"
+
+// the same 5 KB capture in both modes: 6828 base64 characters
+#define IMAGE_ENCODED_LENGTH        6828
+
+// chunked: 225 character observations (CameraResource PREFERRED_MESSAGE_LEN)... then END
+#define CHUNK_LENGTH                225
+#define END_LENGTH                  3
+
+// blockwise: one "image ready" observation, then the server GETs SN_COAP_MAX_BLOCKWISE_PAYLOAD_SIZE blocks (mbed_client_config.h)
+#define READY_LENGTH                60
+#define BLOCK_LENGTH                1024
+
+// every message also carries its CoAP header, token and options plus UDP/IPv4 headers (bytes)
+#define MESSAGE_OVERHEAD            48
+
+// the CoAP stand-in... same links as ObservationPacerTest (the Block2 GETs are driven by the server, so no callbacks needed)
+static const link_profile_t __links[] = {
+    { "ethernet",          20, 100000,  0, true  },
+    { "ethernet 5% loss",  20, 100000,  5, true  },
+    { "cellular",         300,   2000,  0, true  },
+    { "cellular 10% loss",300,   2000, 10, true  },
+    { "cellular 25% loss",300,   2000, 25, true  }
+};
+#define NUM_LINKS       ((int)(sizeof(__links) / sizeof(link_profile_t)))
+
+// outcome of one image transfer (from the image being ready on the device)
+typedef struct {
+    int         last_byte_ms;       // the last image byte reached the server
+    int         complete_ms;        // the server has everything it needs (chunked: END... blockwise: the last block)
+    int         messages;
+    int         transmissions;
+    int         lost;
+} transfer_t;
+
+// notification delivery callback
+static void pacer_delivered(void *context) {
+    ((ObservationPacer *)context)->delivered();
+}
+
+// when observation "index" reached the server: its acknowledgement is one latency later
+static int arrival_ms(SimulatedLink &link,int index,const link_profile_t &profile,uint64_t start_us) {
+    uint64_t delivered_us = link.delivery_us(index);
+    if (delivered_us == 0) {
+        return -1;
+    }
+    return (int)((delivered_us - start_us) / 1000) - profile.latency_ms;
+}
+
+// chunked (USE_BLOCKWISE_TRANSFER false): CameraResource::stream_observations()... each observation waits for a credit
+static transfer_t chunked_transfer(const link_profile_t &profile,unsigned seed) {
+    transfer_t result;
+    memset(&result,0,sizeof(result));
+    int chunks = (IMAGE_ENCODED_LENGTH + CHUNK_LENGTH - 1) / CHUNK_LENGTH;
+    ObservationPacer pacer(1);
+    SimulatedLink link(profile,seed,pacer_delivered,&pacer);
+    uint64_t start_us = host_clock_us();
+    pacer.begin();
+    for(int i=0;i<=chunks;++i) {
+        pacer.acquire();
+        int remaining = IMAGE_ENCODED_LENGTH - i * CHUNK_LENGTH;
+        int length = (i == chunks) ? END_LENGTH : ((remaining < CHUNK_LENGTH) ? remaining : CHUNK_LENGTH);
+        link.send(length + MESSAGE_OVERHEAD);
+        pacer.sent(length);
+    }
+    pacer.end();
+    host_clock_run_until(host_clock_us() + 120000000ULL);
+    result.last_byte_ms = arrival_ms(link,chunks - 1,profile,start_us);
+    result.complete_ms = arrival_ms(link,chunks,profile,start_us);
+    result.messages = link.sent();
+    result.transmissions = link.transmissions();
+    result.lost = link.lost();
+    return result;
+}
+
+// blockwise (USE_BLOCKWISE_TRANSFER true): the server GETs the next block as each one arrives
+typedef struct {
+    SimulatedLink  *link;
+    int             next_block;
+    int             blocks;
+} blockwise_t;
+
+static int block_length(int block) {
+    int remaining = IMAGE_ENCODED_LENGTH - block * BLOCK_LENGTH;
+    return (remaining < BLOCK_LENGTH) ? remaining : BLOCK_LENGTH;
+}
+
+// the acknowledgement of a message comes back when the server's next GET does: the next block goes out then
+static void block_delivered(void *context) {
+    blockwise_t *transfer = (blockwise_t *)context;
+    if (transfer->next_block < transfer->blocks) {
+        int block = transfer->next_block++;
+        transfer->link->send(block_length(block) + MESSAGE_OVERHEAD);
+    }
+}
+
+static transfer_t blockwise_transfer(const link_profile_t &profile,unsigned seed) {
+    transfer_t result;
+    memset(&result,0,sizeof(result));
+    blockwise_t transfer;
+    transfer.next_block = 0;
+    transfer.blocks = (IMAGE_ENCODED_LENGTH + BLOCK_LENGTH - 1) / BLOCK_LENGTH;
+    link_profile_t server = profile;
+    server.callbacks = true;
+    SimulatedLink link(server,seed,block_delivered,&transfer,1);
+    transfer.link = &link;
+    uint64_t start_us = host_clock_us();
+    link.send(READY_LENGTH + MESSAGE_OVERHEAD);
+    host_clock_run_until(host_clock_us() + 120000000ULL);
+    result.last_byte_ms = (transfer.next_block == transfer.blocks) ? arrival_ms(link,transfer.blocks,profile,start_us) : -1;
+    result.complete_ms = result.last_byte_ms;
+    result.messages = link.sent();
+    result.transmissions = link.transmissions();
+    result.lost = link.lost();
+    return result;
+}
+
+int main() {
+    printf("%-18s %-9s %14s %13s %9s %4s %5s\n","link","mode","last byte (ms)","complete (ms)","messages","tx","lost");
+    for(int l=0;l<NUM_LINKS;++l) {
+        const link_profile_t &profile = __links[l];
+        host_clock_reset();
+        transfer_t chunked = chunked_transfer(profile,1234 + l);
+        host_clock_reset();
+        transfer_t blockwise = blockwise_transfer(profile,1234 + l);
+        printf("%-18s %-9s %14d %13d %9d %4d %5d\n",profile.name,"chunked",chunked.last_byte_ms,chunked.complete_ms,chunked.messages,chunked.transmissions,chunked.lost);
+        printf("%-18s %-9s %14d %13d %9d %4d %5d\n",profile.name,"blockwise",blockwise.last_byte_ms,blockwise.complete_ms,blockwise.messages,blockwise.transmissions,blockwise.lost);
+
+        // the same image: 1 + 7 blockwise messages against 31 chunks and END
+        CHECK_EQUAL(1 + (IMAGE_ENCODED_LENGTH + BLOCK_LENGTH - 1) / BLOCK_LENGTH,blockwise.messages);
+        CHECK_EQUAL(1 + (IMAGE_ENCODED_LENGTH + CHUNK_LENGTH - 1) / CHUNK_LENGTH,chunked.messages);
+        if (profile.loss_percent == 0) {
+            // a clean link: both complete... the round trips per image decide it
+            CHECK(chunked.last_byte_ms > 0 && chunked.complete_ms > chunked.last_byte_ms);
+            CHECK(blockwise.last_byte_ms > 0);
+            CHECK(blockwise.complete_ms < chunked.complete_ms);
+        }
+    }
+    return host_test_result("BlockwiseTransferBenchmark");
+}
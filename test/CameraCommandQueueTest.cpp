@@ -0,0 +1,137 @@
+/**
+ * @file    CameraCommandQueueTest.cpp
+ * @brief   host test: queued camera commands carry their own resend chunk lists (back to back resend PUTs for different images)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// host checks
+#include "HostTest.h"
+
+// command queue
+#include "CameraCommandQueue.h"
+
+#define NUM_ELEMENTS(a)     ((int)(sizeof(a) / sizeof(a[0])))
+
+// check a dequeued RESEND against the request
+static void check_resend(const camera_command_t &command,int img,const uint16_t *chunks,int num_chunks) {
+    CHECK_EQUAL(CAMERA_CMD_RESEND,command.cmd);
+    CHECK_EQUAL(img,command.img);
+    CHECK_EQUAL(num_chunks,command.num_chunks);
+    for(int i=0;i<num_chunks && i<command.num_chunks;++i) {
+        CHECK_EQUAL(chunks[i],command.chunks[i]);
+    }
+}
+
+// two resend PUTs for different images arrive before the streamer runs: each resend keeps its own image and chunks
+static void test_back_to_back_resends() {
+    host_clock_reset();
+    CameraCommandQueue streamer;
+    static const uint16_t first[] = { 1, 4, 7 };
+    static const uint16_t second[] = { 0, 2, 5, 9, 30 };
+
+    // CameraResource::put() twice (the streamer is busy with a stream)
+    CHECK(streamer.put(CAMERA_CMD_STREAM,0,12));
+    CHECK(streamer.put(CAMERA_CMD_RESEND,0,10,first,NUM_ELEMENTS(first)));
+    CHECK(streamer.put(CAMERA_CMD_RESEND,0,11,second,NUM_ELEMENTS(second)));
+
+    // the streamer gets to them in order
+    camera_command_t command;
+    CHECK(streamer.get(&command,0));
+    CHECK_EQUAL(CAMERA_CMD_STREAM,command.cmd);
+    CHECK_EQUAL(12,command.img);
+    CHECK_EQUAL(0,command.num_chunks);
+    CHECK(streamer.get(&command,0));
+    check_resend(command,10,first,NUM_ELEMENTS(first));
+    CHECK(streamer.get(&command,0));
+    check_resend(command,11,second,NUM_ELEMENTS(second));
+    CHECK(streamer.get(&command,0) == false);
+
+    // a resend of the first image again, with a shorter list, does not inherit the longer one
+    static const uint16_t again[] = { 3 };
+    CHECK(streamer.put(CAMERA_CMD_RESEND,0,11,second,NUM_ELEMENTS(second)));
+    CHECK(streamer.put(CAMERA_CMD_RESEND,0,10,again,NUM_ELEMENTS(again)));
+    CHECK(streamer.get(&command,0));
+    check_resend(command,11,second,NUM_ELEMENTS(second));
+    CHECK(streamer.get(&command,0));
+    check_resend(command,10,again,NUM_ELEMENTS(again));
+
+    // an empty list is an END only resend
+    CHECK(streamer.put(CAMERA_CMD_RESEND,0,9,NULL,0));
+    CHECK(streamer.get(&command,0));
+    CHECK_EQUAL(9,command.img);
+    CHECK_EQUAL(0,command.num_chunks);
+}
+
+// a request longer than MAX_RESEND_CHUNKS is clipped
+static void test_clipped_resend() {
+    CameraCommandQueue streamer;
+    uint16_t chunks[MAX_RESEND_CHUNKS + 8];
+    for(int i=0;i<NUM_ELEMENTS(chunks);++i) {
+        chunks[i] = (uint16_t)(i * 3);
+    }
+    CHECK(streamer.put(CAMERA_CMD_RESEND,0,5,chunks,NUM_ELEMENTS(chunks)));
+    camera_command_t command;
+    CHECK(streamer.get(&command,0));
+    check_resend(command,5,chunks,MAX_RESEND_CHUNKS);
+}
+
+// bounded: a full queue refuses the command... a dequeued command frees its entry before it runs
+static void test_bounded() {
+    host_clock_reset();
+    CameraCommandQueue streamer;
+    uint16_t chunk = 0;
+    for(int i=0;i<CAMERA_COMMAND_QUEUE_DEPTH;++i) {
+        chunk = (uint16_t)i;
+        CHECK(streamer.put(CAMERA_CMD_RESEND,0,i,&chunk,1));
+    }
+    CHECK(streamer.put(CAMERA_CMD_HISTORY) == false);
+
+    // dispatching the first one: its entry is already free
+    camera_command_t command;
+    CHECK(streamer.get(&command,0));
+    CHECK(streamer.put(CAMERA_CMD_SELECT,7,3));
+    CHECK(streamer.put(CAMERA_CMD_HISTORY) == false);
+    chunk = 0;
+    check_resend(command,0,&chunk,1);
+
+    // FIFO
+    for(int i=1;i<CAMERA_COMMAND_QUEUE_DEPTH;++i) {
+        chunk = (uint16_t)i;
+        CHECK(streamer.get(&command,0));
+        check_resend(command,i,&chunk,1);
+    }
+    CHECK(streamer.get(&command,0));
+    CHECK_EQUAL(CAMERA_CMD_SELECT,command.cmd);
+    CHECK_EQUAL(7,command.arg);
+    CHECK_EQUAL(3,command.img);
+
+    // empty: a timed wait runs out
+    uint64_t start_us = host_clock_us();
+    CHECK(streamer.get(&command,100) == false);
+    CHECK(host_clock_us() - start_us <= 100000ULL);
+}
+
+int main() {
+    test_back_to_back_resends();
+    test_clipped_resend();
+    test_bounded();
+    return host_test_result("CameraCommandQueueTest");
+}
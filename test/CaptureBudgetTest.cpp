@@ -0,0 +1,248 @@
+/**
+ * @file    CaptureBudgetTest.cpp
+ * @brief   host test: the capture budget only follows full image transfers, and a slot sized picture keeps its resolution with gzip on
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// host checks
+#include "HostTest.h"
+#include "SimulatedLink.h"
+
+// pacer, budget and gzip
+#include "ObservationPacer.h"
+#include "CaptureBudget.h"
+#include "GzipStreamCompressor.h"
+
+// CameraResource defaults
+#define MAX_CAMERA_BUFFER_SIZE      5192
+#define CAMERA_TRANSFER_BUDGET_MS   30000
+#define CHUNK_LENGTH                225
+#define END_LENGTH                  3
+#define UNCHANGED_LENGTH            40
+#define CAMERA_READ_BLOCK_SIZE      512
+
+// host workspace: zlib's structures are larger with 64 bit pointers than on the K64F
+#define HOST_WORKSPACE_SIZE         (2 * GZIP_WORKSPACE_SIZE(GZIP_WINDOW_BITS,GZIP_MEM_LEVEL))
+
+// picture sizes of one scene at 640x480, 320x240, 160x120 and 80x60 (CameraResource __camera_resolutions)
+static const uint32_t __picture_sizes[] = { 21000, 10500, 5000, 1600 };
+#define NUM_RESOLUTIONS             ((int)(sizeof(__picture_sizes) / sizeof(uint32_t)))
+#define PREFERRED_RESOLUTION        2           // 160x120
+
+// links
+static const link_profile_t __cellular = { "cellular", 300, 2000, 0, true };
+static const link_profile_t __slow = { "slow cellular", 600, 400, 0, true };
+
+// notification delivery callback
+static void pacer_delivered(void *context) {
+    ((ObservationPacer *)context)->delivered();
+}
+
+// CameraResource::take_picture(): resolution chosen for the scene (GZIP: the slot must hold the worst case stream)
+static int capture_resolution(CaptureBudget &budget,const uint32_t *sizes = __picture_sizes,bool gzip = false) {
+    int resolution = PREFERRED_RESOLUTION;
+    while (resolution < NUM_RESOLUTIONS) {
+        bool last = (resolution == NUM_RESOLUTIONS - 1);
+        uint32_t stored_length = gzip ? GzipStreamCompressor::bound(sizes[resolution]) : sizes[resolution];
+        if (budget.fits(sizes[resolution],stored_length,last)) {
+            return resolution;
+        }
+        if (last) {
+            return -1;
+        }
+        ++resolution;
+    }
+    return -1;
+}
+
+// a paced transfer of "encoded_length" chunked characters then END (encoded_length 0: one observation of END_LENGTH... END only)
+static int paced_transfer(ObservationPacer &pacer,const link_profile_t &profile,int encoded_length,int last_length) {
+    SimulatedLink link(profile,1,pacer_delivered,&pacer);
+    pacer.begin();
+    for(int offset=0;offset<encoded_length;offset+=CHUNK_LENGTH) {
+        int length = (encoded_length - offset < CHUNK_LENGTH) ? (encoded_length - offset) : CHUNK_LENGTH;
+        pacer.acquire();
+        link.send(length);
+        pacer.sent(length);
+    }
+    pacer.acquire();
+    link.send(last_length);
+    pacer.sent(last_length);
+    pacer.end();
+    host_clock_run_until(host_clock_us() + 120000000ULL);
+    return pacer.bytes_per_sec();
+}
+
+// base64 characters of a picture
+static int encoded_length(uint32_t picture_length) {
+    return (int)(((picture_length + 2) / 3) * 4);
+}
+
+// the link budget of a single (unsmoothed) throughput sample
+static uint32_t sample_budget(int bytes_per_sec) {
+    CaptureBudget budget(MAX_CAMERA_BUFFER_SIZE,CAMERA_TRANSFER_BUDGET_MS,true);
+    budget.transfer(CAPTURE_TRANSFER_IMAGE,bytes_per_sec);
+    return budget.budget();
+}
+
+// no sample yet: the configured resolution (only the slot bounds it)
+static void test_no_sample() {
+    CaptureBudget budget(MAX_CAMERA_BUFFER_SIZE,CAMERA_TRANSFER_BUDGET_MS,true);
+    CHECK_EQUAL(0,budget.bytes_per_sec());
+    CHECK_EQUAL(MAX_CAMERA_BUFFER_SIZE,budget.budget());
+    CHECK_EQUAL(PREFERRED_RESOLUTION,capture_resolution(budget));
+
+    // short transfers are not samples
+    budget.transfer(CAPTURE_TRANSFER_END,10);
+    budget.transfer(CAPTURE_TRANSFER_UNCHANGED,20);
+    budget.transfer(CAPTURE_TRANSFER_RESEND,30);
+    budget.transfer(CAPTURE_TRANSFER_PREVIEW,40);
+    budget.transfer(CAPTURE_TRANSFER_IMAGE,0);
+    CHECK_EQUAL(0,budget.bytes_per_sec());
+    CHECK_EQUAL(PREFERRED_RESOLUTION,capture_resolution(budget));
+
+    // the slot still bounds every capture... the smallest resolution only has to fit it
+    CHECK(budget.fits(MAX_CAMERA_BUFFER_SIZE,MAX_CAMERA_BUFFER_SIZE,false));
+    CHECK(budget.fits(MAX_CAMERA_BUFFER_SIZE + 1,MAX_CAMERA_BUFFER_SIZE + 1,false) == false);
+    CHECK(budget.fits(MAX_CAMERA_BUFFER_SIZE + 1,MAX_CAMERA_BUFFER_SIZE + 1,true) == false);
+}
+
+// an image over the cellular link, then an "unchanged" observation: the next capture keeps 160x120
+static void test_unchanged_then_capture() {
+    host_clock_reset();
+    ObservationPacer pacer;
+    CaptureBudget budget(MAX_CAMERA_BUFFER_SIZE,CAMERA_TRANSFER_BUDGET_MS,true);
+
+    int image_bps = paced_transfer(pacer,__cellular,encoded_length(__picture_sizes[PREFERRED_RESOLUTION]),END_LENGTH);
+    budget.transfer(CAPTURE_TRANSFER_IMAGE,image_bps);
+    CHECK_EQUAL(image_bps,budget.bytes_per_sec());
+    CHECK_EQUAL(PREFERRED_RESOLUTION,capture_resolution(budget));
+
+    // duplicate suppression: one short observation... acknowledgement latency, not the link rate
+    int unchanged_bps = paced_transfer(pacer,__cellular,0,UNCHANGED_LENGTH);
+    budget.transfer(CAPTURE_TRANSFER_UNCHANGED,unchanged_bps);
+    printf("image: %d bytes/sec unchanged: %d bytes/sec (budget of that sample: %d bytes)\n",image_bps,unchanged_bps,(int)sample_budget(unchanged_bps));
+
+    // the raw last transfer would have forced 80x60... the image average keeps the resolution
+    CHECK(sample_budget(unchanged_bps) < __picture_sizes[PREFERRED_RESOLUTION]);
+    CHECK_EQUAL(image_bps,budget.bytes_per_sec());
+    CHECK_EQUAL(PREFERRED_RESOLUTION,capture_resolution(budget));
+
+    // a resend of two chunks and an END only transfer do not move it either
+    int resend_bps = paced_transfer(pacer,__cellular,2 * CHUNK_LENGTH,END_LENGTH);
+    budget.transfer(CAPTURE_TRANSFER_RESEND,resend_bps);
+    int end_bps = paced_transfer(pacer,__cellular,0,END_LENGTH);
+    budget.transfer(CAPTURE_TRANSFER_END,end_bps);
+    CHECK_EQUAL(image_bps,budget.bytes_per_sec());
+    CHECK_EQUAL(PREFERRED_RESOLUTION,capture_resolution(budget));
+}
+
+// steady state legacy pacing (225 characters every 750 ms: 300 bytes/sec) keeps a ~5 KB 160x120 frame
+static void test_legacy_steady_state() {
+    CaptureBudget budget(MAX_CAMERA_BUFFER_SIZE,CAMERA_TRANSFER_BUDGET_MS,true);
+    for(int i=0;i<20;++i) {
+        budget.transfer(CAPTURE_TRANSFER_IMAGE,300);
+        CHECK_EQUAL(PREFERRED_RESOLUTION,capture_resolution(budget));
+    }
+    CHECK_EQUAL(300,budget.bytes_per_sec());
+}
+
+// the average follows a slower link over a few images... and a single slow image does not downgrade
+static void test_smoothing() {
+    host_clock_reset();
+    ObservationPacer pacer;
+    CaptureBudget budget(MAX_CAMERA_BUFFER_SIZE,CAMERA_TRANSFER_BUDGET_MS,true);
+    int fast_bps = 0;
+    for(int i=0;i<4;++i) {
+        fast_bps = paced_transfer(pacer,__cellular,encoded_length(__picture_sizes[PREFERRED_RESOLUTION]),END_LENGTH);
+        budget.transfer(CAPTURE_TRANSFER_IMAGE,fast_bps);
+    }
+    budget.transfer(CAPTURE_TRANSFER_IMAGE,fast_bps / 20);
+    CHECK(budget.bytes_per_sec() > (fast_bps * 3) / 4);
+    CHECK_EQUAL(PREFERRED_RESOLUTION,capture_resolution(budget));
+
+    // the link really slowed down: 80x60 within a few images
+    int images = 0;
+    while (capture_resolution(budget) == PREFERRED_RESOLUTION && images < 50) {
+        int slow_bps = paced_transfer(pacer,__slow,encoded_length(__picture_sizes[NUM_RESOLUTIONS - 1]),END_LENGTH);
+        budget.transfer(CAPTURE_TRANSFER_IMAGE,slow_bps);
+        ++images;
+    }
+    printf("slow link: 80x60 after %d images (%d bytes/sec)\n",images,budget.bytes_per_sec());
+    CHECK(images > 1 && images < 20);
+    CHECK_EQUAL(NUM_RESOLUTIONS - 1,capture_resolution(budget));
+}
+
+// GZIP: a slot sized JPEG keeps its resolution... and its worst case stream really fits the slot
+static void test_gzip_slot() {
+    static const uint32_t slot_sized[] = { 21000, 10500, MAX_CAMERA_BUFFER_SIZE, 1600 };
+    static uint8_t workspace[HOST_WORKSPACE_SIZE];
+    static uint8_t picture[MAX_CAMERA_BUFFER_SIZE];
+    static uint8_t slot[GZIP_BOUND(MAX_CAMERA_BUFFER_SIZE) + 1];
+
+    // the slot is sized at compile time
+    CHECK_EQUAL(GzipStreamCompressor::bound(MAX_CAMERA_BUFFER_SIZE),GZIP_BOUND(MAX_CAMERA_BUFFER_SIZE));
+
+    // a slot of MAX_CAMERA_BUFFER_SIZE downgraded it for the framing alone
+    CaptureBudget unsized(MAX_CAMERA_BUFFER_SIZE,CAMERA_TRANSFER_BUDGET_MS,true);
+    CHECK_EQUAL(NUM_RESOLUTIONS - 1,capture_resolution(unsized,slot_sized,true));
+    CaptureBudget sized(GZIP_BOUND(MAX_CAMERA_BUFFER_SIZE),CAMERA_TRANSFER_BUDGET_MS,true);
+    CHECK_EQUAL(PREFERRED_RESOLUTION,capture_resolution(sized,slot_sized,true));
+    CHECK_EQUAL(PREFERRED_RESOLUTION,capture_resolution(sized,slot_sized,false));
+
+    // ... and with a link sample that carries the picture
+    sized.transfer(CAPTURE_TRANSFER_IMAGE,300);
+    CHECK_EQUAL(PREFERRED_RESOLUTION,capture_resolution(sized,slot_sized,true));
+
+    // entropy coded scan data is incompressible: the stream still fits at every level (read block by block, as the camera does)
+    unsigned seed = 7;
+    for(uint32_t i=0;i<sizeof(picture);++i) {
+        seed = seed * 1103515245u + 12345u;
+        picture[i] = (uint8_t)(seed >> 16);
+    }
+    GzipStreamCompressor gzip(workspace,sizeof(workspace));
+    for(int level=0;level<=9;++level) {
+        gzip.set_level(level);
+        memset(slot,0xA5,sizeof(slot));
+        CHECK(gzip.begin(slot,GZIP_BOUND(MAX_CAMERA_BUFFER_SIZE)));
+        bool ok = true;
+        for(uint32_t offset=0;ok && offset<sizeof(picture);offset+=CAMERA_READ_BLOCK_SIZE) {
+            uint32_t length = (sizeof(picture) - offset < CAMERA_READ_BLOCK_SIZE) ? (sizeof(picture) - offset) : CAMERA_READ_BLOCK_SIZE;
+            ok = gzip.compress(picture + offset,length);
+        }
+        ok = gzip.finish() && ok;
+        CHECK(ok);
+        CHECK(gzip.length() <= GZIP_BOUND(MAX_CAMERA_BUFFER_SIZE));
+        CHECK_EQUAL(0xA5,slot[GZIP_BOUND(MAX_CAMERA_BUFFER_SIZE)]);
+        if (level == 0 || level == 6 || level == 9) {
+            printf("gzip level %d: %d byte picture -> %d bytes (slot: %d bytes)\n",level,MAX_CAMERA_BUFFER_SIZE,(int)gzip.length(),(int)GZIP_BOUND(MAX_CAMERA_BUFFER_SIZE));
+        }
+    }
+}
+
+int main() {
+    test_no_sample();
+    test_unchanged_then_capture();
+    test_legacy_steady_state();
+    test_smoothing();
+    test_gzip_slot();
+    return host_test_result("CaptureBudgetTest");
+}
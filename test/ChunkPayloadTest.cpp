@@ -0,0 +1,194 @@
+/**
+ * @file    ChunkPayloadTest.cpp
+ * @brief   host test: chunk-by-chunk observation payloads match the legacy whole-image pipeline (and allocate nothing)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// host checks
+#include "HostTest.h"
+#include "HeapCounter.h"
+#include "LegacyBase64.h"
+
+// streaming Base64 encoder
+#include "Base64StreamEncoder.h"
+
+// chunk lengths of CameraResource (PREFERRED_MESSAGE_LEN, PREVIEW_MESSAGE_LEN, BLOCKWISE_ENCODE_LEN) and a few odd ones
+static const int __chunk_lengths[] = { 225, 900, 128, 1, 2, 3, 4, 5, 7, 1023 };
+#define NUM_CHUNK_LENGTHS       ((int)(sizeof(__chunk_lengths) / sizeof(int)))
+
+// camera read block (CAMERA_READ_BLOCK_SIZE... a pipelined capture lands in these)
+#define READ_BLOCK_SIZE         512
+
+// largest capture (MAX_CAMERA_BUFFER_SIZE)
+#define MAX_IMAGE_LENGTH        5192
+
+// legacy CameraResource::split_string()
+static vector<string> legacy_split_string(string str,int length) {
+    vector<string> strings;
+    for (int i=0;i<(int)str.length();i+=(int)length) {
+        strings.push_back(str.substr(i,length));
+    }
+    return strings;
+}
+
+// legacy pipeline: capture buffer -> Base64 -> m_image -> m_image_list
+static vector<string> legacy_payloads(const uint8_t *image,int length,int chunk_length) {
+    string image_str;
+    size_t encoded_length = 0;
+    char *encoded = legacy_base64_encode(image,length,&encoded_length,heap_counted_malloc);
+    image_str = encoded;
+    heap_counted_free(encoded);
+    return legacy_split_string(image_str,chunk_length);
+}
+
+// a JPEG-like test image (header then noise)
+static void make_image(uint8_t *image,int length,unsigned seed) {
+    srand(seed);
+    for(int i=0;i<length;++i) {
+        image[i] = (uint8_t)(rand() & 0xFF);
+    }
+    if (length >= 2) {
+        image[0] = 0xFF;
+        image[1] = 0xD8;
+    }
+}
+
+// chunk "index" as CameraResource::encode_chunk() builds it from the capture buffer ("fill" bytes landed so far)
+static int chunk_payload(Base64StreamEncoder &encoder,const uint8_t *image,int fill,int index,int chunk_length,char *chunk) {
+    int begin = index * chunk_length;
+    int end = begin + chunk_length;
+    int length = encoder.encode_range(image,fill,begin,end,chunk);
+    chunk[length] = '\0';
+    return length;
+}
+
+// completed capture: every chunk matches the legacy payload
+static void test_complete_capture(const uint8_t *image,int length,int chunk_length) {
+    Base64StreamEncoder encoder;
+    static char chunk[1024+1];
+    vector<string> expected = legacy_payloads(image,length,chunk_length);
+    int count = (Base64StreamEncoder::encoded_length(length) + chunk_length - 1) / chunk_length;
+    CHECK_EQUAL(expected.size(),count);
+    for(int i=0;i<count && i<(int)expected.size();++i) {
+        int written = chunk_payload(encoder,image,length,i,chunk_length,chunk);
+        CHECK_EQUAL(expected[i].length(),written);
+        CHECK(expected[i] == string(chunk,written));
+    }
+}
+
+// pipelined capture: a chunk is encoded as soon as its bytes have landed (CameraResource::wait_for_chunk())
+static void test_pipelined_capture(const uint8_t *image,int length,int chunk_length) {
+    Base64StreamEncoder encoder;
+    static char chunk[1024+1];
+    vector<string> expected = legacy_payloads(image,length,chunk_length);
+    int fill = 0;
+    int index = 0;
+    bool complete = false;
+    while (true) {
+        int needed = (((index + 1) * chunk_length + 3) / 4) * 3;
+        while (complete == false && fill < needed) {
+            fill += READ_BLOCK_SIZE;
+            if (fill >= length) {
+                fill = length;
+                complete = true;
+            }
+        }
+        int count = (Base64StreamEncoder::encoded_length(length) + chunk_length - 1) / chunk_length;
+        if (complete && index >= count) {
+            break;
+        }
+        int written = chunk_payload(encoder,image,fill,index,chunk_length,chunk);
+        CHECK(index < (int)expected.size());
+        if (index < (int)expected.size()) {
+            CHECK(expected[index] == string(chunk,written));
+        }
+        ++index;
+    }
+    CHECK_EQUAL(expected.size(),index);
+}
+
+// streaming encode() over arbitrary slices equals the legacy encoding
+static void test_streaming_slices(const uint8_t *image,int length,int slice) {
+    Base64StreamEncoder encoder;
+    static char out[((MAX_IMAGE_LENGTH + 2) / 3) * 4 + 8];
+    size_t expected_length = 0;
+    char *expected = legacy_base64_encode(image,length,&expected_length,heap_counted_malloc);
+    int written = 0;
+    for(int offset=0;offset<length;) {
+        int in_length = (length - offset < slice) ? length - offset : slice;
+        int consumed = 0;
+        written += encoder.encode(image + offset,in_length,out + written,(int)sizeof(out) - written,&consumed);
+        offset += consumed;
+    }
+    written += encoder.finish(out + written,(int)sizeof(out) - written);
+    CHECK_EQUAL(expected_length,written);
+    CHECK(memcmp(expected,out,expected_length) == 0);
+    heap_counted_free(expected);
+}
+
+// peak heap per capture: legacy vs chunk views
+static void report_peak_heap(const uint8_t *image,int length) {
+    heap_counter_reset();
+    {
+        vector<string> payloads = legacy_payloads(image,length,225);
+        SINK(payloads.size());
+    }
+    long legacy_peak = heap_peak_bytes();
+    long legacy_allocations = heap_allocations();
+
+    Base64StreamEncoder encoder;
+    static char chunk[1024+1];
+    heap_counter_reset();
+    int count = (Base64StreamEncoder::encoded_length(length) + 224) / 225;
+    for(int i=0;i<count;++i) {
+        SINK(chunk_payload(encoder,image,length,i,225,chunk));
+    }
+    long chunked_peak = heap_peak_bytes();
+    long chunked_allocations = heap_allocations();
+
+    printf("capture %5d bytes: legacy peak heap %6ld bytes (%4ld allocations)... chunk views %ld bytes (%ld allocations)\n",
+            length,legacy_peak,legacy_allocations,chunked_peak,chunked_allocations);
+    CHECK_EQUAL(0,chunked_allocations);
+    CHECK_EQUAL(0,chunked_peak);
+}
+
+int main() {
+    static uint8_t image[MAX_IMAGE_LENGTH];
+
+    // every length class mod 3 and around the chunk boundaries... up to a full capture
+    for(int length=0;length<=MAX_IMAGE_LENGTH;length += (length < 64) ? 1 : 97) {
+        make_image(image,length,(unsigned)length);
+        for(int c=0;c<NUM_CHUNK_LENGTHS;++c) {
+            test_complete_capture(image,length,__chunk_lengths[c]);
+            test_pipelined_capture(image,length,__chunk_lengths[c]);
+        }
+        test_streaming_slices(image,length,READ_BLOCK_SIZE);
+        test_streaming_slices(image,length,1 + (length % 7));
+    }
+
+    // peak heap per capture (a typical 160x120 capture is ~5 KB)
+    int lengths[] = { 1024, 2500, 5000, MAX_IMAGE_LENGTH };
+    for(int i=0;i<4;++i) {
+        make_image(image,lengths[i],7);
+        report_peak_heap(image,lengths[i]);
+    }
+    return host_test_result("ChunkPayloadTest");
+}
@@ -0,0 +1,270 @@
+/**
+ * @file    GzipStreamCompressorBenchmark.cpp
+ * @brief   host benchmark: streaming gzip of 160x120 JPEG captures per level and window (ratio, time, peak memory)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// host checks
+#include "HostTest.h"
+
+// streaming gzip
+#include "GzipStreamCompressor.h"
+
+#include <dirent.h>
+
+// corpus limits (MAX_CAMERA_BUFFER_SIZE)
+#define MAX_IMAGE_LENGTH        5192
+#define MAX_CORPUS_IMAGES       32
+
+// camera read block (compress() is fed these as they come off the camera)
+#define READ_BLOCK_SIZE         512
+
+// repetitions of each measurement
+#define ITERATIONS              20
+
+// levels and windows (mem level 1... GZIP_MEM_LEVEL) to compare
+static const int __levels[] = { 0, 1, 3, 6, 9 };
+#define NUM_LEVELS              ((int)(sizeof(__levels) / sizeof(int)))
+static const int __window_bits[] = { 9, 10, 11, 12 };
+#define NUM_WINDOWS             ((int)(sizeof(__window_bits) / sizeof(int)))
+
+// host workspace: zlib's structures are larger with 64 bit pointers than on the K64F
+#define HOST_WORKSPACE_SIZE     (2 * GZIP_WORKSPACE_SIZE(12,GZIP_MEM_LEVEL))
+
+// a corpus image
+typedef struct {
+    char        name[64];
+    uint8_t     data[MAX_IMAGE_LENGTH];
+    uint32_t    length;
+} corpus_image_t;
+
+static corpus_image_t __corpus[MAX_CORPUS_IMAGES];
+static int __corpus_size = 0;
+
+// deterministic pseudo random bytes
+static uint32_t __seed = 1;
+static uint8_t next_random() {
+    __seed = __seed * 1103515245u + 12345u;
+    return (uint8_t)(__seed >> 16);
+}
+
+// append bytes to a synthetic image
+static void append(corpus_image_t &image,const uint8_t *bytes,uint32_t length) {
+    for(uint32_t i=0;i<length && image.length<MAX_IMAGE_LENGTH;++i) {
+        image.data[image.length++] = bytes[i];
+    }
+}
+
+/**
+ * A JPEG shaped like an OV528 160x120 capture: SOI, JFIF APP0, the two quantization tables, SOF0, the four standard
+ * Huffman tables, SOS, then "scan_length" bytes of entropy coded data and EOI. The scan is modelled: random bytes (with
+ * 0xFF stuffing) where "repeat_percent" of the bytes copy a recent run (flat areas of a dark or empty stall code alike).
+ */
+static void synthetic_jpeg(corpus_image_t &image,const char *name,int scan_length,int repeat_percent,int quality) {
+    static const uint8_t soi_app0[] = { 0xFF,0xD8, 0xFF,0xE0,0x00,0x10,'J','F','I','F',0x00,0x01,0x01,0x00,0x00,0x01,0x00,0x01,0x00,0x00 };
+    static const uint8_t luminance[64] = { 16,11,10,16,24,40,51,61,12,12,14,19,26,58,60,55,14,13,16,24,40,57,69,56,14,17,22,29,51,87,80,62,
+                                           18,22,37,56,68,109,103,77,24,35,55,64,81,104,113,92,49,64,78,87,103,121,120,101,72,92,95,98,112,100,103,99 };
+    static const uint8_t sof0[] = { 0xFF,0xC0,0x00,0x11,0x08,0x00,0x78,0x00,0xA0,0x03,0x01,0x21,0x00,0x02,0x11,0x01,0x03,0x11,0x01 };
+    static const uint8_t sos[] = { 0xFF,0xDA,0x00,0x0C,0x03,0x01,0x00,0x02,0x11,0x03,0x11,0x00,0x3F,0x00 };
+    static const uint8_t eoi[] = { 0xFF,0xD9 };
+    memset(&image,0,sizeof(image));
+    strncpy(image.name,name,sizeof(image.name) - 1);
+    append(image,soi_app0,sizeof(soi_app0));
+
+    // quantization tables (scaled by quality... IJG style)
+    for(int table=0;table<2;++table) {
+        uint8_t dqt[5+64] = { 0xFF,0xDB,0x00,0x43,(uint8_t)table };
+        int scale = (quality < 50) ? 5000 / quality : 200 - 2 * quality;
+        for(int i=0;i<64;++i) {
+            int q = ((table == 0 ? luminance[i] : 99) * scale + 50) / 100;
+            dqt[5+i] = (uint8_t)(q < 1 ? 1 : (q > 255 ? 255 : q));
+        }
+        append(image,dqt,sizeof(dqt));
+    }
+    append(image,sof0,sizeof(sof0));
+
+    // Huffman tables: counts and symbols (the standard tables are ~420 bytes of mostly small, repetitive values)
+    for(int table=0;table<4;++table) {
+        uint8_t dht[4+1+16+162];
+        int symbols = (table & 1) ? 162 : 12;
+        dht[0] = 0xFF; dht[1] = 0xC4; dht[2] = 0x00; dht[3] = (uint8_t)(3 + 16 + symbols);
+        dht[4] = (uint8_t)(((table & 1) << 4) | (table >> 1));
+        for(int i=0;i<16;++i) {
+            dht[5+i] = (uint8_t)((i < 8) ? ((table & 1) ? (i + 1) : 1) : (table & 1) ? 7 : 0);
+        }
+        for(int i=0;i<symbols;++i) {
+            dht[5+16+i] = (uint8_t)((table & 1) ? (((i % 16) << 4) | ((i / 16) % 10 + 1)) : i);
+        }
+        append(image,dht,4 + 1 + 16 + symbols);
+    }
+    append(image,sos,sizeof(sos));
+
+    // entropy coded scan
+    __seed = (uint32_t)(scan_length * 31 + repeat_percent);
+    int start = (int)image.length;
+    while ((int)image.length - start < scan_length && image.length < MAX_IMAGE_LENGTH - sizeof(eoi)) {
+        if ((int)image.length - start > 16 && (int)(next_random() % 100) < repeat_percent) {
+            int run = 3 + next_random() % 8;
+            int from = (int)image.length - (1 + next_random() % 64);
+            if (from < start) from = start;
+            for(int i=0;i<run && image.length < MAX_IMAGE_LENGTH - sizeof(eoi);++i) {
+                image.data[image.length++] = image.data[from + i];
+            }
+        }
+        else {
+            uint8_t b = next_random();
+            image.data[image.length++] = b;
+            if (b == 0xFF && image.length < MAX_IMAGE_LENGTH - sizeof(eoi)) {
+                image.data[image.length++] = 0x00;
+            }
+        }
+    }
+    append(image,eoi,sizeof(eoi));
+}
+
+// load *.jpg from a directory (real captures)
+static void load_corpus(const char *path) {
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        printf("unable to open corpus %s\n",path);
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && __corpus_size < MAX_CORPUS_IMAGES) {
+        const char *dot = strrchr(entry->d_name,'.');
+        if (dot == NULL || (strcmp(dot,".jpg") != 0 && strcmp(dot,".jpeg") != 0)) {
+            continue;
+        }
+        char file[512];
+        snprintf(file,sizeof(file),"%s/%s",path,entry->d_name);
+        FILE *fp = fopen(file,"rb");
+        if (fp == NULL) {
+            continue;
+        }
+        corpus_image_t &image = __corpus[__corpus_size];
+        memset(&image,0,sizeof(image));
+        strncpy(image.name,entry->d_name,sizeof(image.name) - 1);
+        image.length = (uint32_t)fread(image.data,1,MAX_IMAGE_LENGTH,fp);
+        fclose(fp);
+        if (image.length > 0) {
+            ++__corpus_size;
+        }
+    }
+    closedir(dir);
+}
+
+// the synthetic corpus: busy, typical, dark/flat scenes and low quality captures
+static void synthetic_corpus() {
+    synthetic_jpeg(__corpus[__corpus_size++],"busy (q85)",4600,0,85);
+    synthetic_jpeg(__corpus[__corpus_size++],"car in stall (q75)",4000,2,75);
+    synthetic_jpeg(__corpus[__corpus_size++],"empty stall (q75)",3000,4,75);
+    synthetic_jpeg(__corpus[__corpus_size++],"night (q50)",1800,6,50);
+    synthetic_jpeg(__corpus[__corpus_size++],"washed out (q30)",1200,10,30);
+}
+
+// compress one image the way CameraResource does (read blocks into a bound() sized buffer)
+static bool compress_image(GzipStreamCompressor &gzip,const corpus_image_t &image,uint8_t *out,uint32_t &out_length) {
+    uint32_t bound = GzipStreamCompressor::bound(image.length);
+    if (gzip.begin(out,bound) == false) {
+        return false;
+    }
+    for(uint32_t offset=0;offset<image.length;offset+=READ_BLOCK_SIZE) {
+        uint32_t length = (image.length - offset < READ_BLOCK_SIZE) ? image.length - offset : READ_BLOCK_SIZE;
+        if (gzip.compress(image.data + offset,length) == false) {
+            return false;
+        }
+    }
+    bool ok = gzip.finish();
+    out_length = gzip.length();
+    return ok;
+}
+
+// bound() holds for incompressible input at every level and window
+static void check_bound(uint8_t *workspace) {
+    static corpus_image_t noise;
+    static uint8_t out[MAX_IMAGE_LENGTH * 2];
+    memset(&noise,0,sizeof(noise));
+    __seed = 99;
+    for(int length=0;length<=MAX_IMAGE_LENGTH;length += (length < 32) ? 1 : 173) {
+        noise.length = (uint32_t)length;
+        for(int i=0;i<length;++i) {
+            noise.data[i] = next_random();
+        }
+        for(int l=0;l<NUM_LEVELS;++l) {
+            for(int w=0;w<NUM_WINDOWS;++w) {
+                GzipStreamCompressor gzip(workspace,HOST_WORKSPACE_SIZE,__window_bits[w],GZIP_MEM_LEVEL);
+                gzip.set_level(__levels[l]);
+                uint32_t out_length = 0;
+                bool ok = compress_image(gzip,noise,out,out_length);
+                CHECK(ok);
+                CHECK(out_length <= GzipStreamCompressor::bound((uint32_t)length));
+            }
+        }
+    }
+}
+
+int main(int argc,char **argv) {
+    static uint8_t workspace[HOST_WORKSPACE_SIZE];
+    static uint8_t out[MAX_IMAGE_LENGTH * 2];
+    if (argc > 1) {
+        load_corpus(argv[1]);
+    }
+    if (__corpus_size == 0) {
+        printf("synthetic corpus (pass a directory of real 160x120 captures to use those)\n");
+        synthetic_corpus();
+    }
+    uint32_t corpus_bytes = 0;
+    for(int i=0;i<__corpus_size;++i) {
+        printf("  %-24s %5u bytes\n",__corpus[i].name,(unsigned)__corpus[i].length);
+        corpus_bytes += __corpus[i].length;
+    }
+
+    check_bound(workspace);
+
+    printf("level window   ratio  saved/image  us/image  peak workspace (host)  K64F estimate\n");
+    for(int w=0;w<NUM_WINDOWS;++w) {
+        for(int l=0;l<NUM_LEVELS;++l) {
+            GzipStreamCompressor gzip(workspace,HOST_WORKSPACE_SIZE,__window_bits[w],GZIP_MEM_LEVEL);
+            gzip.set_level(__levels[l]);
+            uint32_t compressed = 0;
+            uint32_t peak = 0;
+            double start = host_time_ns();
+            for(int it=0;it<ITERATIONS;++it) {
+                for(int i=0;i<__corpus_size;++i) {
+                    uint32_t out_length = 0;
+                    bool ok = compress_image(gzip,__corpus[i],out,out_length);
+                    if (it == 0) {
+                        CHECK(ok);
+                        CHECK(out_length <= GzipStreamCompressor::bound(__corpus[i].length));
+                        compressed += out_length;
+                        if (gzip.peak_memory() > peak) {
+                            peak = gzip.peak_memory();
+                        }
+                    }
+                }
+            }
+            double us_per_image = (host_time_ns() - start) / 1000.0 / (ITERATIONS * __corpus_size);
+            printf("%5d %6d %7.3f %12d %9.1f %22u %14u\n",__levels[l],1 << __window_bits[w],(double)compressed / corpus_bytes,
+                    (int)(corpus_bytes - compressed) / __corpus_size,us_per_image,(unsigned)peak,(unsigned)GZIP_WORKSPACE_SIZE(__window_bits[w],GZIP_MEM_LEVEL));
+        }
+    }
+    return host_test_result("GzipStreamCompressorBenchmark");
+}
@@ -0,0 +1,385 @@
+/**
+ * @file    ImageFingerprintTest.cpp
+ * @brief   host test: the luma grid fingerprint of libjpeg encoded scenes (a noisy re-capture is a duplicate, a different scene is not)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// host checks
+#include "HostTest.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// libjpeg stands in for the camera's encoder
+#include <jpeglib.h>
+
+// fingerprint
+#include "ImageFingerprint.h"
+
+// CameraResource defaults
+#define CAMERA_DUPLICATE_TOLERANCE  50
+#define CAMERA_READ_BLOCK_SIZE      512
+
+// the camera's 160x120 capture
+#define WIDTH                       160
+#define HEIGHT                      120
+
+// an RGB picture
+typedef struct {
+    int                     width;
+    int                     height;
+    std::vector<uint8_t>    rgb;
+} picture_t;
+
+// encoder settings
+typedef struct {
+    int     quality;
+    int     h_samp;             // luma sampling (chroma is 1x1)
+    int     v_samp;
+    int     restart_rows;       // restart interval (MCU rows... 0: none)
+    bool    progressive;
+    bool    grayscale;
+} encoding_t;
+
+static const encoding_t __ov528 = { 75, 2, 1, 0, false, false };
+
+// deterministic pseudo random numbers
+static unsigned __seed = 1;
+static int next_random(int range) {
+    __seed = __seed * 1103515245u + 12345u;
+    return (int)((__seed >> 16) % (unsigned)range);
+}
+
+static uint8_t clamp(int v) {
+    return (uint8_t)((v < 0) ? 0 : ((v > 255) ? 255 : v));
+}
+
+static void fill_rect(picture_t &p,int x0,int y0,int x1,int y1,int r,int g,int b) {
+    for(int y=y0;y<y1 && y<p.height;++y) {
+        for(int x=x0;x<x1 && x<p.width;++x) {
+            uint8_t *px = &p.rgb[(y * p.width + x) * 3];
+            px[0] = clamp(r); px[1] = clamp(g); px[2] = clamp(b);
+        }
+    }
+}
+
+// the empty stall: asphalt (lighter towards the camera), the painted bay lines, a kerb and a wall
+static picture_t empty_stall(int width,int height) {
+    picture_t p;
+    p.width = width;
+    p.height = height;
+    p.rgb.resize(width * height * 3);
+    for(int y=0;y<height;++y) {
+        int asphalt = 70 + (50 * y) / height;
+        fill_rect(p,0,y,width,y + 1,asphalt,asphalt,asphalt + 4);
+    }
+    fill_rect(p,0,0,width,height / 5,150,140,120);
+    fill_rect(p,0,height / 5,width,height / 5 + height / 20,200,200,190);
+    fill_rect(p,width / 8,height / 4,width / 8 + width / 32,height,230,230,210);
+    fill_rect(p,width - width / 8 - width / 32,height / 4,width - width / 8,height,230,230,210);
+    return p;
+}
+
+// a parked car in the stall: dark body, windscreen and number plate
+static picture_t parked_car(int width,int height) {
+    picture_t p = empty_stall(width,height);
+    fill_rect(p,width / 5,height / 3,width - width / 5,height - height / 10,40,45,90);
+    fill_rect(p,width / 4,height / 3 + height / 20,width - width / 4,height / 2,120,150,170);
+    fill_rect(p,width / 2 - width / 10,height - height / 5,width / 2 + width / 10,height - height / 8,230,220,40);
+    return p;
+}
+
+// a re-capture of the same scene: sensor noise on every pixel and a small exposure change
+static picture_t recapture(const picture_t &scene,int noise,int exposure) {
+    picture_t p = scene;
+    for(size_t i=0;i<p.rgb.size();++i) {
+        p.rgb[i] = clamp((int)p.rgb[i] + exposure + next_random(2 * noise + 1) - noise);
+    }
+    return p;
+}
+
+// JPEG encode (libjpeg to memory)
+static std::vector<uint8_t> encode(const picture_t &p,const encoding_t &e) {
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    unsigned char *out = NULL;
+    unsigned long out_length = 0;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo,&out,&out_length);
+    cinfo.image_width = p.width;
+    cinfo.image_height = p.height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    if (e.grayscale) {
+        jpeg_set_colorspace(&cinfo,JCS_GRAYSCALE);
+    }
+    else {
+        cinfo.comp_info[0].h_samp_factor = e.h_samp;
+        cinfo.comp_info[0].v_samp_factor = e.v_samp;
+    }
+    jpeg_set_quality(&cinfo,e.quality,TRUE);
+    cinfo.restart_in_rows = e.restart_rows;
+    if (e.progressive) {
+        jpeg_simple_progression(&cinfo);
+    }
+    jpeg_start_compress(&cinfo,TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = (JSAMPROW)&p.rgb[cinfo.next_scanline * p.width * 3];
+        jpeg_write_scanlines(&cinfo,&row,1);
+    }
+    jpeg_finish_compress(&cinfo);
+    std::vector<uint8_t> jpeg(out,out + out_length);
+    jpeg_destroy_compress(&cinfo);
+    free(out);
+    return jpeg;
+}
+
+// fingerprint a JPEG fed in blocks of "block" bytes (as the camera is read)
+static ImageFingerprintDecoder __decoder;
+static ImageFingerprint fingerprint(const std::vector<uint8_t> &jpeg,uint32_t block = CAMERA_READ_BLOCK_SIZE) {
+    ImageFingerprint fp;
+    __decoder.begin(&fp);
+    for(uint32_t offset=0;offset<jpeg.size();offset+=block) {
+        uint32_t length = (jpeg.size() - offset < block) ? (uint32_t)(jpeg.size() - offset) : block;
+        __decoder.update(&jpeg[offset],length);
+    }
+    return fp;
+}
+
+// the cell means straight from the pixels (luma of each 8x8 block, blocks mapped to cells as the decoder does)
+static void reference_luma(const picture_t &p,int *luma) {
+    int blocks_wide = (p.width + 7) / 8;
+    int blocks_high = (p.height + 7) / 8;
+    double sums[FINGERPRINT_CELLS];
+    int counts[FINGERPRINT_CELLS];
+    memset(sums,0,sizeof(sums));
+    memset(counts,0,sizeof(counts));
+    for(int by=0;by<blocks_high;++by) {
+        for(int bx=0;bx<blocks_wide;++bx) {
+            // (the encoder replicates the last row and column into a partial block)
+            double block = 0.0;
+            for(int y=0;y<8;++y) {
+                for(int x=0;x<8;++x) {
+                    int px = (bx * 8 + x < p.width) ? bx * 8 + x : p.width - 1;
+                    int py = (by * 8 + y < p.height) ? by * 8 + y : p.height - 1;
+                    const uint8_t *rgb = &p.rgb[(py * p.width + px) * 3];
+                    block += 0.299 * rgb[0] + 0.587 * rgb[1] + 0.114 * rgb[2];
+                }
+            }
+            int cell = ((by * FINGERPRINT_GRID_HEIGHT) / blocks_high) * FINGERPRINT_GRID_WIDTH + (bx * FINGERPRINT_GRID_WIDTH) / blocks_wide;
+            sums[cell] += block / 64.0;
+            ++counts[cell];
+        }
+    }
+    for(int i=0;i<FINGERPRINT_CELLS;++i) {
+        luma[i] = (counts[i] > 0) ? (int)(sums[i] / counts[i] + 0.5) : 128;
+    }
+}
+
+// largest cell error of a fingerprint against the pixels
+static int luma_error(const ImageFingerprint &fp,const picture_t &p) {
+    int luma[FINGERPRINT_CELLS];
+    reference_luma(p,luma);
+    int worst = 0;
+    for(int i=0;i<FINGERPRINT_CELLS;++i) {
+        int error = abs(fp.luma(i) - luma[i]);
+        if (error > worst) {
+            worst = error;
+        }
+    }
+    return worst;
+}
+
+static bool same_luma(const ImageFingerprint &a,const ImageFingerprint &b) {
+    for(int i=0;i<FINGERPRINT_CELLS;++i) {
+        if (a.luma(i) != b.luma(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the decoded cells match the pixels for the samplings, restart intervals and sizes a camera produces
+static void test_decoder() {
+    static const encoding_t encodings[] = {
+        { 75, 2, 1, 0, false, false },      // OV528 4:2:2
+        { 75, 2, 2, 0, false, false },      // 4:2:0
+        { 75, 1, 1, 0, false, false },      // 4:4:4
+        { 90, 1, 1, 0, false, true  },      // grayscale (single component scan)
+        { 75, 2, 1, 1, false, false },      // a restart marker every MCU row
+        { 30, 2, 2, 2, false, false }
+    };
+    static const int sizes[][2] = { { 160, 120 }, { 80, 60 }, { 320, 240 }, { 100, 75 } };
+    picture_t scenes[2];
+    for(int s=0;s<(int)(sizeof(sizes) / sizeof(sizes[0]));++s) {
+        scenes[0] = empty_stall(sizes[s][0],sizes[s][1]);
+        scenes[1] = parked_car(sizes[s][0],sizes[s][1]);
+        for(int e=0;e<(int)(sizeof(encodings) / sizeof(encoding_t));++e) {
+            for(int i=0;i<2;++i) {
+                ImageFingerprint fp = fingerprint(encode(scenes[i],encodings[e]));
+                CHECK(fp.valid());
+                int error = luma_error(fp,scenes[i]);
+                if (error > 4) {
+                    printf("%dx%d encoding %d scene %d: cell error %d\n",sizes[s][0],sizes[s][1],e,i,error);
+                }
+                CHECK(error <= 4);
+            }
+        }
+    }
+
+    // restart markers do not change the fingerprint
+    picture_t scene = parked_car(WIDTH,HEIGHT);
+    encoding_t restarts = __ov528;
+    restarts.restart_rows = 1;
+    std::vector<uint8_t> plain = encode(scene,__ov528);
+    std::vector<uint8_t> restarted = encode(scene,restarts);
+    CHECK(plain != restarted);
+    CHECK(same_luma(fingerprint(plain),fingerprint(restarted)));
+    CHECK_EQUAL(0,fingerprint(plain).difference(fingerprint(restarted)));
+}
+
+// however the camera blocks split the picture (markers, stuffed bytes and codes cut anywhere)
+static void test_block_sizes() {
+    std::vector<uint8_t> jpeg = encode(recapture(parked_car(WIDTH,HEIGHT),6,0),__ov528);
+    ImageFingerprint whole = fingerprint(jpeg,(uint32_t)jpeg.size());
+    CHECK(whole.valid());
+    static const uint32_t blocks[] = { 1, 2, 3, 7, 64, 511, CAMERA_READ_BLOCK_SIZE };
+    for(int i=0;i<(int)(sizeof(blocks) / sizeof(uint32_t));++i) {
+        ImageFingerprint fp = fingerprint(jpeg,blocks[i]);
+        CHECK(fp.valid());
+        CHECK(same_luma(whole,fp));
+    }
+}
+
+// a noisy re-capture of the same scene is a duplicate... its bytes have nothing in common
+static void test_noisy_recapture() {
+    picture_t scenes[2] = { empty_stall(WIDTH,HEIGHT), parked_car(WIDTH,HEIGHT) };
+    for(int s=0;s<2;++s) {
+        std::vector<uint8_t> delivered = encode(recapture(scenes[s],8,0),__ov528);
+        ImageFingerprint reference = fingerprint(delivered);
+        int worst = 0;
+        for(int i=0;i<10;++i) {
+            std::vector<uint8_t> jpeg = encode(recapture(scenes[s],8,(i % 5) * 3 - 6),__ov528);
+            CHECK(jpeg != delivered);
+            int difference = fingerprint(jpeg).difference(reference);
+            if (difference > worst) {
+                worst = difference;
+            }
+            CHECK(difference <= CAMERA_DUPLICATE_TOLERANCE);
+        }
+        printf("%s: %d byte JPEG... noisy re-captures differ by at most %d/%d\n",s ? "parked car" : "empty stall",(int)delivered.size(),worst,FINGERPRINT_MAX_DIFFERENCE);
+    }
+
+    // a much brighter (or darker) exposure of the same scene too
+    ImageFingerprint reference = fingerprint(encode(empty_stall(WIDTH,HEIGHT),__ov528));
+    CHECK(fingerprint(encode(recapture(empty_stall(WIDTH,HEIGHT),4,25),__ov528)).difference(reference) <= CAMERA_DUPLICATE_TOLERANCE);
+    CHECK(fingerprint(encode(recapture(empty_stall(WIDTH,HEIGHT),4,-25),__ov528)).difference(reference) <= CAMERA_DUPLICATE_TOLERANCE);
+}
+
+// a different scene at the same resolution is not a duplicate (a car arrives, leaves or is replaced by another)
+static void test_different_scene() {
+    picture_t empty = empty_stall(WIDTH,HEIGHT);
+    picture_t car = parked_car(WIDTH,HEIGHT);
+    picture_t other_car = parked_car(WIDTH,HEIGHT);
+    fill_rect(other_car,WIDTH / 5,HEIGHT / 3,WIDTH - WIDTH / 5,HEIGHT - HEIGHT / 10,200,200,205);
+    fill_rect(other_car,WIDTH / 4,HEIGHT / 3 + HEIGHT / 20,WIDTH - WIDTH / 4,HEIGHT / 2,30,35,40);
+
+    std::vector<uint8_t> empty_jpeg = encode(recapture(empty,8,0),__ov528);
+    std::vector<uint8_t> car_jpeg = encode(recapture(car,8,0),__ov528);
+    std::vector<uint8_t> other_jpeg = encode(recapture(other_car,8,0),__ov528);
+    ImageFingerprint empty_fp = fingerprint(empty_jpeg);
+    ImageFingerprint car_fp = fingerprint(car_jpeg);
+    ImageFingerprint other_fp = fingerprint(other_jpeg);
+    printf("empty vs car: %d/%d (%d vs %d bytes)... car vs another car: %d/%d (%d bytes)\n",empty_fp.difference(car_fp),FINGERPRINT_MAX_DIFFERENCE,(int)empty_jpeg.size(),(int)car_jpeg.size(),
+           car_fp.difference(other_fp),FINGERPRINT_MAX_DIFFERENCE,(int)other_jpeg.size());
+    CHECK(empty_fp.difference(car_fp) > CAMERA_DUPLICATE_TOLERANCE);
+    CHECK(car_fp.difference(empty_fp) > CAMERA_DUPLICATE_TOLERANCE);
+    CHECK(car_fp.difference(other_fp) > CAMERA_DUPLICATE_TOLERANCE);
+}
+
+// pictures the decoder cannot follow are never duplicates
+static void test_invalid() {
+    picture_t scene = empty_stall(WIDTH,HEIGHT);
+    std::vector<uint8_t> jpeg = encode(scene,__ov528);
+    ImageFingerprint reference = fingerprint(jpeg);
+    CHECK(reference.valid());
+    CHECK_EQUAL(0,reference.difference(reference));
+
+    // nothing yet
+    ImageFingerprint empty;
+    CHECK(empty.valid() == false);
+    CHECK_EQUAL(FINGERPRINT_MAX_DIFFERENCE,empty.difference(reference));
+    CHECK_EQUAL(FINGERPRINT_MAX_DIFFERENCE,reference.difference(empty));
+
+    // truncated (no EOI)
+    std::vector<uint8_t> truncated(jpeg.begin(),jpeg.begin() + jpeg.size() / 2);
+    CHECK(fingerprint(truncated).valid() == false);
+
+    // progressive
+    encoding_t progressive = __ov528;
+    progressive.progressive = true;
+    ImageFingerprint fp = fingerprint(encode(scene,progressive));
+    CHECK(fp.valid() == false);
+    CHECK_EQUAL(FINGERPRINT_MAX_DIFFERENCE,fp.difference(reference));
+
+    // corrupt scan data (the decoder stays on its feet... whatever it makes of it is not trusted blindly)
+    std::vector<uint8_t> corrupt = jpeg;
+    for(size_t i=corrupt.size() / 2;i<corrupt.size() - 2;i+=3) {
+        corrupt[i] = (uint8_t)next_random(255);
+    }
+    fingerprint(corrupt);
+
+    // not a JPEG at all
+    std::vector<uint8_t> noise(4096);
+    for(size_t i=0;i<noise.size();++i) {
+        noise[i] = (uint8_t)next_random(256);
+    }
+    CHECK(fingerprint(noise).valid() == false);
+
+    // the decoder is reused: the next picture is fine again
+    CHECK(same_luma(fingerprint(jpeg),reference));
+}
+
+// decode cost of a 160x120 capture
+static void benchmark_decode() {
+    std::vector<uint8_t> jpeg = encode(recapture(parked_car(WIDTH,HEIGHT),8,0),__ov528);
+    const int iterations = 200;
+    double start_ns = host_time_ns();
+    for(int i=0;i<iterations;++i) {
+        ImageFingerprint fp = fingerprint(jpeg);
+        SINK(fp.luma(i % FINGERPRINT_CELLS));
+    }
+    double per_image_us = (host_time_ns() - start_ns) / iterations / 1000.0;
+    printf("decode: %d byte JPEG in %.1f us (host)... decoder %d bytes, fingerprint %d bytes\n",(int)jpeg.size(),per_image_us,(int)sizeof(ImageFingerprintDecoder),(int)sizeof(ImageFingerprint));
+}
+
+int main() {
+    test_decoder();
+    test_block_sizes();
+    test_noisy_recapture();
+    test_different_scene();
+    test_invalid();
+    benchmark_decode();
+    return host_test_result("ImageFingerprintTest");
+}
@@ -0,0 +1,365 @@
+/**
+ * @file    MultiStallBenchmark.cpp
+ * @brief   host benchmark: per sample CPU cost and range multiplexer wake ups as the number of stalls grows... and wake ups per hour of an idle stall
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// host checks
+#include "HostTest.h"
+
+#include <string.h>
+
+// the per stall stages and the multiplexer (over the fake AsyncRangeFinder in test/fakes)
+#include "RangeFilter.h"
+#include "SampleScheduler.h"
+#include "ParkingStallStateMachine.h"
+#include "RangeMultiplexer.h"
+
+// the fake's shared air
+uint64_t AsyncRangeFinder::__air_busy_until_us = 0;
+int AsyncRangeFinder::__crosstalk = 0;
+
+// the detector defaults (ParkingStallOccupancyDetectorResource.h)
+#define OCCUPIED_RANGE_M        0.12
+#define OCCUPIED_VARIANCE_M     0.01
+#define MAX_RANGE_M             0.37
+#define RANGE_END_M             0.60
+#define MOVEMENT_RATE_M_S       0.03
+#define FAST_PERIOD_MS          150         // HREZ_WAIT_TIME
+#define MAX_PERIOD_MS           1000        // MAX_WAIT_TIME
+#define IDLE_PERIOD_MS          4000        // IDLE_WAIT_TIME
+#define IDLE_AFTER_MS           60000       // IDLE_AFTER_TIME
+#define HOUR_MS                 3600000
+#define SLOT_MS                 50          // RANGE_FINDER_SLOT_MS
+#define ECHO_TIMEOUT_US         40000       // RANGE_FINDER_TIMEOUT_US
+
+// samples per stall in the CPU benchmark (a repeating empty, arrival, parked, departure cycle)
+#define TRACE_SAMPLES           2000
+#define CYCLE_SAMPLES           200
+
+// state of each stall... the detector's struct of arrays
+typedef struct {
+    uint8_t             state[RANGE_MUX_MAX_SENSORS];
+    uint8_t             movement[RANGE_MUX_MAX_SENSORS];
+    bool                sampling_active[RANGE_MUX_MAX_SENSORS];
+    float               range[RANGE_MUX_MAX_SENSORS];
+    float               last_range[RANGE_MUX_MAX_SENSORS];
+    float               speed[RANGE_MUX_MAX_SENSORS];
+    uint32_t            last_sample_us[RANGE_MUX_MAX_SENSORS];
+    int                 wait_time[RANGE_MUX_MAX_SENSORS];
+} bench_stalls_t;
+
+static bench_stalls_t   __stalls;
+static RangeFilter      __filter[RANGE_MUX_MAX_SENSORS];
+static SampleScheduler  __scheduler[RANGE_MUX_MAX_SENSORS];
+static range_sample_t   __trace[RANGE_MUX_MAX_SENSORS][TRACE_SAMPLES];
+
+// deterministic pseudo random numbers
+static uint32_t __seed = 1;
+static float next_uniform() {
+    __seed = __seed * 1103515245u + 12345u;
+    return (float)((__seed >> 8) & 0xFFFF) / 65536.0f;
+}
+
+// true range of the cycle: far wall, approach, parked, leave
+static float cycle_range(int i) {
+    int phase = i % CYCLE_SAMPLES;
+    if (phase < 40) return 0.45;
+    if (phase < 50) return 0.45 - (phase - 40) * 0.033;
+    if (phase < 150) return 0.12;
+    if (phase < 160) return 0.12 + (phase - 150) * 0.033;
+    return 0.45;
+}
+
+// each stall runs the cycle shifted (the stalls of a meter are not in step)... with 3% spurious echoes
+static void make_traces() {
+    __seed = 7;
+    for(int stall=0;stall<RANGE_MUX_MAX_SENSORS;++stall) {
+        for(int i=0;i<TRACE_SAMPLES;++i) {
+            float u = next_uniform() * 100.0f;
+            float range = cycle_range(i + stall * 37) + (next_uniform() - 0.5f) * 0.008f;
+            if (u < 3.0f) {
+                range = 0.05f + next_uniform() * 0.30f;
+            }
+            __trace[stall][i].range_m = range;
+            __trace[stall][i].timestamp_us = (uint32_t)(i + 1) * FAST_PERIOD_MS * 1000;
+        }
+    }
+}
+
+static void reset_stalls(int num_stalls) {
+    memset(&__stalls,0,sizeof(__stalls));
+    for(int stall=0;stall<num_stalls;++stall) {
+        __filter[stall].configure(RANGE_FILTER_DEFAULT_MEDIAN,RANGE_FILTER_DEFAULT_EMA_ALPHA,RANGE_FILTER_DEFAULT_MAX_VELOCITY);
+        __scheduler[stall].configure(FAST_PERIOD_MS,MAX_PERIOD_MS,SCHEDULER_DEFAULT_CHANGE_M,SCHEDULER_DEFAULT_REFERENCE_SPEED);
+        __stalls.state[stall] = STALL_EMPTY;
+        __stalls.movement[stall] = NO_MOVEMENT;
+        __stalls.range[stall] = DEFAULT_OUT_OF_RANGE;
+        __stalls.last_range[stall] = DEFAULT_OUT_OF_RANGE;
+    }
+}
+
+// the meter follows its busiest stall (meter_state())
+static ParkingStallStates meter_state(int num_stalls) {
+    bool arriving = false;
+    bool departing = false;
+    for(int stall=0;stall<num_stalls;++stall) {
+        switch (__stalls.state[stall]) {
+            case STALL_OCCUPIED:
+                return STALL_OCCUPIED;
+            case STALL_ARRIVING:
+                arriving = true;
+                break;
+            case STALL_DEPARTING:
+                departing = true;
+                break;
+            default:
+                break;
+        }
+    }
+    if (arriving) {
+        return STALL_ARRIVING;
+    }
+    return departing ? STALL_DEPARTING : STALL_EMPTY;
+}
+
+// one sample of one stall: update_parking_stall_state() without the logging and notifications
+static int process_sample(int num_stalls,int stall,const range_sample_t &sample) {
+    float new_range = 0.0;
+    if (__filter[stall].filter(sample.range_m,sample.timestamp_us,new_range) == false) {
+        __stalls.wait_time[stall] = __scheduler[stall].update(__stalls.range[stall],0.0,true);
+        return __stalls.wait_time[stall];
+    }
+    float interval_s = (__stalls.last_sample_us[stall] != 0) ? (sample.timestamp_us - __stalls.last_sample_us[stall])/1000000.0 : FAST_PERIOD_MS/1000.0;
+    __stalls.last_sample_us[stall] = sample.timestamp_us;
+    if (interval_s <= 0.0) {
+        interval_s = FAST_PERIOD_MS/1000.0;
+    }
+    __stalls.movement[stall] = NO_MOVEMENT;
+    __stalls.speed[stall] = 0.0;
+    if (new_range < 0) {
+        __stalls.last_range[stall] = DEFAULT_OUT_OF_RANGE;
+        __stalls.range[stall] = DEFAULT_OUT_OF_RANGE;
+    }
+    else {
+        __stalls.last_range[stall] = __stalls.range[stall];
+        __stalls.range[stall] = new_range;
+        float rate_m_s = (__stalls.range[stall] - __stalls.last_range[stall])/interval_s;
+        if (__stalls.last_range[stall] >= DEFAULT_OUT_OF_RANGE || __stalls.range[stall] >= DEFAULT_OUT_OF_RANGE) {
+            rate_m_s = 0.0;
+        }
+        __stalls.speed[stall] = fabs(rate_m_s);
+        __stalls.movement[stall] = parking_stall_movement(rate_m_s,MOVEMENT_RATE_M_S);
+        if (new_range > RANGE_END_M) {
+            __stalls.last_range[stall] = DEFAULT_OUT_OF_RANGE;
+            __stalls.range[stall] = DEFAULT_OUT_OF_RANGE;
+        }
+    }
+    float range = __stalls.range[stall];
+
+    // the transition table
+    RangeClasses input = parking_stall_range_class(range,(MovementDirection)__stalls.movement[stall],OCCUPIED_RANGE_M,OCCUPIED_VARIANCE_M,MAX_RANGE_M);
+    const stall_transition_t *transition = &__stall_transitions[__stalls.state[stall]][input];
+    if (transition->actions & ACTION_RANGE_EMPTY) {
+        __stalls.range[stall] = DEFAULT_OUT_OF_RANGE;
+        __stalls.last_range[stall] = DEFAULT_OUT_OF_RANGE;
+        __stalls.movement[stall] = NO_MOVEMENT;
+    }
+    if (transition->actions & ACTION_RANGE_PARKED) {
+        __stalls.range[stall] = OCCUPIED_RANGE_M;
+        __stalls.last_range[stall] = OCCUPIED_RANGE_M;
+        __stalls.movement[stall] = NO_MOVEMENT;
+    }
+    __stalls.state[stall] = (uint8_t)transition->next;
+
+    // the shared beacon, camera and LEDs follow the meter
+    SINK(meter_state(num_stalls));
+    __stalls.sampling_active[stall] = ((transition->actions & ACTION_RATE_HIGH) != 0) || transition->next == STALL_ARRIVING || transition->next == STALL_DEPARTING;
+
+    // next ranging period
+    __stalls.wait_time[stall] = __scheduler[stall].update(range,__stalls.speed[stall],__stalls.sampling_active[stall]);
+    return __stalls.wait_time[stall];
+}
+
+// CPU cost of one sample (ns) with "num_stalls" stalls... the samples of the stalls interleave as they would off the multiplexer
+static double sample_cost_ns(int num_stalls) {
+    const int repeats = 50;
+    double start_ns = host_time_ns();
+    for(int r=0;r<repeats;++r) {
+        reset_stalls(num_stalls);
+        for(int i=0;i<TRACE_SAMPLES;++i) {
+            for(int stall=0;stall<num_stalls;++stall) {
+                SINK(process_sample(num_stalls,stall,__trace[stall][i]));
+            }
+        }
+    }
+    return (host_time_ns() - start_ns) / ((double)repeats * TRACE_SAMPLES * num_stalls);
+}
+
+// the multiplexer over a 120 s scene: static, one car moving, every stall busy, static again
+typedef struct {
+    int         pings;
+    int         wake_ups;
+    int         crosstalk;
+    int         static_pings;           // first 20 s (every stall at MAX_PERIOD_MS)
+    int         busy_max_interval_ms;   // worst gap between two pings of one stall while every stall asks for FAST_PERIOD_MS
+} mux_result_t;
+
+static mux_result_t run_multiplexer(int num_stalls) {
+    mux_result_t result;
+    memset(&result,0,sizeof(result));
+    host_clock_reset();
+    AsyncRangeFinder::reset_air();
+
+    AsyncRangeFinder *finders[RANGE_MUX_MAX_SENSORS];
+    RangeMultiplexer *mux = new RangeMultiplexer();
+    for(int stall=0;stall<num_stalls;++stall) {
+        finders[stall] = new AsyncRangeFinder(ECHO_TIMEOUT_US);
+        mux->add(finders[stall],MAX_PERIOD_MS);
+    }
+    mux->start(SLOT_MS);
+
+    // 0-20 s: static
+    host_clock_run_until(20000000);
+    for(int stall=0;stall<num_stalls;++stall) {
+        result.static_pings += finders[stall]->pings();
+    }
+
+    // 20-40 s: a car moving in stall 0
+    mux->set_period(0,FAST_PERIOD_MS);
+    host_clock_run_until(40000000);
+
+    // 40-60 s: every stall busy
+    for(int stall=0;stall<num_stalls;++stall) {
+        mux->set_period(stall,FAST_PERIOD_MS);
+    }
+    host_clock_run_until(41000000);
+    for(int stall=0;stall<num_stalls;++stall) {
+        finders[stall]->reset_max_interval();
+    }
+    host_clock_run_until(60000000);
+    for(int stall=0;stall<num_stalls;++stall) {
+        int interval_ms = (int)(finders[stall]->max_interval_us() / 1000);
+        if (interval_ms > result.busy_max_interval_ms) {
+            result.busy_max_interval_ms = interval_ms;
+        }
+    }
+
+    // 60-120 s: static again
+    for(int stall=0;stall<num_stalls;++stall) {
+        mux->set_period(stall,MAX_PERIOD_MS);
+    }
+    host_clock_run_until(120000000);
+
+    for(int stall=0;stall<num_stalls;++stall) {
+        result.pings += finders[stall]->pings();
+    }
+    result.wake_ups = result.pings + mux->idle_slots();
+    result.crosstalk = AsyncRangeFinder::crosstalk();
+    mux->stop();
+    for(int stall=0;stall<num_stalls;++stall) {
+        delete finders[stall];
+    }
+    delete mux;
+    return result;
+}
+
+// an idle stall for an hour (empty: the far wall... occupied: a parked car) with sensor noise: the samples are its wake ups
+typedef struct {
+    int         wake_ups;
+    int         state;
+    int         last_period_ms;         // worst case delay before an arrival (or departure) is seen
+} idle_result_t;
+
+static idle_result_t run_idle_hour(float true_range_m,int idle_ms) {
+    idle_result_t result;
+    memset(&result,0,sizeof(result));
+    reset_stalls(1);
+    __scheduler[0].configure(FAST_PERIOD_MS,MAX_PERIOD_MS,SCHEDULER_DEFAULT_CHANGE_M,SCHEDULER_DEFAULT_REFERENCE_SPEED,idle_ms,IDLE_AFTER_MS);
+    __seed = 11;
+    uint32_t now_ms = 0;
+    while (now_ms < HOUR_MS) {
+        range_sample_t sample;
+        sample.range_m = true_range_m + (next_uniform() - 0.5f) * 0.008f;
+        sample.timestamp_us = now_ms * 1000;
+        result.last_period_ms = process_sample(1,0,sample);
+        now_ms += result.last_period_ms;
+        ++result.wake_ups;
+    }
+    result.state = __stalls.state[0];
+    return result;
+}
+
+int main() {
+    make_traces();
+
+    // per sample cost: the work per sample is per stall... only meter_state() walks every stall
+    printf("%-7s %12s %12s %14s\n","stalls","ns/sample","ns/round","state bytes");
+    double cost_ns[RANGE_MUX_MAX_SENSORS + 1];
+    for(int n=1;n<=RANGE_MUX_MAX_SENSORS;++n) {
+        cost_ns[n] = sample_cost_ns(n);
+        printf("%-7d %12.1f %12.1f %14d\n",n,cost_ns[n],cost_ns[n] * n,(int)(sizeof(bench_stalls_t) / RANGE_MUX_MAX_SENSORS) * n);
+    }
+    CHECK(cost_ns[RANGE_MUX_MAX_SENSORS] < 3.0 * cost_ns[1]);
+
+    // the multiplexer: wake ups against a Ticker waking every slot for 120 s
+    const int fixed_slot_wake_ups = 120000 / SLOT_MS;
+    printf("\n%-7s %8s %9s %13s %10s %13s %18s\n","stalls","pings","wake ups","wake ups/ping","crosstalk","static pings","busy max gap (ms)");
+    for(int n=1;n<=RANGE_MUX_MAX_SENSORS;++n) {
+        mux_result_t result = run_multiplexer(n);
+        printf("%-7d %8d %9d %13.2f %10d %13d %18d (a fixed %d ms slot Ticker: %d wake ups)\n",n,result.pings,result.wake_ups,
+               (double)result.wake_ups / result.pings,result.crosstalk,result.static_pings,result.busy_max_interval_ms,SLOT_MS,fixed_slot_wake_ups);
+
+        // no ping while another echo may still be ringing
+        CHECK_EQUAL(0,result.crosstalk);
+
+        // nothing due: no wake up
+        CHECK(result.wake_ups <= result.pings + result.pings / 20);
+        CHECK(result.wake_ups < fixed_slot_wake_ups);
+
+        // a static scene ranges each stall about once a second
+        CHECK(result.static_pings >= n * 19 && result.static_pings <= n * 21);
+
+        // busy: each stall gets its fast period... or its share of the slots
+        int share_ms = (n * SLOT_MS > FAST_PERIOD_MS) ? n * SLOT_MS : FAST_PERIOD_MS;
+        CHECK(result.busy_max_interval_ms <= share_ms + SLOT_MS);
+    }
+
+    // an idle stall: wake ups per hour against the fixed 1s ranging of old (3600/h)... the 1s ceiling alone saves nothing here
+    const int baseline_wake_ups = HOUR_MS / MAX_PERIOD_MS;
+    printf("\n%-9s %-14s %13s %12s %22s\n","stall","ceiling","wake ups/h","vs 1s rate","worst detection (ms)");
+    const float idle_ranges[2] = { 0.45, OCCUPIED_RANGE_M };
+    const char *idle_names[2] = { "empty", "occupied" };
+    for(int i=0;i<2;++i) {
+        idle_result_t capped = run_idle_hour(idle_ranges[i],MAX_PERIOD_MS);
+        idle_result_t idle = run_idle_hour(idle_ranges[i],IDLE_PERIOD_MS);
+        printf("%-9s %-14s %13d %11.0f%% %22d\n",idle_names[i],"1s (fixed)",baseline_wake_ups,100.0,MAX_PERIOD_MS);
+        printf("%-9s %-14s %13d %11.0f%% %22d\n",idle_names[i],"max_period_ms",capped.wake_ups,100.0 * capped.wake_ups / baseline_wake_ups,capped.last_period_ms);
+        printf("%-9s %-14s %13d %11.0f%% %22d\n",idle_names[i],"idle_period_ms",idle.wake_ups,100.0 * idle.wake_ups / baseline_wake_ups,idle.last_period_ms);
+
+        // settled (no flapping on the noise) and backed off past 1s once idle for IDLE_AFTER_MS
+        CHECK_EQUAL(i == 0 ? (int)STALL_EMPTY : (int)STALL_OCCUPIED,idle.state);
+        CHECK_EQUAL(IDLE_PERIOD_MS,idle.last_period_ms);
+        CHECK(capped.wake_ups >= baseline_wake_ups - 10);
+        CHECK(idle.wake_ups < baseline_wake_ups / 3);
+    }
+    return host_test_result("MultiStallBenchmark");
+}
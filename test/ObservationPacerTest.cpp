@@ -0,0 +1,200 @@
+/**
+ * @file    ObservationPacerTest.cpp
+ * @brief   host test: credit based observation pacing against a simulated lossy link (vs the legacy fixed sleeps)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// host checks
+#include "HostTest.h"
+#include "SimulatedLink.h"
+
+// pacer
+#include "ObservationPacer.h"
+
+// a 5 KB capture: 6828 base64 characters in 225 character chunks (CameraResource PREFERRED_MESSAGE_LEN)... then END
+#define IMAGE_ENCODED_LENGTH        6828
+#define CHUNK_LENGTH                225
+#define END_LENGTH                  3
+
+// legacy pacing (WAIT_BETWEEN_OBSERVATIONS_MS)
+#define LEGACY_WAIT_MS              750
+
+// links: Ethernet, a lossy Ethernet, cellular, lossy cellular and an mbed-client without delivery callbacks
+static const link_profile_t __links[] = {
+    { "ethernet",          20, 100000,  0, true  },
+    { "ethernet 5% loss",  20, 100000,  5, true  },
+    { "cellular",         300,   2000,  0, true  },
+    { "cellular 10% loss",300,   2000, 10, true  },
+    { "cellular 25% loss",300,   2000, 25, true  },
+    { "no callbacks",      20, 100000,  0, false }
+};
+#define NUM_LINKS       ((int)(sizeof(__links) / sizeof(link_profile_t)))
+
+// outcome of one image transfer
+typedef struct {
+    int         sender_ms;      // first observation to END handed to mbed-client
+    int         complete_ms;    // first observation to the last acknowledgement
+    int         delivered;
+    int         dropped;
+    int         lost;
+    int         transmissions;
+    int         pacing_ms;
+    int         bytes_per_sec;
+    int         rto_ms;
+    int         retransmissions;
+    bool        in_order;
+} transfer_t;
+
+// notification delivery callback
+static void pacer_delivered(void *context) {
+    ((ObservationPacer *)context)->delivered();
+}
+
+// nothing to pace in the legacy transfer
+static void ignore_delivered(void *context) {
+}
+
+// chunk lengths of the transfer (the last one is END)
+static int observation_length(int index,int count) {
+    if (index == count - 1) {
+        return END_LENGTH;
+    }
+    int remaining = IMAGE_ENCODED_LENGTH - index * CHUNK_LENGTH;
+    return (remaining < CHUNK_LENGTH) ? remaining : CHUNK_LENGTH;
+}
+
+// collect the link outcome after the transfer has drained
+static void finish_transfer(SimulatedLink &link,uint64_t start_us,uint64_t sender_us,int count,transfer_t &result) {
+    host_clock_run_until(host_clock_us() + 120000000ULL);
+    result.sender_ms = (int)((sender_us - start_us) / 1000);
+    result.complete_ms = (int)((link.last_delivery_us() - start_us) / 1000);
+    result.delivered = link.delivered();
+    result.dropped = link.dropped();
+    result.lost = link.lost();
+    result.transmissions = link.transmissions();
+    result.in_order = true;
+    const vector<int> &order = link.delivery_order();
+    for(size_t i=1;i<order.size();++i) {
+        if (order[i] < order[i-1]) {
+            result.in_order = false;
+        }
+    }
+    CHECK_EQUAL(count,link.sent());
+}
+
+// CameraResource::stream_observations(): each observation waits for a credit
+static transfer_t paced_transfer(ObservationPacer &pacer,const link_profile_t &profile,unsigned seed) {
+    transfer_t result;
+    int count = (IMAGE_ENCODED_LENGTH + CHUNK_LENGTH - 1) / CHUNK_LENGTH + 1;
+    SimulatedLink link(profile,seed,pacer_delivered,&pacer);
+    uint64_t start_us = host_clock_us();
+    pacer.begin();
+    for(int i=0;i<count;++i) {
+        pacer.acquire();
+        int length = observation_length(i,count);
+        link.send(length);
+        pacer.sent(length);
+    }
+    pacer.end();
+    uint64_t sender_us = host_clock_us();
+    result.pacing_ms = pacer.pacing_ms();
+    result.bytes_per_sec = pacer.bytes_per_sec();
+    result.rto_ms = pacer.rto_ms();
+    result.retransmissions = pacer.retransmissions();
+    finish_transfer(link,start_us,sender_us,count,result);
+    return result;
+}
+
+// the legacy loop: 1500 ms, then 750 ms after each chunk, 750 ms more before END
+static transfer_t legacy_transfer(const link_profile_t &profile,unsigned seed) {
+    transfer_t result;
+    memset(&result,0,sizeof(result));
+    int count = (IMAGE_ENCODED_LENGTH + CHUNK_LENGTH - 1) / CHUNK_LENGTH + 1;
+    SimulatedLink link(profile,seed,ignore_delivered,NULL);
+    uint64_t start_us = host_clock_us();
+    Thread::wait(2*LEGACY_WAIT_MS);
+    for(int i=0;i<count-1;++i) {
+        link.send(observation_length(i,count));
+        Thread::wait(LEGACY_WAIT_MS);
+    }
+    Thread::wait(LEGACY_WAIT_MS);
+    link.send(END_LENGTH);
+    uint64_t sender_us = host_clock_us();
+    finish_transfer(link,start_us,sender_us,count,result);
+    result.bytes_per_sec = (int)(((IMAGE_ENCODED_LENGTH + END_LENGTH) * 1000LL) / (result.sender_ms > 0 ? result.sender_ms : 1));
+    result.pacing_ms = result.sender_ms / count;
+    return result;
+}
+
+static void report(const char *mode,const link_profile_t &profile,const transfer_t &t) {
+    printf("%-18s %-7s sender %6d ms complete %6d ms delivered %2d dropped %2d lost %2d tx %3d pacing %5d ms/obs %6d bytes/sec rto %5d ms retransmissions %d\n",
+            profile.name,mode,t.sender_ms,t.complete_ms,t.delivered,t.dropped,t.lost,t.transmissions,t.pacing_ms,t.bytes_per_sec,t.rto_ms,t.retransmissions);
+}
+
+int main() {
+    int count = (IMAGE_ENCODED_LENGTH + CHUNK_LENGTH - 1) / CHUNK_LENGTH + 1;
+    for(int l=0;l<NUM_LINKS;++l) {
+        const link_profile_t &profile = __links[l];
+        host_clock_reset();
+        transfer_t legacy = legacy_transfer(profile,1234 + l);
+        report("legacy",profile,legacy);
+
+        // the pacer lives as long as the camera... the second image starts with the RTT it learnt
+        host_clock_reset();
+        ObservationPacer pacer(1);
+        transfer_t first = paced_transfer(pacer,profile,1234 + l);
+        report("paced",profile,first);
+        transfer_t second = paced_transfer(pacer,profile,4321 + l);
+        report("paced 2",profile,second);
+
+        // one observation in flight: mbed-client never has to drop one, and they arrive in order
+        CHECK_EQUAL(0,first.dropped);
+        CHECK_EQUAL(0,second.dropped);
+        CHECK(first.in_order);
+        CHECK(second.in_order);
+        CHECK_EQUAL(count,first.delivered + first.lost);
+        CHECK_EQUAL(count,second.delivered + second.lost);
+
+        if (profile.callbacks == false) {
+            // no acknowledgements to go by: the initial RTO paces us (the legacy 750 ms)... never backs off
+            CHECK(first.pacing_ms >= PACER_INITIAL_RTO_MS - 50 && first.pacing_ms <= PACER_INITIAL_RTO_MS + 50);
+            CHECK_EQUAL(0,first.retransmissions);
+            continue;
+        }
+
+        // acknowledgements pace us: never slower than the legacy sleeps on a clean link
+        if (profile.loss_percent == 0) {
+            CHECK_EQUAL(count,first.delivered);
+            CHECK(first.sender_ms < legacy.sender_ms);
+            CHECK(second.sender_ms < legacy.sender_ms);
+            CHECK_EQUAL(0,second.retransmissions);
+        }
+        else {
+            // losses are seen as retransmissions... the pacer backs off rather than stuffing the queue
+            CHECK(first.retransmissions + second.retransmissions > 0);
+        }
+        if (profile.latency_ms < 100 && profile.loss_percent == 0) {
+            // a fast link: the RTO follows the measured RTT down
+            CHECK(second.rto_ms < PACER_INITIAL_RTO_MS);
+        }
+    }
+    return host_test_result("ObservationPacerTest");
+}
@@ -0,0 +1,224 @@
+/**
+ * @file    ParkingStallStateMachineTest.cpp
+ * @brief   host test: every (state, range class) entry of the occupancy transition table and the input discretization
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// host checks
+#include "HostTest.h"
+
+#include <string.h>
+
+// state machine
+#include "ParkingStallStateMachine.h"
+
+// the detector defaults (ParkingStallOccupancyDetectorResource.h)
+#define OCCUPIED_RANGE_M        0.12
+#define OCCUPIED_VARIANCE_M     0.01
+#define MAX_RANGE_M             0.37
+#define MOVEMENT_RATE_M_S       0.03
+
+// actions that must never be applied together
+static const uint16_t __conflicts[][2] = {
+    { ACTION_RANGE_EMPTY,    ACTION_RANGE_PARKED },
+    { ACTION_BEACON_ON,      ACTION_BEACON_OFF },
+    { ACTION_CAMERA_WARM_UP, ACTION_CAMERA_POWER_DOWN },
+    { ACTION_RATE_LOW,       ACTION_RATE_HIGH },
+    { ACTION_CAMERA_CAPTURE, ACTION_CAMERA_POWER_DOWN }
+};
+#define NUM_CONFLICTS   ((int)(sizeof(__conflicts) / sizeof(__conflicts[0])))
+
+// the expected entry of a (state, class) pair
+static stall_transition_t expected_transition(ParkingStallStates state,RangeClasses input) {
+    static const stall_transition_t to_empty = STALL_TO_EMPTY;
+    static const stall_transition_t to_occupied = STALL_TO_OCCUPIED;
+    static const stall_transition_t to_arriving = STALL_TO_ARRIVING;
+    static const stall_transition_t to_departing = STALL_TO_DEPARTING;
+    stall_transition_t hold = STALL_HOLD(state);
+    stall_transition_t stationary = STALL_STATIONARY(state);
+    switch (input) {
+        case RANGE_BEYOND_MAX:  return to_empty;
+        case RANGE_PARKED:      return to_occupied;
+        case RANGE_MOVING_IN:   return to_arriving;
+        case RANGE_MOVING_OUT:  return to_departing;
+        case RANGE_STATIONARY:  return stationary;
+        default:                return hold;
+    }
+}
+
+// every entry of the table
+static void test_table_entries() {
+    for(int state=0;state<STALL_NUM_STATES;++state) {
+        for(int input=0;input<RANGE_NUM_CLASSES;++input) {
+            const stall_transition_t &t = __stall_transitions[state][input];
+            stall_transition_t e = expected_transition((ParkingStallStates)state,(RangeClasses)input);
+            CHECK_EQUAL(e.next,t.next);
+            CHECK_EQUAL(e.actions,t.actions);
+            CHECK((e.log == NULL && t.log == NULL) || (e.log != NULL && t.log != NULL && strcmp(e.log,t.log) == 0));
+
+            // no reading: hold the state, do nothing and log nothing
+            if (input == RANGE_NO_READING) {
+                CHECK_EQUAL(state,t.next);
+                CHECK_EQUAL(ACTION_NONE,t.actions);
+                CHECK(t.log == NULL);
+            }
+            else {
+                CHECK(t.log != NULL);
+            }
+
+            // a state change always re-lights the LEDs and publishes the state... holding a state never does
+            if (t.next != state && input != RANGE_NO_READING) {
+                CHECK((t.actions & ACTION_LEDS) != 0);
+                CHECK((t.actions & ACTION_PUBLISH_STATE) != 0);
+            }
+            if (input == RANGE_STATIONARY) {
+                CHECK_EQUAL(state,t.next);
+                CHECK_EQUAL(ACTION_RATE_HIGH,t.actions);
+            }
+
+            // observations are only sent for the settled states
+            if ((t.actions & ACTION_OBSERVE) != 0) {
+                CHECK(t.next == STALL_EMPTY || t.next == STALL_OCCUPIED);
+            }
+
+            // no conflicting actions in one transition
+            for(int i=0;i<NUM_CONFLICTS;++i) {
+                CHECK((t.actions & __conflicts[i][0]) == 0 || (t.actions & __conflicts[i][1]) == 0);
+            }
+
+            // only the defined action bits
+            CHECK((t.actions & ~0x0fff) == 0);
+            CHECK(t.next >= STALL_EMPTY && t.next < STALL_NUM_STATES);
+        }
+    }
+
+    // the settled states: EMPTY powers the camera down and the beacon off, OCCUPIED captures with the beacon on
+    for(int state=0;state<STALL_NUM_STATES;++state) {
+        const stall_transition_t &empty = __stall_transitions[state][RANGE_BEYOND_MAX];
+        CHECK_EQUAL(STALL_EMPTY,empty.next);
+        CHECK((empty.actions & (ACTION_RANGE_EMPTY|ACTION_OBSERVE|ACTION_BEACON_OFF|ACTION_CAMERA_POWER_DOWN|ACTION_RATE_LOW)) == (ACTION_RANGE_EMPTY|ACTION_OBSERVE|ACTION_BEACON_OFF|ACTION_CAMERA_POWER_DOWN|ACTION_RATE_LOW));
+        CHECK(strcmp(empty.log,"Parking stall has just turned EMPTY") == 0);
+
+        const stall_transition_t &occupied = __stall_transitions[state][RANGE_PARKED];
+        CHECK_EQUAL(STALL_OCCUPIED,occupied.next);
+        CHECK((occupied.actions & (ACTION_RANGE_PARKED|ACTION_OBSERVE|ACTION_CAMERA_CAPTURE|ACTION_BEACON_ON|ACTION_RATE_LOW)) == (ACTION_RANGE_PARKED|ACTION_OBSERVE|ACTION_CAMERA_CAPTURE|ACTION_BEACON_ON|ACTION_RATE_LOW));
+        CHECK(strcmp(occupied.log,"stall is now OCCUPIED...") == 0);
+
+        const stall_transition_t &arriving = __stall_transitions[state][RANGE_MOVING_IN];
+        CHECK_EQUAL(STALL_ARRIVING,arriving.next);
+        CHECK((arriving.actions & (ACTION_RATE_HIGH|ACTION_CAMERA_WARM_UP)) == (ACTION_RATE_HIGH|ACTION_CAMERA_WARM_UP));
+        CHECK((arriving.actions & ACTION_OBSERVE) == 0);
+        CHECK(strcmp(arriving.log,"stall has ARRIVING car...") == 0);
+
+        const stall_transition_t &departing = __stall_transitions[state][RANGE_MOVING_OUT];
+        CHECK_EQUAL(STALL_DEPARTING,departing.next);
+        CHECK((departing.actions & ACTION_RATE_HIGH) != 0);
+        CHECK((departing.actions & ACTION_OBSERVE) == 0);
+        CHECK(strcmp(departing.log,"stall has DEPARTING car...") == 0);
+
+        CHECK(strcmp(__stall_transitions[state][RANGE_STATIONARY].log,"car is stationary...") == 0);
+    }
+}
+
+// movement: +-MOVEMENT_RATE_M_S inclusive is movement, anything in between is none
+static void test_movement() {
+    CHECK_EQUAL(NO_MOVEMENT,parking_stall_movement(0.0,MOVEMENT_RATE_M_S));
+    CHECK_EQUAL(NO_MOVEMENT,parking_stall_movement(0.029,MOVEMENT_RATE_M_S));
+    CHECK_EQUAL(NO_MOVEMENT,parking_stall_movement(-0.029,MOVEMENT_RATE_M_S));
+    CHECK_EQUAL(OUT_OF_STALL,parking_stall_movement(0.03f,0.03f));
+    CHECK_EQUAL(INTO_STALL,parking_stall_movement(-0.03f,0.03f));
+    CHECK_EQUAL(OUT_OF_STALL,parking_stall_movement(2.5,MOVEMENT_RATE_M_S));
+    CHECK_EQUAL(INTO_STALL,parking_stall_movement(-2.5,MOVEMENT_RATE_M_S));
+}
+
+// classification boundaries with the detector defaults
+static RangeClasses classify(float range,MovementDirection movement) {
+    return parking_stall_range_class(range,movement,OCCUPIED_RANGE_M,OCCUPIED_VARIANCE_M,MAX_RANGE_M);
+}
+
+static void test_range_classes() {
+    static const MovementDirection movements[] = { INTO_STALL, NO_MOVEMENT, OUT_OF_STALL };
+    for(int i=0;i<3;++i) {
+        MovementDirection m = movements[i];
+
+        // out of range (or no echo) wins over everything
+        CHECK_EQUAL(RANGE_NO_READING,classify(DEFAULT_OUT_OF_RANGE,m));
+        CHECK_EQUAL(RANGE_NO_READING,classify(DEFAULT_OUT_OF_RANGE + 1.0,m));
+
+        // beyond max_range (exclusive)
+        CHECK_EQUAL(RANGE_BEYOND_MAX,classify(0.38,m));
+        CHECK_EQUAL(RANGE_BEYOND_MAX,classify(DEFAULT_OUT_OF_RANGE - 1.0,m));
+
+        // parked: 0..occupied+variance inclusive (no lower bound... we dont bump the meter)
+        CHECK_EQUAL(RANGE_PARKED,classify(0.0,m));
+        CHECK_EQUAL(RANGE_PARKED,classify(0.05,m));
+        CHECK_EQUAL(RANGE_PARKED,classify(0.12,m));
+        CHECK_EQUAL(RANGE_PARKED,classify(0.129,m));
+    }
+
+    // in between: the movement decides
+    CHECK_EQUAL(RANGE_MOVING_IN,classify(0.131,INTO_STALL));
+    CHECK_EQUAL(RANGE_MOVING_OUT,classify(0.131,OUT_OF_STALL));
+    CHECK_EQUAL(RANGE_STATIONARY,classify(0.131,NO_MOVEMENT));
+    CHECK_EQUAL(RANGE_MOVING_IN,classify(0.37f,INTO_STALL));
+    CHECK_EQUAL(RANGE_MOVING_OUT,classify(0.37f,OUT_OF_STALL));
+    CHECK_EQUAL(RANGE_STATIONARY,classify(0.25,NO_MOVEMENT));
+
+    // a negative range is never parked
+    CHECK_EQUAL(RANGE_STATIONARY,classify(-0.01,NO_MOVEMENT));
+}
+
+// a short sequence through the table: arrive, park, sit, depart, leave
+static void test_sequence() {
+    static const struct { float range; MovementDirection movement; ParkingStallStates expected; } steps[] = {
+        { DEFAULT_OUT_OF_RANGE, NO_MOVEMENT,  STALL_EMPTY },
+        { 0.36,                 INTO_STALL,   STALL_ARRIVING },
+        { 0.25,                 INTO_STALL,   STALL_ARRIVING },
+        { 0.20,                 NO_MOVEMENT,  STALL_ARRIVING },
+        { 0.12,                 INTO_STALL,   STALL_OCCUPIED },
+        { DEFAULT_OUT_OF_RANGE, NO_MOVEMENT,  STALL_OCCUPIED },
+        { 0.12,                 NO_MOVEMENT,  STALL_OCCUPIED },
+        { 0.20,                 OUT_OF_STALL, STALL_DEPARTING },
+        { 0.33,                 OUT_OF_STALL, STALL_DEPARTING },
+        { 0.45,                 OUT_OF_STALL, STALL_EMPTY }
+    };
+    ParkingStallStates state = STALL_EMPTY;
+    int observations = 0;
+    for(int i=0;i<(int)(sizeof(steps) / sizeof(steps[0]));++i) {
+        const stall_transition_t &t = __stall_transitions[state][classify(steps[i].range,steps[i].movement)];
+        if ((t.actions & ACTION_OBSERVE) != 0 && t.next != state) {
+            ++observations;
+        }
+        state = t.next;
+        CHECK_EQUAL(steps[i].expected,state);
+    }
+
+    // OCCUPIED and then EMPTY
+    CHECK_EQUAL(2,observations);
+}
+
+int main() {
+    test_table_entries();
+    test_movement();
+    test_range_classes();
+    test_sequence();
+    return host_test_result("ParkingStallStateMachineTest");
+}
@@ -0,0 +1,172 @@
+/**
+ * @file    ProgressivePreviewBenchmark.cpp
+ * @brief   host benchmark: time to preview and total bytes of progressive delivery vs the single image mode
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// host checks
+#include "HostTest.h"
+#include "SimulatedLink.h"
+
+// pacer (the camera streams through it)
+#include "ObservationPacer.h"
+
+// chunk lengths (CameraResource PREFERRED_MESSAGE_LEN and PREVIEW_MESSAGE_LEN) and END
+#define CHUNK_LENGTH                225
+#define PREVIEW_CHUNK_LENGTH        900
+#define END_LENGTH                  3
+
+// OV528 model: snapshot latency and the UART read rate (115200 baud... 10 bits a byte)
+#define CAMERA_SNAPSHOT_MS          150
+#define CAMERA_READ_BYTES_PER_SEC   11520
+
+// captures: 160x120 and 80x60 JPEG sizes (bytes)
+typedef struct {
+    const char *name;
+    int         full_bytes;
+    int         preview_bytes;
+} capture_profile_t;
+static const capture_profile_t __captures[] = {
+    { "busy scene",   5000, 1400 },
+    { "typical",      4000, 1000 },
+    { "dark scene",   2500,  700 }
+};
+#define NUM_CAPTURES    ((int)(sizeof(__captures) / sizeof(capture_profile_t)))
+
+static const link_profile_t __links[] = {
+    { "ethernet",          20, 100000,  0, true },
+    { "cellular",         300,   2000,  0, true },
+    { "cellular 10% loss",300,   2000, 10, true }
+};
+#define NUM_LINKS       ((int)(sizeof(__links) / sizeof(link_profile_t)))
+
+// an image stream: its chunks become available as the camera is read (PIPELINE_CAMERA_READ)
+typedef struct {
+    int         raw_bytes;
+    int         chunk_length;
+    uint64_t    capture_start_us;
+    int         first_index;        // link index of its first observation
+    int         end_index;          // link index of its END
+} image_stream_t;
+
+static void pacer_delivered(void *context) {
+    ((ObservationPacer *)context)->delivered();
+}
+
+// when the camera read is done
+static uint64_t read_done_us(const image_stream_t &image) {
+    return image.capture_start_us + CAMERA_SNAPSHOT_MS * 1000ULL + (uint64_t)image.raw_bytes * 1000000ULL / CAMERA_READ_BYTES_PER_SEC;
+}
+
+// stream one image as CameraResource::stream_observations() does... returns the payload bytes sent
+static int stream_image(ObservationPacer &pacer,SimulatedLink &link,image_stream_t &image) {
+    int encoded = ((image.raw_bytes + 2) / 3) * 4;
+    int count = (encoded + image.chunk_length - 1) / image.chunk_length;
+    int bytes = 0;
+    image.first_index = link.sent();
+    pacer.begin();
+    for(int i=0;i<count;++i) {
+        // wait_for_chunk(): the raw bytes of the chunk have come off the camera
+        int needed = ((((i + 1) * image.chunk_length) + 3) / 4) * 3;
+        if (needed > image.raw_bytes) {
+            needed = image.raw_bytes;
+        }
+        uint64_t available_us = image.capture_start_us + CAMERA_SNAPSHOT_MS * 1000ULL + (uint64_t)needed * 1000000ULL / CAMERA_READ_BYTES_PER_SEC;
+        if (available_us > host_clock_us()) {
+            Thread::wait((uint32_t)((available_us - host_clock_us() + 999) / 1000));
+        }
+        pacer.acquire();
+        int length = (encoded - i * image.chunk_length < image.chunk_length) ? encoded - i * image.chunk_length : image.chunk_length;
+        link.send(length);
+        pacer.sent(length);
+        bytes += length;
+    }
+    pacer.acquire();
+    image.end_index = link.sent();
+    link.send(END_LENGTH);
+    pacer.sent(END_LENGTH);
+    pacer.end();
+    return bytes + END_LENGTH;
+}
+
+// outcome of a POST
+typedef struct {
+    int         first_image_ms;     // POST to the END of the first image (preview or full) acknowledged
+    int         full_image_ms;      // POST to the END of the full image acknowledged
+    int         bytes;
+} delivery_t;
+
+// single image mode: the full picture only
+static delivery_t single_image(const capture_profile_t &capture,const link_profile_t &profile) {
+    host_clock_reset();
+    ObservationPacer pacer(1);
+    SimulatedLink link(profile,77,pacer_delivered,&pacer);
+    image_stream_t full = { capture.full_bytes, CHUNK_LENGTH, 0, 0, 0 };
+    delivery_t result;
+    result.bytes = stream_image(pacer,link,full);
+    host_clock_run_until(host_clock_us() + 120000000ULL);
+    result.full_image_ms = (int)(link.delivery_us(full.end_index) / 1000);
+    result.first_image_ms = result.full_image_ms;
+    return result;
+}
+
+// progressive: the 80x60 preview streams (large chunks) while the full picture is captured into the other slot
+static delivery_t progressive(const capture_profile_t &capture,const link_profile_t &profile) {
+    host_clock_reset();
+    ObservationPacer pacer(1);
+    SimulatedLink link(profile,77,pacer_delivered,&pacer);
+    image_stream_t preview = { capture.preview_bytes, PREVIEW_CHUNK_LENGTH, 0, 0, 0 };
+    image_stream_t full = { capture.full_bytes, CHUNK_LENGTH, read_done_us(preview), 0, 0 };
+    delivery_t result;
+    result.bytes = stream_image(pacer,link,preview);
+    result.bytes += stream_image(pacer,link,full);
+    host_clock_run_until(host_clock_us() + 120000000ULL);
+    result.first_image_ms = (int)(link.delivery_us(preview.end_index) / 1000);
+    result.full_image_ms = (int)(link.delivery_us(full.end_index) / 1000);
+    return result;
+}
+
+int main() {
+    printf("%-18s %-11s %-12s %9s %9s %7s\n","link","capture","mode","first ms","full ms","bytes");
+    for(int l=0;l<NUM_LINKS;++l) {
+        for(int c=0;c<NUM_CAPTURES;++c) {
+            delivery_t single = single_image(__captures[c],__links[l]);
+            delivery_t prog = progressive(__captures[c],__links[l]);
+            printf("%-18s %-11s %-12s %9d %9d %7d\n",__links[l].name,__captures[c].name,"single",single.first_image_ms,single.full_image_ms,single.bytes);
+            printf("%-18s %-11s %-12s %9d %9d %7d (preview %.0f%% sooner, +%d bytes)\n",__links[l].name,__captures[c].name,"progressive",prog.first_image_ms,prog.full_image_ms,prog.bytes,
+                    100.0 * (single.first_image_ms - prog.first_image_ms) / single.first_image_ms,prog.bytes - single.bytes);
+
+            // every image made it
+            CHECK(single.full_image_ms > 0);
+            CHECK(prog.first_image_ms > 0);
+            CHECK(prog.full_image_ms > 0);
+
+            // something usable well before the single image... the preview costs only its own bytes
+            CHECK(prog.first_image_ms < single.first_image_ms);
+            CHECK_EQUAL(single.bytes + ((__captures[c].preview_bytes + 2) / 3) * 4 + END_LENGTH,prog.bytes);
+            if (__links[l].loss_percent == 0 && __links[l].latency_ms < 100) {
+                // the goal: a picture on screen within a second or two of the POST
+                CHECK(prog.first_image_ms < 2000);
+            }
+        }
+    }
+    return host_test_result("ProgressivePreviewBenchmark");
+}
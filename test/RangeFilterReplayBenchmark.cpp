@@ -0,0 +1,315 @@
+/**
+ * @file    RangeFilterReplayBenchmark.cpp
+ * @brief   host benchmark: false occupancy transitions of replayed range traces with the filter stage off vs on
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// host checks
+#include "HostTest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// filter and state machine
+#include "RangeFilter.h"
+#include "ParkingStallStateMachine.h"
+
+// the detector defaults (ParkingStallOccupancyDetectorResource.h)
+#define OCCUPIED_RANGE_M        0.12
+#define OCCUPIED_VARIANCE_M     0.01
+#define MAX_RANGE_M             0.37
+#define RANGE_END_M             0.60
+#define MOVEMENT_RATE_M_S       0.03
+#define SAMPLE_PERIOD_MS        150         // HREZ_WAIT_TIME... the traces are sampled at the fast rate throughout
+
+// trace limits
+#define MAX_TRACE_SAMPLES       4096
+#define MAX_EXPECTED            4
+
+// a range trace and what the stall really did
+typedef struct {
+    char                name[48];
+    ParkingStallStates  initial;
+    ParkingStallStates  expected[MAX_EXPECTED];     // the real state changes, in order
+    int                 num_expected;               // -1: unknown (a recorded trace without ground truth)
+    float               range_m[MAX_TRACE_SAMPLES];
+    uint32_t            timestamp_us[MAX_TRACE_SAMPLES];
+    int                 length;
+} range_trace_t;
+
+// filter configurations: median_n, ema_alpha, max_velocity
+typedef struct {
+    const char *name;
+    int         median_n;
+    float       ema_alpha;
+    float       max_velocity;
+} filter_config_t;
+
+static const filter_config_t __configs[] = {
+    { "off",                1, 1.0, 0.0 },
+    { "default (median 3)", RANGE_FILTER_DEFAULT_MEDIAN, RANGE_FILTER_DEFAULT_EMA_ALPHA, RANGE_FILTER_DEFAULT_MAX_VELOCITY },
+    { "median 5, EMA 0.5",  5, 0.5, 1.0 }
+};
+#define NUM_CONFIGS     ((int)(sizeof(__configs) / sizeof(filter_config_t)))
+
+// outcome of one replay
+typedef struct {
+    int         transitions;
+    int         false_transitions;      // state changes the stall never made
+    int         missed;                 // real state changes that never showed up
+    int         observations;
+    int         rejected;
+    double      ns_per_sample;
+} replay_result_t;
+
+// deterministic pseudo random numbers
+static uint32_t __seed = 1;
+static float next_uniform() {
+    __seed = __seed * 1103515245u + 12345u;
+    return (float)((__seed >> 8) & 0xFFFF) / 65536.0f;
+}
+
+// the HC-SR04 at HREZ_WAIT_TIME: small noise, a spurious echo now and then and the odd missing echo
+static float sensor(float truth_m,int spurious_percent) {
+    float u = next_uniform() * 100.0f;
+    if (u < (float)spurious_percent) {
+        return 0.05f + next_uniform() * 0.30f;
+    }
+    if (u < (float)spurious_percent + 2.0f) {
+        return -1.0;
+    }
+    return truth_m + (next_uniform() - 0.5f) * 0.008f;
+}
+
+// start a synthetic trace
+static void begin_trace(range_trace_t &trace,const char *name,ParkingStallStates initial,unsigned seed) {
+    memset(&trace,0,sizeof(trace));
+    strncpy(trace.name,name,sizeof(trace.name) - 1);
+    trace.initial = initial;
+    __seed = seed;
+}
+
+// append samples moving the true range from "from_m" to "to_m"
+static void add_segment(range_trace_t &trace,int samples,float from_m,float to_m,int spurious_percent) {
+    for(int i=0;i<samples && trace.length<MAX_TRACE_SAMPLES;++i) {
+        float truth = from_m + (to_m - from_m) * (float)(i + 1) / (float)samples;
+        trace.range_m[trace.length] = sensor(truth,spurious_percent);
+        trace.timestamp_us[trace.length] = (uint32_t)(trace.length + 1) * SAMPLE_PERIOD_MS * 1000;
+        ++trace.length;
+    }
+}
+
+static void expect(range_trace_t &trace,ParkingStallStates state) {
+    trace.expected[trace.num_expected++] = state;
+}
+
+// the synthetic traces: an empty stall (far wall at 0.45 m), a parked car, an arrival and a departure (0.25 m/s)
+static int synthetic_traces(range_trace_t *traces) {
+    begin_trace(traces[0],"empty, spurious echoes",STALL_EMPTY,11);
+    add_segment(traces[0],800,0.45,0.45,3);
+
+    begin_trace(traces[1],"parked, spurious echoes",STALL_OCCUPIED,23);
+    add_segment(traces[1],800,0.12,0.12,3);
+
+    begin_trace(traces[2],"arrival",STALL_EMPTY,37);
+    add_segment(traces[2],40,0.45,0.45,2);
+    add_segment(traces[2],9,0.45,0.12,0);
+    add_segment(traces[2],200,0.12,0.12,2);
+    expect(traces[2],STALL_ARRIVING);
+    expect(traces[2],STALL_OCCUPIED);
+
+    begin_trace(traces[3],"departure",STALL_OCCUPIED,41);
+    add_segment(traces[3],40,0.12,0.12,2);
+    add_segment(traces[3],9,0.12,0.45,0);
+    add_segment(traces[3],200,0.45,0.45,2);
+    expect(traces[3],STALL_DEPARTING);
+    expect(traces[3],STALL_EMPTY);
+    return 4;
+}
+
+// a recorded trace: one "<timestamp ms> <range m>" per line (a negative range: no echo)... no ground truth
+static bool load_trace(range_trace_t &trace,const char *path) {
+    FILE *file = fopen(path,"r");
+    if (file == NULL) {
+        printf("cannot open %s\n",path);
+        return false;
+    }
+    memset(&trace,0,sizeof(trace));
+    strncpy(trace.name,path,sizeof(trace.name) - 1);
+    trace.initial = STALL_EMPTY;
+    trace.num_expected = -1;
+    double timestamp_ms = 0.0;
+    double range_m = 0.0;
+    while (trace.length < MAX_TRACE_SAMPLES && fscanf(file,"%lf %lf",&timestamp_ms,&range_m) == 2) {
+        trace.timestamp_us[trace.length] = (uint32_t)(timestamp_ms * 1000.0);
+        trace.range_m[trace.length] = (float)range_m;
+        ++trace.length;
+    }
+    fclose(file);
+    return trace.length > 0;
+}
+
+/**
+ * One stall as the detector sees it: RangeFilter, then get_range() (rate over the sample interval, movement, the
+ * range_end cap), then the transition table with its range actions (parking_stall_state_transitioner())
+ */
+typedef struct {
+    RangeFilter         filter;
+    float               range;
+    float               last_range;
+    uint32_t            last_sample_us;
+    ParkingStallStates  state;
+    MovementDirection   movement;
+} replay_stall_t;
+
+static void reset_stall(replay_stall_t &stall,const filter_config_t &config,ParkingStallStates initial) {
+    stall.filter.configure(config.median_n,config.ema_alpha,config.max_velocity);
+    stall.range = (initial == STALL_OCCUPIED) ? OCCUPIED_RANGE_M : DEFAULT_OUT_OF_RANGE;
+    stall.last_range = stall.range;
+    stall.last_sample_us = 0;
+    stall.state = initial;
+    stall.movement = NO_MOVEMENT;
+}
+
+// feed one sample... the transition taken (NULL if the filter held the sample back)
+static const stall_transition_t *replay_sample(replay_stall_t &stall,float range_m,uint32_t timestamp_us) {
+    float new_range = 0.0;
+    if (stall.filter.filter(range_m,timestamp_us,new_range) == false) {
+        return NULL;
+    }
+    float interval_s = (stall.last_sample_us != 0) ? (timestamp_us - stall.last_sample_us)/1000000.0 : SAMPLE_PERIOD_MS/1000.0;
+    stall.last_sample_us = timestamp_us;
+    if (interval_s <= 0.0) {
+        interval_s = SAMPLE_PERIOD_MS/1000.0;
+    }
+
+    stall.movement = NO_MOVEMENT;
+    if (new_range < 0) {
+        stall.last_range = DEFAULT_OUT_OF_RANGE;
+        stall.range = DEFAULT_OUT_OF_RANGE;
+    }
+    else {
+        stall.last_range = stall.range;
+        stall.range = new_range;
+        float rate_m_s = (stall.range - stall.last_range)/interval_s;
+        if (stall.last_range >= DEFAULT_OUT_OF_RANGE || stall.range >= DEFAULT_OUT_OF_RANGE) {
+            rate_m_s = 0.0;
+        }
+        stall.movement = parking_stall_movement(rate_m_s,MOVEMENT_RATE_M_S);
+        if (new_range > RANGE_END_M) {
+            stall.last_range = DEFAULT_OUT_OF_RANGE;
+            stall.range = DEFAULT_OUT_OF_RANGE;
+        }
+    }
+
+    RangeClasses input = parking_stall_range_class(stall.range,stall.movement,OCCUPIED_RANGE_M,OCCUPIED_VARIANCE_M,MAX_RANGE_M);
+    const stall_transition_t *transition = &__stall_transitions[stall.state][input];
+    if (transition->actions & ACTION_RANGE_EMPTY) {
+        stall.range = DEFAULT_OUT_OF_RANGE;
+        stall.last_range = DEFAULT_OUT_OF_RANGE;
+        stall.movement = NO_MOVEMENT;
+    }
+    if (transition->actions & ACTION_RANGE_PARKED) {
+        stall.range = OCCUPIED_RANGE_M;
+        stall.last_range = OCCUPIED_RANGE_M;
+        stall.movement = NO_MOVEMENT;
+    }
+    stall.state = transition->next;
+    return transition;
+}
+
+// replay a trace through one filter configuration
+static replay_result_t replay(const range_trace_t &trace,const filter_config_t &config) {
+    replay_result_t result;
+    memset(&result,0,sizeof(result));
+    replay_stall_t stall;
+    reset_stall(stall,config,trace.initial);
+
+    // the state changes... matched in order against the real ones
+    int matched = 0;
+    for(int i=0;i<trace.length;++i) {
+        ParkingStallStates from = stall.state;
+        const stall_transition_t *transition = replay_sample(stall,trace.range_m[i],trace.timestamp_us[i]);
+        if (transition == NULL || transition->next == from) {
+            continue;
+        }
+        ++result.transitions;
+        if (transition->actions & ACTION_OBSERVE) {
+            ++result.observations;
+        }
+        if (trace.num_expected >= 0) {
+            if (matched < trace.num_expected && transition->next == trace.expected[matched]) {
+                ++matched;
+            }
+            else {
+                ++result.false_transitions;
+            }
+        }
+    }
+    result.missed = (trace.num_expected >= 0) ? trace.num_expected - matched : 0;
+    result.rejected = stall.filter.rejected();
+
+    // cost of the whole per sample path
+    const int repeats = 200;
+    double start_ns = host_time_ns();
+    for(int r=0;r<repeats;++r) {
+        reset_stall(stall,config,trace.initial);
+        for(int i=0;i<trace.length;++i) {
+            SINK(replay_sample(stall,trace.range_m[i],trace.timestamp_us[i]));
+        }
+    }
+    result.ns_per_sample = (host_time_ns() - start_ns) / ((double)repeats * trace.length);
+    return result;
+}
+
+int main(int argc,char **argv) {
+    static range_trace_t traces[4 + 16];
+    int num_traces = synthetic_traces(traces);
+    for(int i=1;i<argc && num_traces<(int)(sizeof(traces) / sizeof(range_trace_t));++i) {
+        if (load_trace(traces[num_traces],argv[i])) {
+            ++num_traces;
+        }
+    }
+
+    printf("%-26s %-20s %7s %11s %6s %12s %8s %9s\n","trace","filter","changes","false","missed","observations","rejected","ns/sample");
+    for(int t=0;t<num_traces;++t) {
+        replay_result_t results[NUM_CONFIGS];
+        for(int c=0;c<NUM_CONFIGS;++c) {
+            results[c] = replay(traces[t],__configs[c]);
+            printf("%-26s %-20s %7d %11d %6d %12d %8d %9.1f\n",traces[t].name,__configs[c].name,results[c].transitions,
+                   results[c].false_transitions,results[c].missed,results[c].observations,results[c].rejected,results[c].ns_per_sample);
+        }
+        if (traces[t].num_expected < 0) {
+            continue;
+        }
+
+        // the filter must find every real change and add none... unfiltered, the spurious echoes do flip the state
+        for(int c=1;c<NUM_CONFIGS;++c) {
+            CHECK_EQUAL(0,results[c].false_transitions);
+            CHECK_EQUAL(0,results[c].missed);
+        }
+        CHECK_EQUAL(0,results[0].missed);
+        CHECK(results[1].false_transitions <= results[0].false_transitions);
+    }
+    CHECK(replay(traces[0],__configs[0]).false_transitions > 0);
+    CHECK(replay(traces[1],__configs[0]).false_transitions > 0);
+    return host_test_result("RangeFilterReplayBenchmark");
+}
@@ -0,0 +1,120 @@
+/**
+ * @file    AsyncRangeFinder.h
+ * @brief   host fake of the interrupt driven range finder: records pings on the virtual clock (tests only)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ASYNC_RANGE_FINDER_H__
+#define __ASYNC_RANGE_FINDER_H__
+
+// mbed API (host stub)
+#include "mbed.h"
+
+// a range sample
+typedef struct {
+    float       range_m;            // range (m)... < 0: no echo before the timeout
+    uint32_t    timestamp_us;       // echo time (wraps... use differences only)
+} range_sample_t;
+
+/**
+ * Stands in for AsyncRangeFinder ahead of the real one on the include path (RangeMultiplexer only needs fire() and
+ * set_period()). Each ping takes the air for "echo_us": a ping while another sensor's echo may still be ringing is
+ * counted as cross-talk. With a period the sensor pings itself on the virtual clock (its own Ticker).
+ */
+class AsyncRangeFinder {
+    public:
+        AsyncRangeFinder(int echo_us) {
+            this->m_echo_us = echo_us;
+            this->m_period_ms = 0;
+            this->m_ticker_id = 0;
+            this->m_pings = 0;
+            this->m_last_ping_us = 0;
+            this->m_max_interval_us = 0;
+        }
+
+        virtual ~AsyncRangeFinder() {
+            this->set_period(0);
+        }
+
+        // change the ranging period (0: only on fire())
+        void set_period(int period_ms) {
+            if (period_ms == this->m_period_ms) {
+                return;
+            }
+            if (this->m_ticker_id != 0) {
+                host_clock_cancel(this->m_ticker_id);
+                this->m_ticker_id = 0;
+            }
+            this->m_period_ms = period_ms;
+            if (period_ms > 0) {
+                this->m_ticker_id = host_clock_schedule(host_clock_us() + (uint64_t)period_ms * 1000,&AsyncRangeFinder::tick,this);
+            }
+        }
+
+        // trigger one sample now
+        bool fire() {
+            uint64_t now_us = host_clock_us();
+            if (__air_busy_until_us > now_us) {
+                ++__crosstalk;
+            }
+            if (now_us + this->m_echo_us > __air_busy_until_us) {
+                __air_busy_until_us = now_us + this->m_echo_us;
+            }
+            if (this->m_pings > 0 && now_us - this->m_last_ping_us > this->m_max_interval_us) {
+                this->m_max_interval_us = now_us - this->m_last_ping_us;
+            }
+            this->m_last_ping_us = now_us;
+            ++this->m_pings;
+            return true;
+        }
+
+        // stats
+        int pings() { return this->m_pings; }
+        uint64_t max_interval_us() { return this->m_max_interval_us; }
+        void reset_max_interval() { this->m_max_interval_us = 0; }
+
+        // the air shared by every sensor
+        static void reset_air() {
+            __air_busy_until_us = 0;
+            __crosstalk = 0;
+        }
+        static int crosstalk() { return __crosstalk; }
+
+    private:
+        // its own Ticker
+        static void tick(void *context) {
+            AsyncRangeFinder *finder = (AsyncRangeFinder *)context;
+            finder->m_ticker_id = host_clock_schedule(host_clock_us() + (uint64_t)finder->m_period_ms * 1000,&AsyncRangeFinder::tick,finder);
+            finder->fire();
+        }
+
+        int         m_echo_us;
+        int         m_period_ms;
+        int         m_ticker_id;
+        int         m_pings;
+        uint64_t    m_last_ping_us;
+        uint64_t    m_max_interval_us;
+
+        static uint64_t __air_busy_until_us;
+        static int      __crosstalk;
+};
+
+#endif // __ASYNC_RANGE_FINDER_H__
@@ -0,0 +1,108 @@
+/**
+ * @file    HostClock.cpp
+ * @brief   virtual clock and timer events behind the host mbed stubs (tests only)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Clock
+#include "HostClock.h"
+
+#include <stddef.h>
+#include <vector>
+
+// a scheduled event
+typedef struct {
+    uint64_t        at_us;
+    int             id;
+    host_event_t    handler;
+    void           *context;
+} host_scheduled_t;
+
+static uint64_t __now_us = 0;
+static int __next_id = 1;
+static int __events_run = 0;
+static std::vector<host_scheduled_t> __events;
+
+// forget all events and restart the clock
+void host_clock_reset() {
+    __now_us = 0;
+    __events_run = 0;
+    __events.clear();
+}
+
+// virtual time
+uint64_t host_clock_us() {
+    return __now_us;
+}
+
+// schedule an event
+int host_clock_schedule(uint64_t at_us,host_event_t handler,void *context) {
+    host_scheduled_t event;
+    event.at_us = (at_us < __now_us) ? __now_us : at_us;
+    event.id = __next_id++;
+    event.handler = handler;
+    event.context = context;
+    __events.push_back(event);
+    return event.id;
+}
+
+// cancel a scheduled event
+void host_clock_cancel(int id) {
+    for(size_t i=0;i<__events.size();++i) {
+        if (__events[i].id == id) {
+            __events.erase(__events.begin() + i);
+            return;
+        }
+    }
+}
+
+// run the next event due by the deadline (ties run in the order they were scheduled)
+bool host_clock_step(uint64_t deadline_us) {
+    int next = -1;
+    for(size_t i=0;i<__events.size();++i) {
+        if (next < 0 || __events[i].at_us < __events[next].at_us) {
+            next = (int)i;
+        }
+    }
+    if (next < 0 || __events[next].at_us > deadline_us) {
+        return false;
+    }
+    host_scheduled_t event = __events[next];
+    __events.erase(__events.begin() + next);
+    __now_us = event.at_us;
+    ++__events_run;
+    event.handler(event.context);
+    return true;
+}
+
+// run every event due and move the clock
+void host_clock_run_until(uint64_t until_us) {
+    while (host_clock_step(until_us)) {
+    }
+    if (until_us > __now_us) {
+        __now_us = until_us;
+    }
+}
+
+// events run so far
+int host_clock_events_run() {
+    return __events_run;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file    HostClock.h
+ * @brief   virtual clock and timer events behind the host mbed stubs (tests only)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_CLOCK_H__
+#define __HOST_CLOCK_H__
+
+#include <stdint.h>
+
+/**
+ * Discrete event time for the host tests: nothing sleeps. Timer reads host_clock_us(), Timeout schedules an event
+ * and a blocking Semaphore::wait() or Thread::wait() runs the events due before its deadline (advancing the clock).
+ */
+
+// an event handler
+typedef void (*host_event_t)(void *context);
+
+// forget all events and restart the clock at 0
+void host_clock_reset();
+
+// virtual time (us)
+uint64_t host_clock_us();
+
+// schedule "handler(context)" at "at_us"... returns an id for host_clock_cancel() (> 0)
+int host_clock_schedule(uint64_t at_us,host_event_t handler,void *context);
+
+// cancel a scheduled event (unknown or already run ids are ignored)
+void host_clock_cancel(int id);
+
+// run the next event if it is due by "deadline_us" (the clock moves to it)... false (clock unchanged) otherwise
+bool host_clock_step(uint64_t deadline_us);
+
+// run every event due by "until_us" and move the clock there
+void host_clock_run_until(uint64_t until_us);
+
+// events run so far
+int host_clock_events_run();
+
+#endif // __HOST_CLOCK_H__
@@ -0,0 +1,184 @@
+/**
+ * @file    mbed.h
+ * @brief   host stub of the mbed API used by the pure logic libraries (tests only)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_MBED_H__
+#define __HOST_MBED_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+// virtual time
+#include "HostClock.h"
+
+using namespace std;
+
+// a void() callback: a function or an object and one of its methods
+template <typename F> class Callback;
+template <> class Callback<void()> {
+    public:
+        Callback() : m_object(NULL), m_function(NULL), m_thunk(NULL) {
+        }
+
+        Callback(void (*function)(void)) : m_object(NULL), m_function(function), m_thunk(&Callback::function_thunk) {
+        }
+
+        template <typename T> Callback(T *object,void (T::*method)(void)) : m_object(object), m_function(NULL), m_thunk(&Callback::method_thunk<T>) {
+            typedef char method_fits[(sizeof(method) <= sizeof(this->m_method)) ? 1 : -1];
+            memcpy(this->m_method,&method,sizeof(method));
+        }
+
+        void call() const {
+            if (this->m_thunk != NULL) {
+                this->m_thunk(this);
+            }
+        }
+
+        void operator()() const {
+            this->call();
+        }
+
+    private:
+        class Unknown;
+
+        static void function_thunk(const Callback *cb) {
+            cb->m_function();
+        }
+
+        template <typename T> static void method_thunk(const Callback *cb) {
+            void (T::*method)(void);
+            memcpy(&method,cb->m_method,sizeof(method));
+            (((T *)cb->m_object)->*method)();
+        }
+
+        void               *m_object;
+        void              (*m_function)(void);
+        char                m_method[sizeof(void (Unknown::*)(void))];
+        void              (*m_thunk)(const Callback *cb);
+};
+
+template <typename T> Callback<void()> callback(T *object,void (T::*method)(void)) {
+    return Callback<void()>(object,method);
+}
+
+inline Callback<void()> callback(void (*function)(void)) {
+    return Callback<void()>(function);
+}
+
+// Timer on the virtual clock
+class Timer {
+    public:
+        Timer() : m_running(false), m_start_us(0), m_elapsed_us(0) {
+        }
+
+        void start() {
+            if (this->m_running == false) {
+                this->m_start_us = host_clock_us();
+                this->m_running = true;
+            }
+        }
+
+        void stop() {
+            this->m_elapsed_us = this->read_high_resolution_us();
+            this->m_running = false;
+        }
+
+        void reset() {
+            this->m_start_us = host_clock_us();
+            this->m_elapsed_us = 0;
+        }
+
+        uint64_t read_high_resolution_us() {
+            return this->m_elapsed_us + (this->m_running ? host_clock_us() - this->m_start_us : 0);
+        }
+
+        int read_us() {
+            return (int)this->read_high_resolution_us();
+        }
+
+        int read_ms() {
+            return (int)(this->read_high_resolution_us() / 1000);
+        }
+
+        float read() {
+            return this->read_high_resolution_us() / 1000000.0f;
+        }
+
+    private:
+        bool        m_running;
+        uint64_t    m_start_us;
+        uint64_t    m_elapsed_us;
+};
+
+// Timeout on the virtual clock (runs when a test advances the clock past it)
+class Timeout {
+    public:
+        Timeout() : m_id(0) {
+        }
+
+        virtual ~Timeout() {
+            this->detach();
+        }
+
+        void attach_us(Callback<void()> func,int us) {
+            this->detach();
+            this->m_func = func;
+            this->m_id = host_clock_schedule(host_clock_us() + us,&Timeout::expired,this);
+        }
+
+        void detach() {
+            if (this->m_id != 0) {
+                host_clock_cancel(this->m_id);
+                this->m_id = 0;
+            }
+        }
+
+    private:
+        static void expired(void *context) {
+            Timeout *timeout = (Timeout *)context;
+            timeout->m_id = 0;
+            timeout->m_func.call();
+        }
+
+        Callback<void()>    m_func;
+        int                 m_id;
+};
+
+// no interrupts on the host
+inline void core_util_critical_section_enter() {
+}
+inline void core_util_critical_section_exit() {
+}
+inline void __DMB(void) {
+}
+
+// RTOS
+#include "rtos.h"
+
+#endif // __HOST_MBED_H__
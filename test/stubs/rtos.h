@@ -0,0 +1,146 @@
+/**
+ * @file    rtos.h
+ * @brief   host stub of the mbed RTOS API used by the pure logic libraries (tests only)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_RTOS_H__
+#define __HOST_RTOS_H__
+
+#include "HostClock.h"
+
+// wait forever
+#define osWaitForever       0xFFFFFFFF
+
+// osEvent (Mail)
+typedef int32_t osStatus;
+enum { osOK=0, osEventMail=0x20, osEventTimeout=0x40 };
+typedef struct {
+    osStatus    status;
+    union {
+        uint32_t    v;
+        void       *p;
+    } value;
+} osEvent;
+
+// one thread on the host: locks never contend
+class Mutex {
+    public:
+        void lock() {
+        }
+        bool trylock() {
+            return true;
+        }
+        void unlock() {
+        }
+};
+
+// waiting runs the virtual clock (the events due release tokens) until a token arrives or the wait times out
+class Semaphore {
+    public:
+        Semaphore(int count = 0) : m_count(count) {
+        }
+
+        int32_t wait(uint32_t millisec = osWaitForever) {
+            uint64_t deadline_us = (millisec == osWaitForever) ? ~0ULL : host_clock_us() + millisec * 1000ULL;
+            while (this->m_count <= 0) {
+                if (host_clock_step(deadline_us) == false) {
+                    if (millisec != osWaitForever) {
+                        host_clock_run_until(deadline_us);
+                    }
+                    return 0;
+                }
+            }
+            return this->m_count--;
+        }
+
+        void release() {
+            ++this->m_count;
+        }
+
+    private:
+        int     m_count;
+};
+
+// fixed pool of N mails in FIFO order... waiting for one runs the virtual clock like Semaphore
+template<typename T,uint32_t N> class Mail {
+    public:
+        Mail() : m_head(0), m_count(0) {
+            for(uint32_t i=0;i<N;++i) {
+                this->m_used[i] = false;
+            }
+        }
+
+        T *alloc(uint32_t millisec = 0) {
+            for(uint32_t i=0;i<N;++i) {
+                if (this->m_used[i] == false) {
+                    this->m_used[i] = true;
+                    return &this->m_pool[i];
+                }
+            }
+            return NULL;
+        }
+
+        osStatus put(T *mail) {
+            this->m_queue[(this->m_head + this->m_count) % N] = mail;
+            ++this->m_count;
+            return osOK;
+        }
+
+        osEvent get(uint32_t millisec = osWaitForever) {
+            osEvent evt;
+            evt.status = osEventTimeout;
+            evt.value.p = NULL;
+            uint64_t deadline_us = (millisec == osWaitForever) ? ~0ULL : host_clock_us() + millisec * 1000ULL;
+            while (this->m_count == 0) {
+                if (host_clock_step(deadline_us) == false) {
+                    return evt;
+                }
+            }
+            evt.status = osEventMail;
+            evt.value.p = this->m_queue[this->m_head];
+            this->m_head = (this->m_head + 1) % N;
+            --this->m_count;
+            return evt;
+        }
+
+        osStatus free(T *mail) {
+            this->m_used[mail - this->m_pool] = false;
+            return osOK;
+        }
+
+    private:
+        T           m_pool[N];
+        bool        m_used[N];
+        T          *m_queue[N];
+        uint32_t    m_head;
+        uint32_t    m_count;
+};
+
+// the calling "thread" sleeps on the virtual clock
+class Thread {
+    public:
+        static void wait(uint32_t millisec) {
+            host_clock_run_until(host_clock_us() + millisec * 1000ULL);
+        }
+};
+
+#endif // __HOST_RTOS_H__
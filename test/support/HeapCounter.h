@@ -0,0 +1,96 @@
+/**
+ * @file    HeapCounter.h
+ * @brief   counts heap allocations of a host test (include in exactly one file of a test executable)
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HEAP_COUNTER_H__
+#define __HEAP_COUNTER_H__
+
+#include <stdlib.h>
+#include <new>
+
+// heap accounting: allocations, bytes live and the peak since heap_counter_reset()
+static long __heap_allocations = 0;
+static long __heap_live = 0;
+static long __heap_peak = 0;
+static long __heap_baseline = 0;
+
+// every block carries its size in front
+static void *heap_counted_malloc(size_t length) {
+    size_t *block = (size_t *)malloc(length + sizeof(size_t) * 2);
+    if (block == NULL) {
+        return NULL;
+    }
+    block[0] = length;
+    ++__heap_allocations;
+    __heap_live += (long)length;
+    if (__heap_live > __heap_peak) {
+        __heap_peak = __heap_live;
+    }
+    return block + 2;
+}
+
+static void heap_counted_free(void *ptr) {
+    if (ptr != NULL) {
+        size_t *block = ((size_t *)ptr) - 2;
+        __heap_live -= (long)block[0];
+        free(block);
+    }
+}
+
+// start counting from now (the live bytes carried in are not part of the peak)
+static void heap_counter_reset() {
+    __heap_allocations = 0;
+    __heap_baseline = __heap_live;
+    __heap_peak = __heap_live;
+}
+
+static long heap_allocations() {
+    return __heap_allocations;
+}
+
+// peak bytes allocated on top of what was live at heap_counter_reset()
+static long heap_peak_bytes() {
+    return __heap_peak - __heap_baseline;
+}
+
+void *operator new(size_t length) throw(std::bad_alloc) {
+    void *ptr = heap_counted_malloc(length);
+    if (ptr == NULL) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new[](size_t length) throw(std::bad_alloc) {
+    return operator new(length);
+}
+
+void operator delete(void *ptr) throw() {
+    heap_counted_free(ptr);
+}
+
+void operator delete[](void *ptr) throw() {
+    heap_counted_free(ptr);
+}
+
+#endif // __HEAP_COUNTER_H__
@@ -0,0 +1,68 @@
+/**
+ * @file    HostTest.h
+ * @brief   minimal checks and timing for the host tests and benchmarks
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_TEST_H__
+#define __HOST_TEST_H__
+
+#include <stdio.h>
+#include <time.h>
+
+// failed checks so far
+static int __host_test_failures = 0;
+
+// a failed check is reported and the test goes on... the executable fails at the end
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            ++__host_test_failures; \
+            printf("%s:%d: CHECK failed: %s\n",__FILE__,__LINE__,#cond); \
+        } \
+    } while (0)
+
+#define CHECK_EQUAL(expected,actual) do { \
+        long long __e = (long long)(expected); \
+        long long __a = (long long)(actual); \
+        if (__e != __a) { \
+            ++__host_test_failures; \
+            printf("%s:%d: CHECK_EQUAL failed: %s == %lld, %s == %lld\n",__FILE__,__LINE__,#expected,__e,#actual,__a); \
+        } \
+    } while (0)
+
+// report and return the exit code of the test
+static inline int host_test_result(const char *name) {
+    printf("%s: %s (%d failed checks)\n",name,(__host_test_failures == 0) ? "PASSED" : "FAILED",__host_test_failures);
+    return (__host_test_failures == 0) ? 0 : 1;
+}
+
+// wall clock for the benchmarks (ns)
+static inline double host_time_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// keep a benchmark result alive
+static volatile unsigned long __host_sink = 0;
+#define SINK(value) (__host_sink += (unsigned long)(value))
+
+#endif // __HOST_TEST_H__
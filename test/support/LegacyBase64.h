@@ -0,0 +1,53 @@
+/**
+ * @file    LegacyBase64.h
+ * @brief   the legacy Base64::Encode() behaviour (one malloc()'d buffer for the whole encoding) for host comparisons
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LEGACY_BASE64_H__
+#define __LEGACY_BASE64_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// the caller free()s the result... "allocate" defaults to malloc() (a test can count allocations)
+static char *legacy_base64_encode(const uint8_t *in,int length,size_t *out_length,void *(*allocate)(size_t) = malloc) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char *out = (char *)allocate(((length + 2) / 3) * 4 + 1);
+    if (out == NULL) {
+        return NULL;
+    }
+    size_t o = 0;
+    for(int i=0;i<length;i+=3) {
+        uint32_t bits = ((uint32_t)in[i]) << 16;
+        if (i + 1 < length) bits |= ((uint32_t)in[i+1]) << 8;
+        if (i + 2 < length) bits |= (uint32_t)in[i+2];
+        out[o++] = alphabet[(bits >> 18) & 0x3F];
+        out[o++] = alphabet[(bits >> 12) & 0x3F];
+        out[o++] = (i + 1 < length) ? alphabet[(bits >> 6) & 0x3F] : '=';
+        out[o++] = (i + 2 < length) ? alphabet[bits & 0x3F] : '=';
+    }
+    out[o] = '\0';
+    *out_length = o;
+    return out;
+}
+
+#endif // __LEGACY_BASE64_H__
@@ -0,0 +1,192 @@
+/**
+ * @file    SimulatedLink.h
+ * @brief   lossy CoAP link on the virtual clock for the host observation tests and benchmarks
+ * @author  Doug Anson
+ * @version 1.0
+ * @see
+ *
+ * @see
+ *
+ * Copyright (c) 2014
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SIMULATED_LINK_H__
+#define __SIMULATED_LINK_H__
+
+#include "mbed.h"
+
+// CoAP confirmable retransmission (RFC 7252 ACK_TIMEOUT and MAX_RETRANSMIT... no random factor)
+#define LINK_ACK_TIMEOUT_MS         2000
+#define LINK_MAX_RETRANSMIT         4
+
+// observations mbed-client can hold un-acknowledged (its resend queue)... further ones are dropped
+#define LINK_DEFAULT_CAPACITY       2
+
+// link parameters
+typedef struct {
+    const char *name;
+    int         latency_ms;         // one way
+    int         bytes_per_sec;      // serialization rate
+    int         loss_percent;       // each packet (data or acknowledgement) is lost with this probability
+    bool        callbacks;          // the delivery callback fires (false: an mbed-client without notification callbacks)
+} link_profile_t;
+
+/**
+ * Each send() is a confirmable observation: it is serialized behind the earlier ones, then it and its ACK cross the
+ * link (each may be lost). A lost exchange is retransmitted after LINK_ACK_TIMEOUT_MS (doubling) up to
+ * LINK_MAX_RETRANSMIT times. A delivered observation calls "on_delivered" (the notification delivery callback).
+ */
+class SimulatedLink {
+    public:
+        SimulatedLink(const link_profile_t &profile,unsigned seed,void (*on_delivered)(void *context),void *context,int capacity = LINK_DEFAULT_CAPACITY) {
+            this->m_profile = profile;
+            this->m_seed = seed;
+            this->m_on_delivered = on_delivered;
+            this->m_context = context;
+            this->m_capacity = capacity;
+            this->m_busy_until_us = 0;
+            this->m_pending = 0;
+            this->m_sent = 0;
+            this->m_delivered = 0;
+            this->m_dropped = 0;
+            this->m_lost = 0;
+            this->m_transmissions = 0;
+            this->m_first_delivery_us = 0;
+            this->m_last_delivery_us = 0;
+        }
+
+        virtual ~SimulatedLink() {
+            for(size_t i=0;i<this->m_messages.size();++i) {
+                delete this->m_messages[i];
+            }
+        }
+
+        // an observation of "bytes"... false if mbed-client had no room for it (dropped)
+        bool send(int bytes) {
+            ++this->m_sent;
+            if (this->m_pending >= this->m_capacity) {
+                ++this->m_dropped;
+                return false;
+            }
+            message_t *message = new message_t;
+            message->link = this;
+            message->index = this->m_sent - 1;
+            message->bytes = bytes;
+            message->attempt = 0;
+            this->m_messages.push_back(message);
+            ++this->m_pending;
+            this->transmit(message);
+            return true;
+        }
+
+        // stats
+        int sent() { return this->m_sent; }
+        int delivered() { return this->m_delivered; }
+        int dropped() { return this->m_dropped; }
+        int lost() { return this->m_lost; }
+        int transmissions() { return this->m_transmissions; }
+        int pending() { return this->m_pending; }
+        uint64_t first_delivery_us() { return this->m_first_delivery_us; }
+        uint64_t last_delivery_us() { return this->m_last_delivery_us; }
+
+        // delivery order (observation indexes)
+        const vector<int> &delivery_order() { return this->m_order; }
+
+        // when observation "index" (send() order) was acknowledged (0: never)
+        uint64_t delivery_us(int index) {
+            return (index >= 0 && index < (int)this->m_delivery_us.size()) ? this->m_delivery_us[index] : 0;
+        }
+
+    private:
+        typedef struct {
+            SimulatedLink  *link;
+            int             index;
+            int             bytes;
+            int             attempt;
+        } message_t;
+
+        // deterministic per link pseudo random loss
+        bool lost_packet() {
+            this->m_seed = this->m_seed * 1103515245u + 12345u;
+            return (int)((this->m_seed >> 16) % 100) < this->m_profile.loss_percent;
+        }
+
+        // one transmission attempt of a message
+        void transmit(message_t *message) {
+            ++this->m_transmissions;
+            uint64_t now_us = host_clock_us();
+            uint64_t start_us = (this->m_busy_until_us > now_us) ? this->m_busy_until_us : now_us;
+            uint64_t tx_us = (uint64_t)message->bytes * 1000000ULL / this->m_profile.bytes_per_sec;
+            this->m_busy_until_us = start_us + tx_us;
+            if (this->lost_packet() == false && this->lost_packet() == false) {
+                host_clock_schedule(this->m_busy_until_us + 2000ULL * this->m_profile.latency_ms,&SimulatedLink::acknowledged,message);
+            }
+            else {
+                host_clock_schedule(start_us + (uint64_t)(LINK_ACK_TIMEOUT_MS << message->attempt) * 1000ULL,&SimulatedLink::ack_timeout,message);
+            }
+        }
+
+        static void acknowledged(void *context) {
+            message_t *message = (message_t *)context;
+            SimulatedLink *link = message->link;
+            --link->m_pending;
+            ++link->m_delivered;
+            link->m_order.push_back(message->index);
+            if ((int)link->m_delivery_us.size() <= message->index) {
+                link->m_delivery_us.resize(message->index + 1,0);
+            }
+            link->m_delivery_us[message->index] = host_clock_us();
+            if (link->m_first_delivery_us == 0) {
+                link->m_first_delivery_us = host_clock_us();
+            }
+            link->m_last_delivery_us = host_clock_us();
+            if (link->m_profile.callbacks) {
+                link->m_on_delivered(link->m_context);
+            }
+        }
+
+        static void ack_timeout(void *context) {
+            message_t *message = (message_t *)context;
+            SimulatedLink *link = message->link;
+            if (message->attempt >= LINK_MAX_RETRANSMIT) {
+                // gave up
+                --link->m_pending;
+                ++link->m_lost;
+                return;
+            }
+            ++message->attempt;
+            link->transmit(message);
+        }
+
+        link_profile_t      m_profile;
+        unsigned            m_seed;
+        void              (*m_on_delivered)(void *context);
+        void               *m_context;
+        int                 m_capacity;
+        uint64_t            m_busy_until_us;
+        int                 m_pending;
+        int                 m_sent;
+        int                 m_delivered;
+        int                 m_dropped;
+        int                 m_lost;
+        int                 m_transmissions;
+        uint64_t            m_first_delivery_us;
+        uint64_t            m_last_delivery_us;
+        vector<message_t *> m_messages;
+        vector<int>         m_order;
+        vector<uint64_t>    m_delivery_us;
+};
+
+#endif // __SIMULATED_LINK_H__